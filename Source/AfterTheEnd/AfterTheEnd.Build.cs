@@ -11,10 +11,13 @@ public class AfterTheEnd : ModuleRules
 		PublicDependencyModuleNames.AddRange(new string[]
 		{
 			"Core", "CoreUObject", "Engine", "InputCore", "GameplayAbilities", "GameplayTags", "GameplayTasks",
-			"HeadMountedDisplay", "AIModule", "UMG", "EnhancedInput"
+			"HeadMountedDisplay", "AIModule", "UMG", "EnhancedInput", "NetCore"
 		});
 
-		PrivateDependencyModuleNames.AddRange(new string[] { });
+		PrivateDependencyModuleNames.AddRange(new string[]
+		{
+			"SignificanceManager", "Chaos", "FieldSystemEngine", "GeometryCollectionEngine"
+		});
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
@@ -0,0 +1,451 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingBaseAggregator.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "AfterTheEnd/Subsystems/BuildingSnapSubsystem.h"
+#include "AfterTheEnd/Subsystems/StructureDamageSubsystem.h"
+#include "AfterTheEnd/Subsystems/StructureRegistrySubsystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
+
+static TAutoConsoleVariable<float> CVarAggregateDelay(
+	TEXT("ate.Building.AggregateDelay"),
+	30.f,
+	TEXT("Seconds a building piece has to be left alone before it is drawn as an instance of its base"));
+
+static TAutoConsoleVariable<int32> CVarAggregateBatchSize(
+	TEXT("ate.Building.AggregateBatchSize"),
+	64,
+	TEXT("Building pieces aggregated per base and pass"));
+
+// How often bases look for idle pieces
+static constexpr float AggregateInterval = 5.f;
+
+namespace
+{
+	const FProperty* FindHealthField(const UClass* BuildClass)
+	{
+		return DataTableFields::FindField(BuildClass, TEXT("CurrentHP"));
+	}
+}
+
+void FAggregatedPiece::PostReplicatedAdd(const FAggregatedPieceArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandlePieceAdded(*this);
+	}
+}
+
+void FAggregatedPiece::PreReplicatedRemove(const FAggregatedPieceArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->HandlePieceRemoved(*this);
+	}
+}
+
+ABuildingBaseAggregator::ABuildingBaseAggregator()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+
+	// A base is seen from further away than any single piece
+	NetCullDistanceSquared = FMath::Square(30000.f);
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	AggregatedPieces.Owner = this;
+}
+
+void ABuildingBaseAggregator::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ABuildingBaseAggregator, AggregatedPieces);
+}
+
+void ABuildingBaseAggregator::BeginPlay()
+{
+	Super::BeginPlay();
+
+	AggregatedPieces.Owner = this;
+	if (HasAuthority())
+	{
+		GetWorldTimerManager().SetTimer(AggregateTimer, this, &ABuildingBaseAggregator::AggregateIdlePieces,
+		                                AggregateInterval, true);
+	}
+}
+
+void ABuildingBaseAggregator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Clients take their template pieces out of the snap index when the base stops being relevant
+	UBuildingSnapSubsystem* BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>();
+	if (!HasAuthority() && BuildingSnap)
+	{
+		for (const FAggregatedPiece& Piece : AggregatedPieces.Items)
+		{
+			BuildingSnap->RemovePiece(Piece.SnapPiece);
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABuildingBaseAggregator::AdoptPiece(int32 SnapPiece, AActor* Piece)
+{
+	const int32 PieceId = NextPieceId++;
+	SnapPieceIds.Add(SnapPiece, PieceId);
+	PromotedPieces.Add({Piece, SnapPiece, PieceId, GetWorld()->GetTimeSeconds()});
+	Piece->OnTakeAnyDamage.AddDynamic(this, &ABuildingBaseAggregator::HandlePieceDamaged);
+}
+
+void ABuildingBaseAggregator::ForgetPiece(int32 SnapPiece)
+{
+	int32 PieceId = INDEX_NONE;
+	if (!SnapPieceIds.RemoveAndCopyValue(SnapPiece, PieceId))
+	{
+		return;
+	}
+
+	const int32 PromotedIndex = PromotedPieces.IndexOfByPredicate([PieceId](const FPromotedPiece& Promoted)
+	{
+		return Promoted.PieceId == PieceId;
+	});
+	if (PromotedIndex != INDEX_NONE)
+	{
+		if (AActor* Piece = PromotedPieces[PromotedIndex].Actor.Get())
+		{
+			Piece->OnTakeAnyDamage.RemoveDynamic(this, &ABuildingBaseAggregator::HandlePieceDamaged);
+		}
+		PromotedPieces.RemoveAtSwap(PromotedIndex, 1, false);
+	}
+
+	if (const int32* ItemIndex = AggregatedIndices.Find(PieceId))
+	{
+		RemoveAggregatedPiece(*ItemIndex);
+	}
+}
+
+void ABuildingBaseAggregator::AggregateIdlePieces()
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double Delay = CVarAggregateDelay.GetValueOnGameThread();
+	int32 Budget = CVarAggregateBatchSize.GetValueOnGameThread();
+
+	for (int32 Index = PromotedPieces.Num() - 1; Index >= 0 && Budget > 0; --Index)
+	{
+		const FPromotedPiece& Promoted = PromotedPieces[Index];
+		const AActor* Piece = Promoted.Actor.Get();
+		if (Piece && !Piece->IsActorBeingDestroyed() && Now - Promoted.LastActiveTime >= Delay)
+		{
+			AggregatePiece(Index);
+			--Budget;
+		}
+	}
+}
+
+void ABuildingBaseAggregator::AggregatePiece(int32 PromotedIndex)
+{
+	const FPromotedPiece Promoted = PromotedPieces[PromotedIndex];
+	PromotedPieces.RemoveAtSwap(PromotedIndex, 1, false);
+
+	AActor* Actor = Promoted.Actor.Get();
+	Actor->OnTakeAnyDamage.RemoveDynamic(this, &ABuildingBaseAggregator::HandlePieceDamaged);
+
+	FAggregatedPiece& Piece = AggregatedPieces.Items.AddDefaulted_GetRef();
+	Piece.PieceId = Promoted.PieceId;
+	Piece.BuildClass = Actor->GetClass();
+	Piece.Location = Actor->GetActorLocation();
+	Piece.Rotation = Actor->GetActorRotation();
+	Piece.SnapPiece = Promoted.SnapPiece;
+	if (const FProperty* HealthField = FindHealthField(Piece.BuildClass))
+	{
+		Piece.Health = DataTableFields::GetFloat(HealthField, Actor);
+	}
+	AggregatedIndices.Add(Piece.PieceId, AggregatedPieces.Items.Num() - 1);
+	AggregatedPieces.MarkItemDirty(Piece);
+
+	AddInstances(Piece);
+
+	// The piece stays in the snap index and the stability graph without an actor
+	if (UBuildingSnapSubsystem* BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>())
+	{
+		BuildingSnap->SetPieceActor(Promoted.SnapPiece, nullptr);
+	}
+	Actor->Destroy();
+}
+
+AActor* ABuildingBaseAggregator::PromotePiece(int32 SnapPiece)
+{
+	const int32* PieceId = SnapPieceIds.Find(SnapPiece);
+	const int32* ItemIndex = PieceId ? AggregatedIndices.Find(*PieceId) : nullptr;
+	if (!ItemIndex)
+	{
+		return nullptr;
+	}
+
+	const FAggregatedPiece Piece = AggregatedPieces.Items[*ItemIndex];
+	const FTransform Transform = Piece.GetTransform();
+
+	// The snap index sees the actor from inside SpawnActorDeferred, where it has to take it for this
+	// piece rather than a new one
+	UBuildingSnapSubsystem* BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>();
+	if (BuildingSnap)
+	{
+		BuildingSnap->SetPendingPieceActor(SnapPiece);
+	}
+	AActor* Actor = GetWorld()->SpawnActorDeferred<AActor>(Piece.BuildClass, Transform, nullptr, nullptr,
+	                                                       ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (BuildingSnap)
+	{
+		BuildingSnap->SetPendingPieceActor(INDEX_NONE);
+		if (Actor)
+		{
+			BuildingSnap->SetPieceActor(SnapPiece, Actor);
+		}
+	}
+	if (!Actor)
+	{
+		return nullptr;
+	}
+
+	RemoveAggregatedPiece(*ItemIndex);
+	Actor->FinishSpawning(Transform);
+
+	// After BeginPlay, which resets health to the maximum
+	if (Piece.Health >= 0.f)
+	{
+		DataTableFields::SetFloat(FindHealthField(Piece.BuildClass), Actor, Piece.Health);
+	}
+
+	PromotedPieces.Add({Actor, SnapPiece, Piece.PieceId, GetWorld()->GetTimeSeconds()});
+	Actor->OnTakeAnyDamage.AddDynamic(this, &ABuildingBaseAggregator::HandlePieceDamaged);
+	return Actor;
+}
+
+void ABuildingBaseAggregator::RemoveAggregatedPiece(int32 ItemIndex)
+{
+	TArray<FAggregatedPiece>& Items = AggregatedPieces.Items;
+	RemoveInstances(Items[ItemIndex].PieceId);
+	AggregatedIndices.Remove(Items[ItemIndex].PieceId);
+
+	Items.RemoveAtSwap(ItemIndex, 1, false);
+	if (Items.IsValidIndex(ItemIndex))
+	{
+		AggregatedIndices[Items[ItemIndex].PieceId] = ItemIndex;
+	}
+	AggregatedPieces.MarkArrayDirty();
+}
+
+AActor* ABuildingBaseAggregator::PromoteInstance(const UPrimitiveComponent* Component, int32 InstanceIndex)
+{
+	const int32 PieceId = GetInstancePieceId(Component, InstanceIndex);
+	const int32* ItemIndex = AggregatedIndices.Find(PieceId);
+	return ItemIndex ? PromotePiece(AggregatedPieces.Items[*ItemIndex].SnapPiece) : nullptr;
+}
+
+float ABuildingBaseAggregator::TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent,
+                                          AController* EventInstigator, AActor* DamageCauser)
+{
+	if (!HasAuthority())
+	{
+		return 0.f;
+	}
+
+	FHitResult Hit;
+	FVector ImpulseDirection;
+	DamageEvent.GetBestHitInfo(this, DamageCauser, Hit, ImpulseDirection);
+
+	// Aggregated pieces lose health in place and are only promoted once they break
+	if (UStructureDamageSubsystem* StructureDamage = GetWorld()->GetSubsystem<UStructureDamageSubsystem>())
+	{
+		StructureDamage->QueueHitDamage(Hit, DamageAmount, DamageCauser);
+		return DamageAmount;
+	}
+
+	AActor* Piece = PromoteInstance(Hit.GetComponent(), Hit.Item);
+	return Piece ? Piece->TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser) : 0.f;
+}
+
+float ABuildingBaseAggregator::GetPieceHealth(int32 SnapPiece) const
+{
+	const int32* PieceId = SnapPieceIds.Find(SnapPiece);
+	const int32* ItemIndex = PieceId ? AggregatedIndices.Find(*PieceId) : nullptr;
+	return ItemIndex ? AggregatedPieces.Items[*ItemIndex].Health : -1.f;
+}
+
+void ABuildingBaseAggregator::SetPieceHealth(int32 SnapPiece, float Health)
+{
+	const int32* PieceId = SnapPieceIds.Find(SnapPiece);
+	const int32* ItemIndex = PieceId ? AggregatedIndices.Find(*PieceId) : nullptr;
+	if (ItemIndex)
+	{
+		FAggregatedPiece& Piece = AggregatedPieces.Items[*ItemIndex];
+		Piece.Health = Health;
+		AggregatedPieces.MarkItemDirty(Piece);
+	}
+}
+
+void ABuildingBaseAggregator::NotifyPieceActive(AActor* Piece)
+{
+	for (FPromotedPiece& Promoted : PromotedPieces)
+	{
+		if (Promoted.Actor == Piece)
+		{
+			Promoted.LastActiveTime = GetWorld()->GetTimeSeconds();
+			return;
+		}
+	}
+}
+
+void ABuildingBaseAggregator::HandlePieceDamaged(AActor* DamagedActor, float Damage, const UDamageType* DamageType,
+                                                 AController* InstigatedBy, AActor* DamageCauser)
+{
+	NotifyPieceActive(DamagedActor);
+}
+
+int32 ABuildingBaseAggregator::GetPieceId(const AActor* Piece) const
+{
+	const FPromotedPiece* Promoted = PromotedPieces.FindByPredicate([Piece](const FPromotedPiece& Candidate)
+	{
+		return Candidate.Actor == Piece;
+	});
+	return Promoted ? Promoted->PieceId : INDEX_NONE;
+}
+
+int32 ABuildingBaseAggregator::GetInstancePieceId(const UPrimitiveComponent* Component, int32 InstanceIndex) const
+{
+	const int32 MeshIndex = InstancedMeshes.IndexOfByPredicate(
+		[Component](const UHierarchicalInstancedStaticMeshComponent* InstancedMesh)
+		{
+			return InstancedMesh == Component;
+		});
+	return MeshIndex != INDEX_NONE && InstancePieceIds[MeshIndex].IsValidIndex(InstanceIndex)
+		       ? InstancePieceIds[MeshIndex][InstanceIndex]
+		       : INDEX_NONE;
+}
+
+int32 ABuildingBaseAggregator::GetInstanceSnapPiece(const UPrimitiveComponent* Component, int32 InstanceIndex) const
+{
+	// Clients don't keep the index by piece id, hits are rare enough to search
+	const int32 PieceId = GetInstancePieceId(Component, InstanceIndex);
+	const FAggregatedPiece* Piece = AggregatedPieces.Items.FindByPredicate([PieceId](const FAggregatedPiece& Candidate)
+	{
+		return Candidate.PieceId == PieceId;
+	});
+	return Piece ? Piece->SnapPiece : INDEX_NONE;
+}
+
+void ABuildingBaseAggregator::HandlePieceAdded(FAggregatedPiece& Piece)
+{
+	AddInstances(Piece);
+
+	if (UBuildingSnapSubsystem* BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>())
+	{
+		const UStructureRegistrySubsystem* StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+		Piece.SnapPiece = BuildingSnap->AddTemplatePiece(
+			StructureRegistry ? StructureRegistry->FindStructureType(Piece.BuildClass) : InvalidStructureType,
+			Piece.GetTransform());
+	}
+}
+
+void ABuildingBaseAggregator::HandlePieceRemoved(FAggregatedPiece& Piece)
+{
+	RemoveInstances(Piece.PieceId);
+
+	if (UBuildingSnapSubsystem* BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>())
+	{
+		BuildingSnap->RemovePiece(Piece.SnapPiece);
+	}
+	Piece.SnapPiece = INDEX_NONE;
+}
+
+void ABuildingBaseAggregator::AddInstances(const FAggregatedPiece& Piece)
+{
+	const UStructureRegistrySubsystem* StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	const FStructureTypeId TypeId = StructureRegistry
+		                                ? StructureRegistry->FindStructureType(Piece.BuildClass)
+		                                : InvalidStructureType;
+	if (TypeId == InvalidStructureType)
+	{
+		return;
+	}
+
+	const FTransform Transform = Piece.GetTransform();
+	TArray<FIntPoint, TInlineAllocator<2>>& Instances = PieceInstances.FindOrAdd(Piece.PieceId);
+	for (const FBuildableTemplate::FMesh& Mesh : StructureRegistry->GetStructureType(TypeId).Template.Meshes)
+	{
+		const int32 MeshIndex = FindOrAddInstancedMesh(Mesh.Mesh, Mesh.Materials, Mesh.CollisionProfile);
+		const int32 InstanceIndex = InstancedMeshes[MeshIndex]->AddInstance(Mesh.Transform * Transform, true);
+		InstancePieceIds[MeshIndex].Add(Piece.PieceId);
+		Instances.Add(FIntPoint(MeshIndex, InstanceIndex));
+	}
+}
+
+void ABuildingBaseAggregator::RemoveInstances(int32 PieceId)
+{
+	TArray<FIntPoint, TInlineAllocator<2>>* Instances = PieceInstances.Find(PieceId);
+	if (!Instances)
+	{
+		return;
+	}
+
+	// HISMs remove by swapping the last instance into the hole, the moved instance's piece is
+	// pointed at its new index
+	while (!Instances->IsEmpty())
+	{
+		const FIntPoint Instance = Instances->Pop(false);
+		TArray<int32>& MeshPieceIds = InstancePieceIds[Instance.X];
+		const int32 LastIndex = MeshPieceIds.Num() - 1;
+
+		InstancedMeshes[Instance.X]->RemoveInstance(Instance.Y);
+		MeshPieceIds.RemoveAtSwap(Instance.Y, 1, false);
+		if (Instance.Y != LastIndex)
+		{
+			for (FIntPoint& Moved : PieceInstances.FindChecked(MeshPieceIds[Instance.Y]))
+			{
+				if (Moved == FIntPoint(Instance.X, LastIndex))
+				{
+					Moved.Y = Instance.Y;
+					break;
+				}
+			}
+		}
+	}
+	PieceInstances.Remove(PieceId);
+}
+
+int32 ABuildingBaseAggregator::FindOrAddInstancedMesh(UStaticMesh* Mesh, TConstArrayView<UMaterialInterface*> Materials,
+                                                      FName CollisionProfile)
+{
+	FInstancedMeshKey Key{Mesh, TArray<UMaterialInterface*, TInlineAllocator<2>>(Materials), CollisionProfile};
+	if (const int32* MeshIndex = InstancedMeshIndices.Find(Key))
+	{
+		return *MeshIndex;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* InstancedMesh = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	InstancedMesh->SetMobility(EComponentMobility::Static);
+	InstancedMesh->SetStaticMesh(Mesh);
+	for (int32 MaterialIndex = 0; MaterialIndex < Materials.Num(); ++MaterialIndex)
+	{
+		if (Materials[MaterialIndex])
+		{
+			InstancedMesh->SetMaterial(MaterialIndex, Materials[MaterialIndex]);
+		}
+	}
+	InstancedMesh->SetCollisionProfileName(CollisionProfile);
+	InstancedMesh->SetupAttachment(RootComponent);
+	InstancedMesh->RegisterComponent();
+
+	const int32 MeshIndex = InstancedMeshes.Add(InstancedMesh);
+	InstancePieceIds.AddDefaulted();
+	InstancedMeshIndices.Add(MoveTemp(Key), MeshIndex);
+	return MeshIndex;
+}
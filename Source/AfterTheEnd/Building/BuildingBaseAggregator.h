@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "BuildingBaseAggregator.generated.h"
+
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+class UDamageType;
+
+/*
+ * A building piece drawn as instances instead of its actor. Carries everything needed to spawn
+ * the actor again as it was.
+ */
+USTRUCT()
+struct FAggregatedPiece : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	// Identity of the piece within its base, kept across promotion and aggregation
+	UPROPERTY()
+	int32 PieceId = INDEX_NONE;
+
+	UPROPERTY()
+	TSubclassOf<AActor> BuildClass;
+
+	UPROPERTY()
+	FVector_NetQuantize10 Location;
+
+	UPROPERTY()
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	// The actor's CurrentHP, negative if it has none
+	UPROPERTY()
+	float Health = -1.f;
+
+	// Handle in UBuildingSnapSubsystem. The server keeps the piece's original one, clients add a
+	// template piece so aggregated bases can still be snapped to.
+	UPROPERTY(NotReplicated)
+	int32 SnapPiece = INDEX_NONE;
+
+	FTransform GetTransform() const { return FTransform(Rotation, Location); }
+
+	void PostReplicatedAdd(const struct FAggregatedPieceArray& InArraySerializer);
+	void PreReplicatedRemove(const struct FAggregatedPieceArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FAggregatedPieceArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FAggregatedPiece> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<class ABuildingBaseAggregator> Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FAggregatedPiece, FAggregatedPieceArray>(
+			Items, DeltaParms, *this);
+	}
+};
+
+template <>
+struct TStructOpsTypeTraits<FAggregatedPieceArray> : public TStructOpsTypeTraitsBase2<FAggregatedPieceArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/*
+ * Draws the settled pieces of one base as instances of a HISM per mesh, so an idle base costs a
+ * handful of components instead of an actor per wall. Pieces start out as their own actors and
+ * are aggregated once nothing has touched them for ate.Building.AggregateDelay seconds. Damage,
+ * demolish or anything else that needs the real piece promotes it back to an actor with its
+ * piece id, transform and health, see PromoteInstance and UBuildingAggregationSubsystem.
+ *
+ * The server decides what is aggregated. Clients only get the aggregated piece list and build the
+ * instances themselves.
+ */
+UCLASS(NotBlueprintable)
+class AFTERTHEEND_API ABuildingBaseAggregator : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ABuildingBaseAggregator();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Damage landing on an instance is queued with UStructureDamageSubsystem against its piece
+	virtual float TakeDamage(float DamageAmount, FDamageEvent const& DamageEvent, AController* EventInstigator,
+	                         AActor* DamageCauser) override;
+
+	// Actor for a hit instance of this base, spawned if the piece is aggregated
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	AActor* PromoteInstance(const UPrimitiveComponent* Component, int32 InstanceIndex);
+
+	// Keeps a promoted piece from being aggregated for another AggregateDelay
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void NotifyPieceActive(AActor* Piece);
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetPieceId(const AActor* Piece) const;
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetInstancePieceId(const UPrimitiveComponent* Component, int32 InstanceIndex) const;
+
+	// Snap piece handle of a hit instance, on clients the template piece standing in for it
+	int32 GetInstanceSnapPiece(const UPrimitiveComponent* Component, int32 InstanceIndex) const;
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetNumAggregatedPieces() const { return AggregatedPieces.Items.Num(); }
+
+	// Server side bookkeeping, driven by UBuildingAggregationSubsystem
+	void AdoptPiece(int32 SnapPiece, AActor* Piece);
+	void ForgetPiece(int32 SnapPiece);
+	AActor* PromotePiece(int32 SnapPiece);
+
+	// Health of an aggregated piece, negative if it isn't aggregated here or has none
+	float GetPieceHealth(int32 SnapPiece) const;
+	void SetPieceHealth(int32 SnapPiece, float Health);
+
+	void HandlePieceAdded(FAggregatedPiece& Piece);
+	void HandlePieceRemoved(FAggregatedPiece& Piece);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void AggregateIdlePieces();
+	void AggregatePiece(int32 PromotedIndex);
+	void RemoveAggregatedPiece(int32 ItemIndex);
+
+	UFUNCTION()
+	void HandlePieceDamaged(AActor* DamagedActor, float Damage, const UDamageType* DamageType,
+	                        AController* InstigatedBy, AActor* DamageCauser);
+
+	void AddInstances(const FAggregatedPiece& Piece);
+	void RemoveInstances(int32 PieceId);
+
+	// Index into InstancedMeshes, adding a component the first time a mesh shows up
+	int32 FindOrAddInstancedMesh(UStaticMesh* Mesh, TConstArrayView<UMaterialInterface*> Materials,
+	                             FName CollisionProfile);
+
+	UPROPERTY(Replicated)
+	FAggregatedPieceArray AggregatedPieces;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UHierarchicalInstancedStaticMeshComponent>> InstancedMeshes;
+
+	// Per instanced mesh, the piece each instance belongs to
+	TArray<TArray<int32>> InstancePieceIds;
+
+	struct FInstancedMeshKey
+	{
+		UStaticMesh* Mesh;
+		TArray<UMaterialInterface*, TInlineAllocator<2>> Materials;
+		FName CollisionProfile;
+
+		bool operator==(const FInstancedMeshKey& Other) const
+		{
+			return Mesh == Other.Mesh && Materials == Other.Materials && CollisionProfile == Other.CollisionProfile;
+		}
+
+		friend uint32 GetTypeHash(const FInstancedMeshKey& Key)
+		{
+			uint32 Hash = HashCombine(GetTypeHash(Key.Mesh), GetTypeHash(Key.CollisionProfile));
+			for (const UMaterialInterface* Material : Key.Materials)
+			{
+				Hash = HashCombine(Hash, GetTypeHash(Material));
+			}
+			return Hash;
+		}
+	};
+
+	TMap<FInstancedMeshKey, int32> InstancedMeshIndices;
+
+	// (instanced mesh, instance) pairs of every aggregated piece
+	TMap<int32, TArray<FIntPoint, TInlineAllocator<2>>> PieceInstances;
+
+	// Server only from here on
+	struct FPromotedPiece
+	{
+		TWeakObjectPtr<AActor> Actor;
+		int32 SnapPiece;
+		int32 PieceId;
+		double LastActiveTime;
+	};
+
+	TArray<FPromotedPiece> PromotedPieces;
+
+	// Piece id of every piece in the base by snap handle
+	TMap<int32, int32> SnapPieceIds;
+
+	// Item index of each aggregated piece by piece id
+	TMap<int32, int32> AggregatedIndices;
+
+	int32 NextPieceId = 0;
+
+	FTimerHandle AggregateTimer;
+};
@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PrivilegeGrid.h"
+#include "Algo/BinarySearch.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPrivilegeGrid, Log, All);
+
+FPrivilegeGrid::FPrivilegeGrid(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 100.f))
+{
+}
+
+FIntPoint FPrivilegeGrid::GetCell(const FVector2D& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+int32 FPrivilegeGrid::AddClaim(const FBox2D& Bounds)
+{
+	FClaim NewClaim;
+	NewClaim.Bounds = Bounds;
+	NewClaim.MinCell = GetCell(Bounds.Min);
+	NewClaim.MaxCell = GetCell(Bounds.Max);
+	const int32 Claim = Claims.Add(MoveTemp(NewClaim));
+
+	const FClaim& Added = Claims[Claim];
+	for (int32 Y = Added.MinCell.Y; Y <= Added.MaxCell.Y; ++Y)
+	{
+		for (int32 X = Added.MinCell.X; X <= Added.MaxCell.X; ++X)
+		{
+			Cells.FindOrAdd(FIntPoint(X, Y)).Add(Claim);
+		}
+	}
+	return Claim;
+}
+
+void FPrivilegeGrid::RemoveClaim(int32 Claim)
+{
+	if (!Claims.IsValidIndex(Claim))
+	{
+		return;
+	}
+
+	const FClaim& Removed = Claims[Claim];
+	for (int32 Y = Removed.MinCell.Y; Y <= Removed.MaxCell.Y; ++Y)
+	{
+		for (int32 X = Removed.MinCell.X; X <= Removed.MaxCell.X; ++X)
+		{
+			const FIntPoint Cell(X, Y);
+			TArray<int32, TInlineAllocator<2>>& CellClaims = Cells.FindChecked(Cell);
+			CellClaims.RemoveSingleSwap(Claim, false);
+			if (CellClaims.IsEmpty())
+			{
+				Cells.Remove(Cell);
+			}
+		}
+	}
+	Claims.RemoveAt(Claim);
+}
+
+void FPrivilegeGrid::SetAuthorized(int32 Claim, TConstArrayView<int32> PlayerKeys)
+{
+	if (!Claims.IsValidIndex(Claim))
+	{
+		return;
+	}
+
+	// Sorted for the binary search in IsAuthorized
+	TArray<int32, TInlineAllocator<4>>& Authorized = Claims[Claim].Authorized;
+	Authorized.Reset();
+	for (const int32 PlayerKey : PlayerKeys)
+	{
+		if (PlayerKey != INDEX_NONE)
+		{
+			Authorized.Add(PlayerKey);
+		}
+	}
+	Authorized.Sort();
+}
+
+bool FPrivilegeGrid::IsAuthorized(int32 Claim, int32 PlayerKey) const
+{
+	return PlayerKey != INDEX_NONE && Algo::BinarySearch(Claims[Claim].Authorized, PlayerKey) != INDEX_NONE;
+}
+
+bool FPrivilegeGrid::IsClaimed(const FVector2D& Point, int32 PlayerKey, bool& bOutAuthorized) const
+{
+	bOutAuthorized = true;
+	const TArray<int32, TInlineAllocator<2>>* CellClaims = Cells.Find(GetCell(Point));
+	if (!CellClaims)
+	{
+		return false;
+	}
+
+	bool bClaimed = false;
+	for (const int32 Claim : *CellClaims)
+	{
+		if (Claims[Claim].Bounds.IsInsideOrOn(Point))
+		{
+			bClaimed = true;
+			if (!IsAuthorized(Claim, PlayerKey))
+			{
+				bOutAuthorized = false;
+				break;
+			}
+		}
+	}
+	return bClaimed;
+}
+
+bool FPrivilegeGrid::IsClaimed(const FBox2D& Box, int32 PlayerKey, bool& bOutAuthorized) const
+{
+	bOutAuthorized = true;
+	bool bClaimed = false;
+	auto TestClaim = [this, &Box, PlayerKey, &bClaimed, &bOutAuthorized](int32 Claim)
+	{
+		if (Claims[Claim].Bounds.Intersect(Box))
+		{
+			bClaimed = true;
+			bOutAuthorized = IsAuthorized(Claim, PlayerKey);
+		}
+		return bOutAuthorized;
+	};
+
+	// A claim spanning several of the box's cells is tested once per cell, which is cheaper than
+	// remembering what was tested. Boxes covering more cells than there are claims test every claim.
+	const FIntPoint MinCell = GetCell(Box.Min);
+	const FIntPoint MaxCell = GetCell(Box.Max);
+	const int64 NumCells = static_cast<int64>(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1);
+	if (NumCells > Claims.Num())
+	{
+		for (TSparseArray<FClaim>::TConstIterator It(Claims); It; ++It)
+		{
+			if (!TestClaim(It.GetIndex()))
+			{
+				break;
+			}
+		}
+		return bClaimed;
+	}
+
+	for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+	{
+		for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+		{
+			if (const TArray<int32, TInlineAllocator<2>>* CellClaims = Cells.Find(FIntPoint(X, Y)))
+			{
+				for (const int32 Claim : *CellClaims)
+				{
+					if (!TestClaim(Claim))
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return bClaimed;
+}
+
+static void RunPrivilegeGridBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumClaims = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+	const int32 NumQueries = 1000000;
+	const float WorldSize = 400000.f;
+	const float ClaimExtent = 2500.f;
+
+	// Claims scattered over a 4 km island, each authorizing a few of 1000 players
+	FRandomStream Stream(1337);
+	FPrivilegeGrid Grid;
+	for (int32 Index = 0; Index < NumClaims; ++Index)
+	{
+		const FVector2D Center(Stream.FRandRange(0.f, WorldSize), Stream.FRandRange(0.f, WorldSize));
+		const int32 Claim = Grid.AddClaim(FBox2D(Center - ClaimExtent, Center + ClaimExtent));
+		const int32 PlayerKeys[] = {Stream.RandHelper(1000), Stream.RandHelper(1000), Stream.RandHelper(1000)};
+		Grid.SetAuthorized(Claim, PlayerKeys);
+	}
+
+	TArray<FVector2D> Points;
+	Points.Reserve(NumQueries);
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		Points.Add(FVector2D(Stream.FRandRange(0.f, WorldSize), Stream.FRandRange(0.f, WorldSize)));
+	}
+
+	int32 NumClaimed = 0, NumAuthorized = 0;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		bool bAuthorized;
+		if (Grid.IsClaimed(Points[Index], Index % 1000, bAuthorized))
+		{
+			++NumClaimed;
+			NumAuthorized += bAuthorized ? 1 : 0;
+		}
+	}
+	const double PointTime = FPlatformTime::Seconds() - StartTime;
+
+	// Roughly the footprint of a wall or foundation
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		bool bAuthorized;
+		Grid.IsClaimed(FBox2D(Points[Index] - 200.f, Points[Index] + 200.f), Index % 1000, bAuthorized);
+	}
+	const double BoxTime = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogPrivilegeGrid, Display,
+	       TEXT("Privilege grid: %d claims, point query %.1f ns, box query %.1f ns (%d of %d points claimed, "
+		       "%d authorized)"),
+	       Grid.GetNumClaims(), PointTime * 1e9 / NumQueries, BoxTime * 1e9 / NumQueries, NumClaimed, NumQueries,
+	       NumAuthorized);
+}
+
+static FAutoConsoleCommand PrivilegeGridBenchmarkCommand(
+	TEXT("ate.Building.BenchmarkPrivilege"),
+	TEXT("Scatters N building privilege claims (default 10000) and times point and box queries against them"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunPrivilegeGridBenchmark));
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Building privilege claims bucketed into a uniform 2D grid. Each claim is an axis aligned box on
+ * the ground plane with a sorted list of the players it authorizes, identified by small integer
+ * keys. A point query is one cell lookup and a couple of box tests, so placement previews and door
+ * interactions can ask as often as they like.
+ *
+ * Where claims overlap a player needs to be authorized on all of them.
+ */
+class AFTERTHEEND_API FPrivilegeGrid
+{
+public:
+	explicit FPrivilegeGrid(float InCellSize = 2000.f);
+
+	int32 AddClaim(const FBox2D& Bounds);
+	void RemoveClaim(int32 Claim);
+
+	bool IsValidClaim(int32 Claim) const { return Claims.IsValidIndex(Claim); }
+
+	void SetAuthorized(int32 Claim, TConstArrayView<int32> PlayerKeys);
+
+	bool IsAuthorized(int32 Claim, int32 PlayerKey) const;
+
+	// Whether any claim covers the point or box, and if so whether every one of them authorizes the player
+	bool IsClaimed(const FVector2D& Point, int32 PlayerKey, bool& bOutAuthorized) const;
+	bool IsClaimed(const FBox2D& Box, int32 PlayerKey, bool& bOutAuthorized) const;
+
+	int32 GetNumClaims() const { return Claims.Num(); }
+
+private:
+	struct FClaim
+	{
+		FBox2D Bounds;
+		FIntPoint MinCell;
+		FIntPoint MaxCell;
+		TArray<int32, TInlineAllocator<4>> Authorized;
+	};
+
+	FIntPoint GetCell(const FVector2D& Location) const;
+
+	float CellSize;
+	TSparseArray<FClaim> Claims;
+	TMap<FIntPoint, TArray<int32, TInlineAllocator<2>>> Cells;
+};
@@ -0,0 +1,308 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StructuralGraph.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStructuralGraph, Log, All);
+
+FStructuralGraph::FStructuralGraph(int32 InMaxSupportDistance)
+	: MaxSupportDistance(FMath::Clamp(InMaxSupportDistance, 1, 1024))
+{
+	Buckets.SetNum(MaxSupportDistance + 1);
+}
+
+void FStructuralGraph::NextStamp()
+{
+	if (++Stamp == 0)
+	{
+		for (FNode& Node : Nodes)
+		{
+			Node.QueuedStamp = 0;
+			Node.AffectedStamp = 0;
+		}
+		Stamp = 1;
+	}
+}
+
+int32 FStructuralGraph::AddNode(bool bGrounded, TConstArrayView<int32> Neighbours)
+{
+	FNode NewNode;
+	NewNode.bGrounded = bGrounded;
+	NewNode.Distance = bGrounded ? 0 : Unsupported;
+	const int32 Handle = Nodes.Add(MoveTemp(NewNode));
+
+	for (const int32 Neighbour : Neighbours)
+	{
+		if (Neighbour == Handle || !Nodes.IsValidIndex(Neighbour) || Nodes[Handle].Links.Contains(Neighbour))
+		{
+			continue;
+		}
+
+		Nodes[Handle].Links.Add(Neighbour);
+		Nodes[Neighbour].Links.Add(Handle);
+		if (Nodes[Neighbour].Distance != Unsupported)
+		{
+			Nodes[Handle].Distance = FMath::Min<uint16>(Nodes[Handle].Distance, Nodes[Neighbour].Distance + 1);
+		}
+	}
+
+	if (Nodes[Handle].Distance > MaxSupportDistance)
+	{
+		Nodes[Handle].Distance = Unsupported;
+	}
+	else
+	{
+		// The new piece may be a shorter way down for its neighbours, or hold up pieces that were floating
+		Relax(Handle);
+	}
+
+	return Handle;
+}
+
+void FStructuralGraph::Relax(int32 Source)
+{
+	Queue.Reset();
+	Queue.Add(Source);
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		const int32 Distance = Nodes[Queue[Head]].Distance + 1;
+		if (Distance > MaxSupportDistance)
+		{
+			continue;
+		}
+
+		for (const int32 Link : Nodes[Queue[Head]].Links)
+		{
+			if (Nodes[Link].Distance > Distance)
+			{
+				Nodes[Link].Distance = static_cast<uint16>(Distance);
+				Queue.Add(Link);
+			}
+		}
+	}
+}
+
+void FStructuralGraph::RemoveNode(int32 Node, TArray<int32>& OutUnsupported)
+{
+	if (!Nodes.IsValidIndex(Node))
+	{
+		return;
+	}
+
+	const uint16 RemovedDistance = Nodes[Node].Distance;
+	const TArray<int32, TInlineAllocator<6>> Links = MoveTemp(Nodes[Node].Links);
+	for (const int32 Link : Links)
+	{
+		Nodes[Link].Links.RemoveSingleSwap(Node, false);
+	}
+	Nodes.RemoveAt(Node);
+
+	if (RemovedDistance == Unsupported)
+	{
+		return;
+	}
+
+	NextStamp();
+	Queue.Reset();
+	Affected.Reset();
+
+	// Only neighbours one step further from the ground may have been resting on the removed piece
+	for (const int32 Link : Links)
+	{
+		if (Nodes[Link].Distance == RemovedDistance + 1)
+		{
+			Nodes[Link].QueuedStamp = Stamp;
+			Queue.Add(Link);
+		}
+	}
+
+	// Breadth first, so a whole distance level is settled before the next one is looked at. A piece
+	// keeps its distance if an unaffected neighbour is one step closer to the ground.
+	for (int32 Head = 0; Head < Queue.Num(); ++Head)
+	{
+		const int32 Current = Queue[Head];
+		const uint16 Distance = Nodes[Current].Distance;
+
+		bool bStillSupported = false;
+		for (const int32 Link : Nodes[Current].Links)
+		{
+			if (Nodes[Link].Distance + 1 == Distance && Nodes[Link].AffectedStamp != Stamp)
+			{
+				bStillSupported = true;
+				break;
+			}
+		}
+		if (bStillSupported)
+		{
+			continue;
+		}
+
+		Nodes[Current].AffectedStamp = Stamp;
+		Affected.Add(Current);
+		for (const int32 Link : Nodes[Current].Links)
+		{
+			if (Nodes[Link].Distance == Distance + 1 && Nodes[Link].QueuedStamp != Stamp)
+			{
+				Nodes[Link].QueuedStamp = Stamp;
+				Queue.Add(Link);
+			}
+		}
+	}
+
+	if (Affected.IsEmpty())
+	{
+		return;
+	}
+
+	for (const int32 Current : Affected)
+	{
+		Nodes[Current].Distance = Unsupported;
+	}
+
+	// Affected pieces next to the rest of the building get a distance from it, then spread it among
+	// themselves in distance order with a bucket per distance
+	for (TArray<int32>& Bucket : Buckets)
+	{
+		Bucket.Reset();
+	}
+	for (const int32 Current : Affected)
+	{
+		int32 Distance = Unsupported;
+		for (const int32 Link : Nodes[Current].Links)
+		{
+			if (Nodes[Link].AffectedStamp != Stamp && Nodes[Link].Distance != Unsupported)
+			{
+				Distance = FMath::Min(Distance, Nodes[Link].Distance + 1);
+			}
+		}
+		if (Distance <= MaxSupportDistance)
+		{
+			Nodes[Current].Distance = static_cast<uint16>(Distance);
+			Buckets[Distance].Add(Current);
+		}
+	}
+
+	for (int32 Distance = 1; Distance < MaxSupportDistance; ++Distance)
+	{
+		for (int32 Index = 0; Index < Buckets[Distance].Num(); ++Index)
+		{
+			const int32 Current = Buckets[Distance][Index];
+			if (Nodes[Current].Distance != Distance)
+			{
+				continue;
+			}
+
+			for (const int32 Link : Nodes[Current].Links)
+			{
+				if (Nodes[Link].AffectedStamp == Stamp && Nodes[Link].Distance > Distance + 1)
+				{
+					Nodes[Link].Distance = static_cast<uint16>(Distance + 1);
+					Buckets[Distance + 1].Add(Link);
+				}
+			}
+		}
+	}
+
+	for (const int32 Current : Affected)
+	{
+		if (Nodes[Current].Distance == Unsupported)
+		{
+			OutUnsupported.Add(Current);
+		}
+	}
+}
+
+static void RunStructuralGraphBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumPieces = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 50000;
+	const int32 NumFloors = 5;
+	const int32 Width = FMath::Max(FMath::CeilToInt(FMath::Sqrt(static_cast<float>(NumPieces) / NumFloors)), 1);
+	const int32 NumOperations = 1000;
+
+	// A solid block of pieces, foundations on the bottom floor, each piece linked to its horizontal
+	// neighbours and to the piece below. Every fourth column of the upper floors is left out so
+	// removals have real work to do.
+	auto GetIndex = [Width](int32 X, int32 Y, int32 Z) { return (Z * Width + Y) * Width + X; };
+	auto IsPlaced = [](int32 X, int32 Y, int32 Z) { return Z == 0 || (X % 4 != 0 || Y % 4 != 0); };
+
+	FStructuralGraph Graph;
+	TArray<int32> Handles;
+	Handles.Init(INDEX_NONE, Width * Width * NumFloors);
+
+	auto Place = [&](int32 X, int32 Y, int32 Z)
+	{
+		TArray<int32, TInlineAllocator<6>> Neighbours;
+		const int32 Offsets[][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+		for (const int32* Offset : Offsets)
+		{
+			const int32 NX = X + Offset[0], NY = Y + Offset[1], NZ = Z + Offset[2];
+			if (NX >= 0 && NX < Width && NY >= 0 && NY < Width && NZ >= 0 && NZ < NumFloors
+				&& Handles[GetIndex(NX, NY, NZ)] != INDEX_NONE)
+			{
+				Neighbours.Add(Handles[GetIndex(NX, NY, NZ)]);
+			}
+		}
+		Handles[GetIndex(X, Y, Z)] = Graph.AddNode(Z == 0, Neighbours);
+	};
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Z = 0; Z < NumFloors; ++Z)
+	{
+		for (int32 Y = 0; Y < Width; ++Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				if (IsPlaced(X, Y, Z))
+				{
+					Place(X, Y, Z);
+				}
+			}
+		}
+	}
+	const double BuildTime = FPlatformTime::Seconds() - StartTime;
+
+	// Knock out random pieces, foundations included, then put them back
+	FRandomStream Stream(1337);
+	TArray<int32> Unsupported;
+	double RemoveTime = 0.0, MaxRemoveTime = 0.0, PlaceTime = 0.0, MaxPlaceTime = 0.0;
+	int32 TotalUnsupported = 0;
+	for (int32 Operation = 0; Operation < NumOperations; ++Operation)
+	{
+		int32 X, Y, Z;
+		do
+		{
+			X = Stream.RandRange(0, Width - 1);
+			Y = Stream.RandRange(0, Width - 1);
+			Z = Stream.RandRange(0, NumFloors - 1);
+		}
+		while (Handles[GetIndex(X, Y, Z)] == INDEX_NONE);
+
+		Unsupported.Reset();
+		StartTime = FPlatformTime::Seconds();
+		Graph.RemoveNode(Handles[GetIndex(X, Y, Z)], Unsupported);
+		const double RemoveElapsed = FPlatformTime::Seconds() - StartTime;
+		Handles[GetIndex(X, Y, Z)] = INDEX_NONE;
+		TotalUnsupported += Unsupported.Num();
+
+		StartTime = FPlatformTime::Seconds();
+		Place(X, Y, Z);
+		const double PlaceElapsed = FPlatformTime::Seconds() - StartTime;
+
+		RemoveTime += RemoveElapsed;
+		MaxRemoveTime = FMath::Max(MaxRemoveTime, RemoveElapsed);
+		PlaceTime += PlaceElapsed;
+		MaxPlaceTime = FMath::Max(MaxPlaceTime, PlaceElapsed);
+	}
+
+	UE_LOG(LogStructuralGraph, Display,
+	       TEXT("Structural graph: %d pieces built in %.2f ms, destroy %.3f us avg / %.3f us max, "
+		       "place %.3f us avg / %.3f us max (%d pieces lost support)"),
+	       Graph.GetNumNodes(), BuildTime * 1000.0, RemoveTime * 1e6 / NumOperations, MaxRemoveTime * 1e6,
+	       PlaceTime * 1e6 / NumOperations, MaxPlaceTime * 1e6, TotalUnsupported);
+}
+
+static FAutoConsoleCommand StructuralGraphBenchmarkCommand(
+	TEXT("ate.Building.BenchmarkStability"),
+	TEXT("Builds a synthetic base of about N pieces (default 50000) and times destroying and placing pieces"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunStructuralGraphBenchmark));
@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Connectivity of placed building pieces. Grounded pieces are the roots, every other piece is
+ * supported through its shortest chain of attached pieces down to one of them, and a chain longer
+ * than MaxSupportDistance doesn't hold. Distances are kept up to date incrementally: placing a
+ * piece only relaxes the pieces it brings closer to the ground, removing one only revisits the
+ * pieces whose shortest chain went through it.
+ */
+class AFTERTHEEND_API FStructuralGraph
+{
+public:
+	explicit FStructuralGraph(int32 InMaxSupportDistance = 12);
+
+	// Returns the node handle, check IsSupported to see whether the new piece holds
+	int32 AddNode(bool bGrounded, TConstArrayView<int32> Neighbours);
+
+	// Adds the nodes that lost their support to OutUnsupported
+	void RemoveNode(int32 Node, TArray<int32>& OutUnsupported);
+
+	bool IsValidNode(int32 Node) const { return Nodes.IsValidIndex(Node); }
+
+	bool IsSupported(int32 Node) const { return Nodes[Node].Distance != Unsupported; }
+
+	// Pieces between this one and the ground, INDEX_NONE when unsupported
+	int32 GetSupportDistance(int32 Node) const
+	{
+		return IsSupported(Node) ? Nodes[Node].Distance : INDEX_NONE;
+	}
+
+	// 1 for grounded pieces, falling towards 0 at the end of the support chain
+	float GetStability(int32 Node) const
+	{
+		return IsSupported(Node) ? 1.f - static_cast<float>(Nodes[Node].Distance) / (MaxSupportDistance + 1) : 0.f;
+	}
+
+	int32 GetNumNodes() const { return Nodes.Num(); }
+
+	int32 GetMaxSupportDistance() const { return MaxSupportDistance; }
+
+private:
+	static constexpr uint16 Unsupported = MAX_uint16;
+
+	struct FNode
+	{
+		TArray<int32, TInlineAllocator<6>> Links;
+		uint16 Distance = Unsupported;
+		bool bGrounded = false;
+
+		// Equal to the graph's Stamp while visited by the current removal
+		uint32 QueuedStamp = 0;
+		uint32 AffectedStamp = 0;
+	};
+
+	// Lowers distances outwards from a node that just got closer to the ground
+	void Relax(int32 Source);
+
+	void NextStamp();
+
+	TSparseArray<FNode> Nodes;
+	int32 MaxSupportDistance;
+	uint32 Stamp = 0;
+
+	// Scratch
+	TArray<int32> Queue;
+	TArray<int32> Affected;
+	TArray<TArray<int32>> Buckets;
+};
@@ -6,9 +6,69 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
+#include "AfterTheEnd/Components/HitboxHistoryComponent.h"
 #include "AfterTheEnd/Components/InteractionComponent.h"
+#include "AfterTheEnd/Subsystems/InteractionFocusSubsystem.h"
+#include "AfterTheEnd/Subsystems/InteractionSubsystem.h"
+#include "AfterTheEnd/Subsystems/MeleeCombatSubsystem.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "SignificanceManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogInventory, Log, All);
+
+static const FName CharacterSignificanceTag(TEXT("Character"));
+
+static float CalculateCharacterSignificance(USignificanceManager::FManagedObjectInfo* ObjectInfo,
+                                            const FTransform& Viewpoint)
+{
+	const ABaseCharacter* Character = CastChecked<ABaseCharacter>(ObjectInfo->GetObject());
+	if (Character->IsLocallyControlled())
+	{
+		return ABaseCharacter::MaxSignificanceLevel;
+	}
+
+	const float DistanceSquared = FVector::DistSquared(Character->GetActorLocation(), Viewpoint.GetLocation());
+	int32 SignificanceLevel = 0;
+	if (DistanceSquared < FMath::Square(1500.f))
+	{
+		SignificanceLevel = 3;
+	}
+	else if (DistanceSquared < FMath::Square(4000.f))
+	{
+		SignificanceLevel = 2;
+	}
+	else if (DistanceSquared < FMath::Square(10000.f))
+	{
+		SignificanceLevel = 1;
+	}
+
+	// Nothing is rendered on a dedicated server, so only demote off-screen characters where there is a viewport
+	if (Character->GetNetMode() != NM_DedicatedServer && !Character->WasRecentlyRendered(0.5f))
+	{
+		SignificanceLevel = FMath::Max(SignificanceLevel - 1, 0);
+	}
+
+	return SignificanceLevel;
+}
+
+static void PostCharacterSignificance(USignificanceManager::FManagedObjectInfo* ObjectInfo, float OldSignificance,
+                                      float Significance, bool bFinal)
+{
+	ABaseCharacter* Character = CastChecked<ABaseCharacter>(ObjectInfo->GetObject());
+	if (OldSignificance != Significance)
+	{
+		Character->ApplySignificance(FMath::RoundToInt(Significance));
+	}
+	else if (Significance <= 0.f)
+	{
+		// Equipables attached since the last update are hidden too
+		Character->HideCosmetics();
+	}
+}
 
 
 // Sets default values
@@ -23,9 +83,12 @@ ABaseCharacter::ABaseCharacter()
 	FirstPersonMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("FirstPersonMesh"));
 	FirstPersonMesh->SetupAttachment(FirstPersonCamera);
 
+	HitboxHistory = CreateDefaultSubobject<UHitboxHistoryComponent>(TEXT("HitboxHistory"));
+
 	bUseControllerRotationYaw = true;
 
 	GetMesh()->SetOwnerNoSee(true);
+	GetMesh()->bEnableUpdateRateOptimizations = true;
 }
 
 // Called when the game starts or when spawned
@@ -41,6 +104,112 @@ void ABaseCharacter::BeginPlay()
 			Subsystem->AddMappingContext(DefaultMappingContext, 0);
 		}
 	}
+
+	UpdateFirstPersonMesh();
+
+	// Containers may already hold replicated items by now
+	TInlineComponentArray<UItemContainerComponent*> Containers(this);
+	for (UItemContainerComponent* Container : Containers)
+	{
+		ItemCounts.Append(Container->GetItemCounts());
+		Container->OnItemCountChanged.AddUObject(this, &ABaseCharacter::HandleContainerItemCountChanged);
+	}
+
+	if (USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(GetWorld()))
+	{
+		SignificanceManager->RegisterObject(this, CharacterSignificanceTag, &CalculateCharacterSignificance,
+		                                    USignificanceManager::EPostSignificanceType::Sequential,
+		                                    &PostCharacterSignificance);
+
+		// Registering computes the starting significance but only reports changes after it
+		ApplySignificance(FMath::RoundToInt(SignificanceManager->GetSignificance(this)));
+	}
+}
+
+void ABaseCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(GetWorld()))
+	{
+		SignificanceManager->UnregisterObject(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABaseCharacter::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+
+	UpdateFirstPersonMesh();
+}
+
+void ABaseCharacter::OnRep_Controller()
+{
+	Super::OnRep_Controller();
+
+	UpdateFirstPersonMesh();
+}
+
+void ABaseCharacter::UpdateFirstPersonMesh()
+{
+	const bool bLocallyControlled = IsLocallyControlled();
+	FirstPersonMesh->SetVisibility(bLocallyControlled, true);
+	FirstPersonMesh->SetComponentTickEnabled(bLocallyControlled);
+}
+
+void ABaseCharacter::ApplySignificance(int32 SignificanceLevel)
+{
+	if (AnimationTickIntervals.IsValidIndex(SignificanceLevel))
+	{
+		GetMesh()->SetComponentTickInterval(AnimationTickIntervals[SignificanceLevel]);
+	}
+
+	// Non-replicated attachments (third person equipables) carry no gameplay state, drop them when far away
+	if (SignificanceLevel > 0)
+	{
+		ShowCosmetics();
+	}
+	else
+	{
+		HideCosmetics();
+	}
+}
+
+void ABaseCharacter::HideCosmetics()
+{
+	// Nothing to hide on a dedicated server
+	if (GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	TArray<AActor*> AttachedActors;
+	GetAttachedActors(AttachedActors);
+	for (AActor* AttachedActor : AttachedActors)
+	{
+		if (AttachedActor->GetIsReplicated() || AttachedActor->IsHidden())
+		{
+			continue;
+		}
+
+		HiddenCosmetics.Add({AttachedActor, AttachedActor->IsActorTickEnabled()});
+		AttachedActor->SetActorHiddenInGame(true);
+		AttachedActor->SetActorTickEnabled(false);
+	}
+}
+
+void ABaseCharacter::ShowCosmetics()
+{
+	// Only what HideCosmetics hid, attachments the Blueprint hid itself stay hidden
+	for (const FHiddenCosmetic& Hidden : HiddenCosmetics)
+	{
+		if (AActor* AttachedActor = Hidden.Actor.Get())
+		{
+			AttachedActor->SetActorHiddenInGame(false);
+			AttachedActor->SetActorTickEnabled(Hidden.bTickEnabled);
+		}
+	}
+	HiddenCosmetics.Reset();
 }
 
 // Called to bind functionality to input
@@ -108,25 +277,260 @@ void ABaseCharacter::CrouchCompleted()
 
 void ABaseCharacter::AttackStarted()
 {
+	UMeleeCombatSubsystem* MeleeSubsystem = GetWorld()->GetSubsystem<UMeleeCombatSubsystem>();
+	if (!MeleeSubsystem)
+	{
+		return;
+	}
+
+	// Cooldown is enforced again on the server, this only saves the RPC
+	const double Now = MeleeSubsystem->GetServerTime();
+	if (Now - LastMeleeSwingTime < MeleeCooldown)
+	{
+		return;
+	}
+	LastMeleeSwingTime = Now;
+
+	ServerMeleeSwing(FirstPersonCamera->GetComponentLocation(), FirstPersonCamera->GetForwardVector(), Now);
+}
+
+void ABaseCharacter::ServerMeleeSwing_Implementation(FVector_NetQuantize10 Start, FVector_NetQuantizeNormal Direction,
+                                                     double Timestamp)
+{
+	UMeleeCombatSubsystem* MeleeSubsystem = GetWorld()->GetSubsystem<UMeleeCombatSubsystem>();
+	if (!MeleeSubsystem)
+	{
+		return;
+	}
+
+	const double Now = MeleeSubsystem->GetServerTime();
+	// Small slack so jitter on the client's cooldown doesn't eat legitimate swings
+	if (!IsLocallyControlled() && Now - LastMeleeSwingTime < MeleeCooldown * 0.9f)
+	{
+		return;
+	}
+	LastMeleeSwingTime = Now;
+
+	if (FVector::DistSquared(Start, FirstPersonCamera->GetComponentLocation()) > FMath::Square(MeleeServerTolerance))
+	{
+		return;
+	}
+
+	FMeleeSwing Swing;
+	Swing.Attacker = this;
+	Swing.InstigatorController = GetController();
+	Swing.DamageType = MeleeDamageType;
+	Swing.Start = Start;
+	Swing.End = Start + Direction.GetSafeNormal() * MeleeRange;
+	Swing.Radius = MeleeRadius;
+	Swing.Damage = MeleeDamage;
+	Swing.Timestamp = Timestamp;
+	MeleeSubsystem->QueueSwing(Swing);
 }
 
 void ABaseCharacter::InteractStarted()
 {
 	// Move to GA later
-	const FVector TraceStart = FirstPersonCamera->GetComponentLocation();
-	const FVector TraceEnd = FirstPersonCamera->GetComponentLocation() + FirstPersonCamera->GetForwardVector() *
-		InteractionDistance;
+	// Prefer what the hover prompt is showing so the prompt and the action always agree
+	if (const UInteractionFocusSubsystem* FocusSubsystem = GetWorld()->GetSubsystem<UInteractionFocusSubsystem>())
+	{
+		if (UInteractionComponent* FocusedComponent = FocusSubsystem->GetFocusedInteractable(
+			Cast<APlayerController>(Controller)))
+		{
+			RequestInteract(FocusedComponent);
+			return;
+		}
+	}
+
+	const UInteractionSubsystem* InteractionSubsystem = GetWorld()->GetSubsystem<UInteractionSubsystem>();
+	if (!InteractionSubsystem)
+	{
+		return;
+	}
 
+	UInteractionComponent* InteractionComponent = InteractionSubsystem->FindBestInteractable(
+		FirstPersonCamera->GetComponentLocation(), FirstPersonCamera->GetForwardVector(), InteractionDistance,
+		InteractionAngle);
+
+	// The grid knows nothing about walls, so make sure the candidate is actually visible
+	if (InteractionComponent && CanReachInteractable(InteractionComponent, InteractionDistance))
+	{
+		RequestInteract(InteractionComponent);
+	}
+}
+
+void ABaseCharacter::RequestInteract(UInteractionComponent* InteractionComponent)
+{
+	if (HasAuthority())
+	{
+		InteractionComponent->Interact(this);
+		return;
+	}
+
+	// Everything requested this frame goes out in a single RPC
+	if (PendingInteractions.IsEmpty())
+	{
+		GetWorldTimerManager().SetTimerForNextTick(this, &ABaseCharacter::FlushPendingInteractions);
+	}
+	PendingInteractions.AddUnique(InteractionComponent->GetHandle());
+}
+
+void ABaseCharacter::FlushPendingInteractions()
+{
+	if (!PendingInteractions.IsEmpty())
+	{
+		ServerInteract(PendingInteractions);
+		PendingInteractions.Reset();
+	}
+}
+
+bool ABaseCharacter::CanReachInteractable(const UInteractionComponent* InteractionComponent, float MaxDistance) const
+{
+	const UInteractionSubsystem* InteractionSubsystem = GetWorld()->GetSubsystem<UInteractionSubsystem>();
+	if (!InteractionSubsystem)
+	{
+		return false;
+	}
+
+	const FVector ViewLocation = FirstPersonCamera->GetComponentLocation();
+	const FVector TargetLocation = InteractionSubsystem->GetRegisteredLocation(InteractionComponent);
+	const float TargetRadius = InteractionSubsystem->GetRegisteredRadius(InteractionComponent);
+	if (FVector::DistSquared(ViewLocation, TargetLocation) > FMath::Square(MaxDistance + TargetRadius))
+	{
+		return false;
+	}
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(InteractionVisibility), false, this);
 	FHitResult HitResult;
-	GetWorld()->LineTraceSingleByChannel(HitResult, TraceStart, TraceEnd, ECC_Visibility);
+	GetWorld()->LineTraceSingleByChannel(HitResult, ViewLocation, TargetLocation, ECC_Visibility, QueryParams);
+
+	return !HitResult.bBlockingHit || HitResult.GetActor() == InteractionComponent->GetOwner();
+}
+
+void ABaseCharacter::ServerInteract_Implementation(const TArray<FInteractableHandle>& Handles)
+{
+	const UInteractionSubsystem* InteractionSubsystem = GetWorld()->GetSubsystem<UInteractionSubsystem>();
+	if (!InteractionSubsystem)
+	{
+		return;
+	}
 
-	if (HitResult.bBlockingHit)
+	const int32 NumHandles = FMath::Min(Handles.Num(), MaxInteractionsPerBatch);
+	for (int32 Index = 0; Index < NumHandles; ++Index)
 	{
-		UActorComponent* OutComponent = HitResult.GetActor()->GetComponentByClass(UInteractionComponent::StaticClass());
-		UInteractionComponent* InteractionComponent = Cast<UInteractionComponent>(OutComponent);
-		if (InteractionComponent)
+		UInteractionComponent* InteractionComponent = InteractionSubsystem->FindInteractable(Handles[Index]);
+		if (InteractionComponent && CanReachInteractable(InteractionComponent,
+		                                                 InteractionDistance + InteractionServerTolerance))
 		{
 			InteractionComponent->Interact(this);
 		}
 	}
-}
\ No newline at end of file
+}
+
+void ABaseCharacter::RequestInventoryTransaction(const TArray<FInventoryOp>& Operations)
+{
+	if (Operations.IsEmpty())
+	{
+		return;
+	}
+
+	if (HasAuthority())
+	{
+		ServerInventoryTransaction_Implementation(Operations);
+		return;
+	}
+	ServerInventoryTransaction(Operations);
+}
+
+bool ABaseCharacter::CanAccessContainer(const UItemContainerComponent* Container) const
+{
+	const AActor* ContainerOwner = Container ? Container->GetOwner() : nullptr;
+	if (!ContainerOwner)
+	{
+		return false;
+	}
+
+	// Our own inventories, or anything owned by us, our controller or our player state. Never another
+	// player's: their pawn, or anything owned by it, their controller or their player state.
+	for (const AActor* Owner = ContainerOwner; Owner; Owner = Owner->GetOwner())
+	{
+		if (Owner == this || Owner == GetController() || Owner == GetPlayerState())
+		{
+			return true;
+		}
+		if (Owner->IsA<APawn>() || Owner->IsA<AController>() || Owner->IsA<APlayerState>())
+		{
+			return false;
+		}
+	}
+
+	// World containers, chests and stashes, have to be in reach, same as interacting with them
+	const float MaxDistance = InteractionDistance + InteractionServerTolerance;
+	return FVector::DistSquared(GetActorLocation(), ContainerOwner->GetActorLocation()) <= FMath::Square(MaxDistance);
+}
+
+void ABaseCharacter::ServerInventoryTransaction_Implementation(const TArray<FInventoryOp>& Operations)
+{
+	if (Operations.Num() > MaxInventoryOpsPerTransaction)
+	{
+		return;
+	}
+
+	for (const FInventoryOp& Operation : Operations)
+	{
+		if (!CanAccessContainer(Operation.From) || !CanAccessContainer(Operation.To))
+		{
+			return;
+		}
+	}
+
+	UItemContainerComponent::ApplyTransaction(Operations);
+}
+
+void ABaseCharacter::HandleContainerItemCountChanged(UItemContainerComponent* Container, FItemId ItemId, int32 Delta)
+{
+	ItemCounts.AddCount(ItemId, Delta);
+	OnItemCountChanged.Broadcast(ItemId, ItemCounts.GetCount(ItemId));
+}
+
+int32 ABaseCharacter::K2_GetItemCount(FName ItemName) const
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	return ItemRegistry ? GetItemCount(ItemRegistry->FindItemId(ItemName)) : 0;
+}
+
+static void RunContainerAccessCheck(UWorld* World)
+{
+	// Every character against every other character's containers, none of which it may touch
+	int32 NumChecked = 0, NumAccessible = 0;
+	for (TActorIterator<ABaseCharacter> It(World); It; ++It)
+	{
+		for (TActorIterator<ABaseCharacter> Other(World); Other; ++Other)
+		{
+			if (*Other == *It)
+			{
+				continue;
+			}
+
+			TInlineComponentArray<UItemContainerComponent*> Containers(*Other);
+			for (const UItemContainerComponent* Container : Containers)
+			{
+				++NumChecked;
+				if (It->CanAccessContainer(Container))
+				{
+					++NumAccessible;
+					UE_LOG(LogInventory, Error, TEXT("%s can access %s of %s"), *It->GetName(), *Container->GetName(),
+					       *Other->GetName());
+				}
+			}
+		}
+	}
+
+	UE_LOG(LogInventory, Display, TEXT("Container access: %d containers of other characters checked, %d accessible"),
+	       NumChecked, NumAccessible);
+}
+
+static FAutoConsoleCommand ContainerAccessCheckCommand(
+	TEXT("ate.Inventory.CheckContainerAccess"),
+	TEXT("Checks that no character in the world may transact with another character's containers"),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&RunContainerAccessCheck));
@@ -4,10 +4,14 @@
 
 #include "CoreMinimal.h"
 #include "InputActionValue.h"
+#include "AfterTheEnd/Components/InteractionComponent.h"
+#include "AfterTheEnd/Components/ItemContainerComponent.h"
 #include "GameFramework/Character.h"
 #include "BaseCharacter.generated.h"
 
 class UCameraComponent;
+class UDamageType;
+class UHitboxHistoryComponent;
 class USpringArmComponent;
 class UInputAction;
 class UInputMappingContext;
@@ -25,10 +29,45 @@ public:
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	float GetInteractionDistance() const { return InteractionDistance; }
+
+	// Called by the significance manager when this character changes bucket, 0 is least significant
+	void ApplySignificance(int32 SignificanceLevel);
+
+	// Hides the non-replicated attachments that aren't hidden yet, for the least significant level
+	void HideCosmetics();
+
+	static constexpr int32 MaxSignificanceLevel = 3;
+
+	// Sum over all of this character's containers
+	int32 GetItemCount(FItemId ItemId) const { return ItemCounts.GetCount(ItemId); }
+
+	const FItemCountHistogram& GetItemCounts() const { return ItemCounts; }
+
+	UFUNCTION(BlueprintPure, Category=Inventory, meta=(DisplayName="Get Item Count"))
+	int32 K2_GetItemCount(FName ItemName) const;
+
+	// A whole drag and drop, split or quick move as one request, applied entirely or not at all
+	UFUNCTION(BlueprintCallable, Category=Inventory)
+	void RequestInventoryTransaction(const TArray<FInventoryOp>& Operations);
+
+	// Whether inventory transactions from this character may move items in or out of the container
+	bool CanAccessContainer(const UItemContainerComponent* Container) const;
+
+	// Item id and its new total across all containers
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FOnTotalItemCountChanged, FItemId, int32);
+	FOnTotalItemCountChanged OnItemCountChanged;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or the character is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void PossessedBy(AController* NewController) override;
+	virtual void OnRep_Controller() override;
+
 	/*
 	 * CAMERA
 	 */
@@ -41,11 +80,96 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Mesh)
 	TObjectPtr<USkeletalMeshComponent> FirstPersonMesh;
 
+	// Third person animation tick interval per significance level, index 0 is the least significant
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Mesh)
+	TArray<float> AnimationTickIntervals = {0.25f, 0.1f, 1.f / 30.f, 0.f};
+
+	struct FHiddenCosmetic
+	{
+		TWeakObjectPtr<AActor> Actor;
+		bool bTickEnabled;
+	};
+
+	// Attachments hidden by HideCosmetics, and whether they ticked before
+	TArray<FHiddenCosmetic> HiddenCosmetics;
+
+	void ShowCosmetics();
+
+	// Only the owning player ever sees the first person mesh
+	void UpdateFirstPersonMesh();
+
+	/*
+	 * COMBAT
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Combat)
+	TObjectPtr<UHitboxHistoryComponent> HitboxHistory;
+
+	// Set by the equipped tool
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Combat)
+	float MeleeDamage = 10.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Combat)
+	float MeleeRange = 200.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Combat)
+	float MeleeRadius = 20.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Combat)
+	float MeleeCooldown = 0.6f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Combat)
+	TSubclassOf<UDamageType> MeleeDamageType;
+
+	// How far the client's swing origin may be from the server's camera before it is rejected
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Combat)
+	float MeleeServerTolerance = 100.f;
+
+	double LastMeleeSwingTime = -1.0;
+
+	UFUNCTION(Server, Unreliable)
+	void ServerMeleeSwing(FVector_NetQuantize10 Start, FVector_NetQuantizeNormal Direction, double Timestamp);
+
 	/*
 	 * INTERACTION
 	 */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Interaction)
 	float InteractionDistance = 500.f;
+
+	// Half angle of the view cone searched for interactables
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Interaction)
+	float InteractionAngle = 15.f;
+
+	// Slack on top of InteractionDistance when the server validates a request, covers movement in flight
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Interaction)
+	float InteractionServerTolerance = 150.f;
+
+	// Upper bound on interactions the server accepts from a single batch
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Interaction)
+	int32 MaxInteractionsPerBatch = 16;
+
+	// Interactions requested this frame, sent to the server as one RPC on the next tick
+	TArray<FInteractableHandle> PendingInteractions;
+
+	void RequestInteract(UInteractionComponent* InteractionComponent);
+	void FlushPendingInteractions();
+	bool CanReachInteractable(const UInteractionComponent* InteractionComponent, float MaxDistance) const;
+
+	UFUNCTION(Server, Reliable)
+	void ServerInteract(const TArray<FInteractableHandle>& Handles);
+
+	/*
+	 * INVENTORY
+	 */
+	// Upper bound on operations the server accepts in a single transaction
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Inventory)
+	int32 MaxInventoryOpsPerTransaction = 32;
+
+	void HandleContainerItemCountChanged(UItemContainerComponent* Container, FItemId ItemId, int32 Delta);
+
+	FItemCountHistogram ItemCounts;
+
+	UFUNCTION(Server, Reliable)
+	void ServerInventoryTransaction(const TArray<FInventoryOp>& Operations);
 	
 	/*
 	 * INPUT
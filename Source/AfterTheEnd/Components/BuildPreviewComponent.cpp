@@ -0,0 +1,315 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildPreviewComponent.h"
+#include "AfterTheEnd/Building/BuildingBaseAggregator.h"
+#include "AfterTheEnd/Subsystems/BuildingPrivilegeSubsystem.h"
+#include "AfterTheEnd/Subsystems/BuildingSnapSubsystem.h"
+#include "Components/MeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+
+// Sets default values for this component's properties
+UBuildPreviewComponent::UBuildPreviewComponent()
+{
+	// Only ticks while previewing
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	// WorldDynamic and Pawn in the default object type order
+	BlockingObjectTypes = {ObjectTypeQuery2, ObjectTypeQuery3};
+}
+
+// Called when the game starts
+void UBuildPreviewComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	BuildingSnap = GetWorld()->GetSubsystem<UBuildingSnapSubsystem>();
+	StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	BuildingPrivilege = GetWorld()->GetSubsystem<UBuildingPrivilegeSubsystem>();
+	TraceDelegate.BindUObject(this, &UBuildPreviewComponent::HandleTraceDone);
+	OverlapDelegate.BindUObject(this, &UBuildPreviewComponent::HandleOverlapDone);
+}
+
+void UBuildPreviewComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (AActor* Preview : PreviewActors)
+	{
+		if (Preview)
+		{
+			Preview->Destroy();
+		}
+	}
+	PreviewActors.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AActor* UBuildPreviewComponent::GetPreviewActor() const
+{
+	return PreviewActors.IsValidIndex(CurrentType) ? PreviewActors[CurrentType].Get() : nullptr;
+}
+
+void UBuildPreviewComponent::StartPreview(TSubclassOf<AActor> StructureClass)
+{
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	const FStructureTypeId TypeId = StructureRegistry && StructureClass
+		                                ? StructureRegistry->FindStructureType(StructureClass)
+		                                : InvalidStructureType;
+	if (!Pawn || !Pawn->IsLocallyControlled() || TypeId == InvalidStructureType)
+	{
+		StopPreview();
+		return;
+	}
+	if (TypeId == CurrentType)
+	{
+		return;
+	}
+
+	if (AActor* Previous = GetPreviewActor())
+	{
+		Previous->SetActorHiddenInGame(true);
+	}
+
+	CurrentType = TypeId;
+	++PreviewSerial;
+	bTraceInFlight = false;
+	TargetPiece = INDEX_NONE;
+
+	AActor* Preview = FindOrSpawnPreview(TypeId);
+	if (!Preview)
+	{
+		StopPreview();
+		return;
+	}
+
+	Preview->SetActorTransform(PlacementTransform);
+	Preview->SetActorHiddenInGame(false);
+	SetPreviewValid(false, true);
+	SetComponentTickEnabled(true);
+}
+
+void UBuildPreviewComponent::StopPreview()
+{
+	if (AActor* Preview = GetPreviewActor())
+	{
+		Preview->SetActorHiddenInGame(true);
+	}
+
+	CurrentType = InvalidStructureType;
+	++PreviewSerial;
+	bTraceInFlight = false;
+	bPlacementValid = false;
+	SetComponentTickEnabled(false);
+}
+
+AActor* UBuildPreviewComponent::FindOrSpawnPreview(FStructureTypeId TypeId)
+{
+	if (PreviewActors.Num() <= TypeId)
+	{
+		const int32 NumTypes = StructureRegistry->GetNumStructureTypes();
+		PreviewActors.SetNum(NumTypes);
+		PreviewMeshes.SetNum(NumTypes);
+		PreviewBounds.SetNum(NumTypes);
+	}
+	if (PreviewActors[TypeId])
+	{
+		return PreviewActors[TypeId];
+	}
+
+	// Tagged before the spawn handlers see it, which happens inside the spawn, so the snap index
+	// never takes it for a piece
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.Owner = GetOwner();
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.bDeferConstruction = true;
+	SpawnParameters.CustomPreSpawnInitalization = [](AActor* Actor)
+	{
+		Actor->Tags.Add(UBuildingSnapSubsystem::PreviewTag);
+	};
+
+	UClass* BuildClass = StructureRegistry->GetStructureType(TypeId).BuildClass;
+	AActor* Preview = BuildClass
+		                  ? GetWorld()->SpawnActor<AActor>(BuildClass, PlacementTransform, SpawnParameters)
+		                  : nullptr;
+	if (!Preview)
+	{
+		return nullptr;
+	}
+
+	// Kept local to this machine
+	Preview->SetReplicates(false);
+	Preview->FinishSpawning(PlacementTransform);
+	Preview->SetActorEnableCollision(false);
+	Preview->SetActorTickEnabled(false);
+
+	// Bounds from the visible meshes only, the snap boxes reach past the piece
+	FBox Bounds(ForceInit);
+	TInlineComponentArray<UMeshComponent*> Meshes(Preview);
+	for (UMeshComponent* Mesh : Meshes)
+	{
+		if (!Mesh->IsVisible())
+		{
+			continue;
+		}
+
+		Mesh->SetCastShadow(false);
+		PreviewMeshes[TypeId].Add(Mesh);
+		const FTransform MeshToActor = Mesh->GetComponentTransform().GetRelativeTransform(
+			Preview->GetActorTransform());
+		Bounds += Mesh->CalcBounds(MeshToActor).GetBox();
+	}
+
+	PreviewActors[TypeId] = Preview;
+	PreviewBounds[TypeId] = Bounds;
+	return Preview;
+}
+
+void UBuildPreviewComponent::SetPreviewValid(bool bValid, bool bForce)
+{
+	bPlacementValid = bValid;
+	if (bValid == bMaterialValid && !bForce)
+	{
+		return;
+	}
+
+	bMaterialValid = bValid;
+	UMaterialInterface* Material = bValid ? ValidMaterial : InvalidMaterial;
+	if (PreviewMeshes.IsValidIndex(CurrentType))
+	{
+		for (const TWeakObjectPtr<UMeshComponent>& Mesh : PreviewMeshes[CurrentType])
+		{
+			if (Mesh.IsValid())
+			{
+				for (int32 MaterialIndex = 0; MaterialIndex < Mesh->GetNumMaterials(); ++MaterialIndex)
+				{
+					Mesh->SetMaterial(MaterialIndex, Material);
+				}
+			}
+		}
+	}
+
+	OnValidityChanged.Broadcast(bValid);
+}
+
+void UBuildPreviewComponent::TickComponent(float DeltaTime, ELevelTick TickType,
+                                           FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// One query at a time, the ghost follows at the rate results come back
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	const AController* Controller = Pawn ? Pawn->GetController() : nullptr;
+	if (!IsPreviewing() || bTraceInFlight || !Controller)
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	Controller->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(BuildPreviewTrace), false, GetOwner());
+	Params.AddIgnoredActor(GetPreviewActor());
+	GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, ViewLocation,
+	                                    ViewLocation + ViewRotation.Vector() * TraceDistance, TraceChannel, Params,
+	                                    FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, PreviewSerial);
+	bTraceInFlight = true;
+}
+
+void UBuildPreviewComponent::HandleTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	AActor* Preview = GetPreviewActor();
+	if (Datum.UserData != PreviewSerial || !Preview)
+	{
+		return;
+	}
+
+	const FHitResult* Hit = Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit ? &Datum.OutHits[0] : nullptr;
+	const FVector Target = Hit ? FVector(Hit->ImpactPoint) : Datum.End;
+
+	bool bCanPlace;
+	const int32 Socket = BuildingSnap ? BuildingSnap->FindBestSocket(CurrentType, Target, SnapDistance) : INDEX_NONE;
+	if (Socket != INDEX_NONE)
+	{
+		PlacementTransform = BuildingSnap->GetSocketTransform(Socket);
+		TargetPiece = BuildingSnap->GetSocketPiece(Socket);
+		bCanPlace = true;
+	}
+	else
+	{
+		const AActor* HitActor = Hit ? Hit->GetActor() : nullptr;
+		const bool bHitBuilding = HitActor && (HitActor->IsA<ABuildingBaseAggregator>()
+			|| (BuildingSnap && BuildingSnap->IsPiece(HitActor)));
+		PlacementTransform = FTransform(FRotator(0.f, (Datum.End - Datum.Start).Rotation().Yaw + YawOffset, 0.f), Target);
+		TargetPiece = INDEX_NONE;
+		bCanPlace = Hit && !bHitBuilding && StructureRegistry->GetStructureType(CurrentType).bCanPlaceOnGround;
+	}
+	Preview->SetActorTransform(PlacementTransform);
+
+	// Someone else's building privilege rules the spot out before any overlap test
+	const FBox& Bounds = PreviewBounds[CurrentType];
+	if (bCanPlace && Bounds.IsValid && BuildingPrivilege)
+	{
+		const FBox WorldBounds = Bounds.TransformBy(PlacementTransform);
+		const APawn* Pawn = Cast<APawn>(GetOwner());
+		bCanPlace = BuildingPrivilege->GetPrivilegeInArea(Pawn ? Pawn->GetPlayerState() : nullptr,
+		                                                  FBox2D(FVector2D(WorldBounds.Min), FVector2D(WorldBounds.Max)))
+			!= EBuildPrivilege::Denied;
+	}
+	if (!bCanPlace || !Bounds.IsValid)
+	{
+		SetPreviewValid(bCanPlace);
+		bTraceInFlight = false;
+		return;
+	}
+
+	FCollisionObjectQueryParams ObjectParams;
+	for (const TEnumAsByte<EObjectTypeQuery> ObjectType : BlockingObjectTypes)
+	{
+		ObjectParams.AddObjectTypesToQuery(UEngineTypes::ConvertToCollisionChannel(ObjectType));
+	}
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(BuildPreviewOverlap), false, GetOwner());
+	Params.AddIgnoredActor(Preview);
+	GetWorld()->AsyncOverlapByObjectType(PlacementTransform.TransformPosition(Bounds.GetCenter()),
+	                                     PlacementTransform.GetRotation(), ObjectParams,
+	                                     FCollisionShape::MakeBox(Bounds.GetExtent() * OverlapScale
+		                                     * PlacementTransform.GetScale3D()), Params, &OverlapDelegate,
+	                                     PreviewSerial);
+}
+
+void UBuildPreviewComponent::HandleOverlapDone(const FTraceHandle& Handle, FOverlapDatum& Datum)
+{
+	if (Datum.UserData != PreviewSerial)
+	{
+		return;
+	}
+	bTraceInFlight = false;
+
+	// Anything but the piece the ghost snaps onto is in the way
+	bool bBlocked = false;
+	for (const FOverlapResult& Overlap : Datum.OutOverlaps)
+	{
+		const AActor* Actor = Overlap.GetActor();
+		int32 Piece = INDEX_NONE;
+		if (const ABuildingBaseAggregator* Base = Cast<ABuildingBaseAggregator>(Actor))
+		{
+			Piece = Base->GetInstanceSnapPiece(Overlap.GetComponent(), Overlap.ItemIndex);
+		}
+		else if (BuildingSnap)
+		{
+			Piece = BuildingSnap->FindPiece(Actor);
+		}
+
+		if (Piece == INDEX_NONE || Piece != TargetPiece)
+		{
+			bBlocked = true;
+			break;
+		}
+	}
+
+	SetPreviewValid(!bBlocked);
+}
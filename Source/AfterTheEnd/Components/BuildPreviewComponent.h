@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/EngineTypes.h"
+#include "WorldCollision.h"
+#include "AfterTheEnd/Subsystems/StructureRegistrySubsystem.h"
+#include "BuildPreviewComponent.generated.h"
+
+class UBuildingPrivilegeSubsystem;
+class UBuildingSnapSubsystem;
+class UMaterialInterface;
+class UMeshComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnBuildPreviewValidityChanged, bool, bValid);
+
+/*
+ * The build mode ghost for the locally controlled player. Each structure type gets one preview
+ * actor the first time it is selected, which is then hidden and shown again instead of being
+ * respawned, and only has its materials swapped between ValidMaterial and InvalidMaterial when
+ * the placement validity flips.
+ *
+ * The view trace and the overlap test run as async traces, their results arrive the next frame.
+ * Snapping goes through UBuildingSnapSubsystem, and spots claimed by someone else's
+ * UBuildingPrivilegeComponent are invalid.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UBuildPreviewComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UBuildPreviewComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType,
+	                           FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Shows the ghost of a structure, switching from the current one if there is one
+	UFUNCTION(BlueprintCallable, Category=Building)
+	void StartPreview(TSubclassOf<AActor> StructureClass);
+
+	UFUNCTION(BlueprintCallable, Category=Building)
+	void StopPreview();
+
+	// Turns the ghost while it isn't snapped
+	UFUNCTION(BlueprintCallable, Category=Building)
+	void RotatePreview(float DeltaYaw) { YawOffset = FRotator::NormalizeAxis(YawOffset + DeltaYaw); }
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool IsPreviewing() const { return CurrentType != InvalidStructureType; }
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool IsPlacementValid() const { return bPlacementValid; }
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	FTransform GetPlacementTransform() const { return PlacementTransform; }
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	AActor* GetPreviewActor() const;
+
+	UPROPERTY(BlueprintAssignable, Category=Building)
+	FOnBuildPreviewValidityChanged OnValidityChanged;
+
+	// MI_Green
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	TObjectPtr<UMaterialInterface> ValidMaterial;
+
+	// MI_Red
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	TObjectPtr<UMaterialInterface> InvalidMaterial;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	float TraceDistance = 800.f;
+
+	// How far from the aimed at point a free socket is snapped to
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	float SnapDistance = 150.f;
+
+	// What the ghost may not overlap
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building)
+	TArray<TEnumAsByte<EObjectTypeQuery>> BlockingObjectTypes;
+
+	// Share of the ghost's bounds tested for overlaps, leaves room for touching neighbours
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building, meta=(ClampMin=0, ClampMax=1))
+	float OverlapScale = 0.8f;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	AActor* FindOrSpawnPreview(FStructureTypeId TypeId);
+
+	// Swaps the ghost's materials only when validity flips, or when forced for a ghost just shown
+	void SetPreviewValid(bool bValid, bool bForce = false);
+
+	void HandleTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum);
+	void HandleOverlapDone(const FTraceHandle& Handle, FOverlapDatum& Datum);
+
+	// One per structure type, spawned on first use
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> PreviewActors;
+
+	// Mesh components of each preview actor, and its bounds relative to the actor
+	TArray<TArray<TWeakObjectPtr<UMeshComponent>>> PreviewMeshes;
+	TArray<FBox> PreviewBounds;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingSnapSubsystem> BuildingSnap;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStructureRegistrySubsystem> StructureRegistry;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingPrivilegeSubsystem> BuildingPrivilege;
+
+	FStructureTypeId CurrentType = InvalidStructureType;
+
+	// Bumped whenever the previewed type changes, results of older traces are dropped
+	uint32 PreviewSerial = 0;
+
+	FTraceDelegate TraceDelegate;
+	FOverlapDelegate OverlapDelegate;
+	bool bTraceInFlight = false;
+
+	FTransform PlacementTransform;
+
+	// Snap piece the ghost sits on, overlapping it is fine
+	int32 TargetPiece = INDEX_NONE;
+
+	bool bPlacementValid = false;
+	bool bMaterialValid = false;
+	float YawOffset = 0.f;
+};
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingPrivilegeComponent.h"
+#include "AfterTheEnd/Subsystems/BuildingPrivilegeSubsystem.h"
+#include "GameFramework/PlayerState.h"
+#include "Net/UnrealNetwork.h"
+
+// Sets default values for this component's properties
+UBuildingPrivilegeComponent::UBuildingPrivilegeComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetIsReplicatedByDefault(true);
+}
+
+void UBuildingPrivilegeComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UBuildingPrivilegeComponent, AuthorizedPlayers);
+}
+
+// Called when the game starts
+void UBuildingPrivilegeComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UBuildingPrivilegeSubsystem* BuildingPrivilege = GetWorld()->GetSubsystem<UBuildingPrivilegeSubsystem>())
+	{
+		const FVector2D Center(GetOwner()->GetActorLocation());
+		Claim = BuildingPrivilege->AddClaim(FBox2D(Center - ClaimExtent, Center + ClaimExtent));
+		BuildingPrivilege->SetAuthorized(Claim, AuthorizedPlayers);
+	}
+}
+
+void UBuildingPrivilegeComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UBuildingPrivilegeSubsystem* BuildingPrivilege = GetWorld()->GetSubsystem<UBuildingPrivilegeSubsystem>();
+	if (BuildingPrivilege && Claim != INDEX_NONE)
+	{
+		BuildingPrivilege->RemoveClaim(Claim);
+		Claim = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UBuildingPrivilegeComponent::Authorize(const APlayerState* Player)
+{
+	if (Player && Player->GetUniqueId().IsValid() && !IsAuthorized(Player))
+	{
+		AuthorizedPlayers.Add(Player->GetUniqueId());
+		OnRep_AuthorizedPlayers();
+	}
+}
+
+void UBuildingPrivilegeComponent::Deauthorize(const APlayerState* Player)
+{
+	if (Player && AuthorizedPlayers.Remove(Player->GetUniqueId()) > 0)
+	{
+		OnRep_AuthorizedPlayers();
+	}
+}
+
+void UBuildingPrivilegeComponent::ClearAuthorized()
+{
+	if (!AuthorizedPlayers.IsEmpty())
+	{
+		AuthorizedPlayers.Reset();
+		OnRep_AuthorizedPlayers();
+	}
+}
+
+bool UBuildingPrivilegeComponent::IsAuthorized(const APlayerState* Player) const
+{
+	return Player && Player->GetUniqueId().IsValid() && AuthorizedPlayers.Contains(Player->GetUniqueId());
+}
+
+void UBuildingPrivilegeComponent::OnRep_AuthorizedPlayers()
+{
+	UBuildingPrivilegeSubsystem* BuildingPrivilege = GetWorld()->GetSubsystem<UBuildingPrivilegeSubsystem>();
+	if (BuildingPrivilege && Claim != INDEX_NONE)
+	{
+		BuildingPrivilege->SetAuthorized(Claim, AuthorizedPlayers);
+	}
+
+	OnAuthorizedPlayersChanged.Broadcast();
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "GameFramework/OnlineReplStructs.h"
+#include "BuildingPrivilegeComponent.generated.h"
+
+class APlayerState;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnAuthorizedPlayersChanged);
+
+/*
+ * Claims building privilege over a square around its owner, the authorization object players
+ * place in their base. The authorized players replicate so clients can check their placement
+ * preview against the claim too. The owner isn't expected to move.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UBuildingPrivilegeComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UBuildingPrivilegeComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void Authorize(const APlayerState* Player);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void Deauthorize(const APlayerState* Player);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void ClearAuthorized();
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool IsAuthorized(const APlayerState* Player) const;
+
+	UPROPERTY(BlueprintAssignable, Category=Building)
+	FOnAuthorizedPlayersChanged OnAuthorizedPlayersChanged;
+
+	// Half the side of the claimed square
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Building, meta=(ClampMin=0))
+	float ClaimExtent = 2500.f;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when the game ends or the owner is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UFUNCTION()
+	void OnRep_AuthorizedPlayers();
+
+	UPROPERTY(ReplicatedUsing=OnRep_AuthorizedPlayers)
+	TArray<FUniqueNetIdRepl> AuthorizedPlayers;
+
+	// Handle into UBuildingPrivilegeSubsystem's grid
+	int32 Claim = INDEX_NONE;
+};
@@ -0,0 +1,474 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CraftingComponent.h"
+#include "AfterTheEnd/Character/BaseCharacter.h"
+#include "AfterTheEnd/Components/ItemContainerComponent.h"
+#include "AfterTheEnd/Components/PlayerStatsComponent.h"
+#include "AfterTheEnd/Subsystems/CraftingSubsystem.h"
+#include "AfterTheEnd/Subsystems/RecipeRegistrySubsystem.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCrafting, Log, All);
+
+static bool IsIngredientSource(const UItemContainerComponent* Container)
+{
+	// Never the armor the player is wearing
+	return Container->GetContainerType() == EContainerType::PlayerInventory
+		|| Container->GetContainerType() == EContainerType::PlayerHotbar;
+}
+
+// Sets default values for this component's properties
+UCraftingComponent::UCraftingComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetIsReplicatedByDefault(true);
+}
+
+void UCraftingComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(UCraftingComponent, CraftingQueue, COND_OwnerOnly);
+}
+
+// Called when the game starts
+void UCraftingComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Character = Cast<ABaseCharacter>(GetOwner());
+	RecipeRegistry = URecipeRegistrySubsystem::Get(GetWorld());
+
+	// Other players' crafting is none of our business
+	if (!Character || !RecipeRegistry || GetOwnerRole() == ROLE_SimulatedProxy)
+	{
+		return;
+	}
+
+	if (const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld()))
+	{
+		Planner.Build(RecipeRegistry->GetRecipes(), ItemRegistry->GetNumItems());
+	}
+
+	// Counted apart from the character's totals, those include its armor and storage
+	TInlineComponentArray<UItemContainerComponent*> Containers(GetOwner());
+	for (UItemContainerComponent* Container : Containers)
+	{
+		if (IsIngredientSource(Container))
+		{
+			IngredientCounts.Append(Container->GetItemCounts());
+			Container->OnItemCountChanged.AddUObject(this, &UCraftingComponent::HandleItemCountChanged);
+		}
+	}
+	if (UPlayerStatsComponent* StatsComponent = Character->FindComponentByClass<UPlayerStatsComponent>())
+	{
+		StatsComponent->OnLevelChanged.AddDynamic(this, &UCraftingComponent::HandleLevelChanged);
+	}
+
+	CraftableRecipes.Init(false, RecipeRegistry->GetNumRecipes());
+	DirtyRecipeMask.Init(false, RecipeRegistry->GetNumRecipes());
+	MarkAllRecipesDirty();
+}
+
+int32 UCraftingComponent::GetCharacterLevel() const
+{
+	const UPlayerStatsComponent* StatsComponent = Character ? Character->FindComponentByClass<UPlayerStatsComponent>() : nullptr;
+	return StatsComponent ? StatsComponent->GetLevel() : 1;
+}
+
+bool UCraftingComponent::CanCraftRecipe(int32 RecipeId, int32 Count) const
+{
+	const FRecipeDefinition* Recipe = RecipeRegistry ? RecipeRegistry->FindRecipe(RecipeId) : nullptr;
+	if (!Recipe || !Character || Count <= 0 || Recipe->RequiredLevel > GetCharacterLevel())
+	{
+		return false;
+	}
+
+	for (const FRecipeIngredient& Ingredient : Recipe->Ingredients)
+	{
+		if (GetIngredientCount(Ingredient.ItemId) < static_cast<int64>(Ingredient.Quantity) * Count)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+TArray<int32> UCraftingComponent::GetCraftableRecipes() const
+{
+	TArray<int32> RecipeIds;
+	for (TConstSetBitIterator<> It(CraftableRecipes); It; ++It)
+	{
+		RecipeIds.Add(It.GetIndex());
+	}
+	return RecipeIds;
+}
+
+void UCraftingComponent::HandleItemCountChanged(UItemContainerComponent* Container, FItemId ItemId, int32 Delta)
+{
+	IngredientCounts.AddCount(ItemId, Delta);
+	Planner.InvalidateItem(ItemId);
+
+	for (const int32 RecipeId : RecipeRegistry->GetRecipesUsing(ItemId))
+	{
+		MarkRecipeDirty(RecipeId);
+	}
+}
+
+void UCraftingComponent::HandleLevelChanged(int32 NewLevel, int32 OldLevel)
+{
+	Planner.InvalidateAll();
+	MarkAllRecipesDirty();
+}
+
+void UCraftingComponent::MarkRecipeDirty(int32 RecipeId)
+{
+	if (DirtyRecipeMask[RecipeId])
+	{
+		return;
+	}
+
+	// A transaction changes several counts at once, evaluate them together next tick
+	if (DirtyRecipes.IsEmpty())
+	{
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UCraftingComponent::FlushDirtyRecipes);
+	}
+	DirtyRecipeMask[RecipeId] = true;
+	DirtyRecipes.Add(RecipeId);
+}
+
+void UCraftingComponent::MarkAllRecipesDirty()
+{
+	for (int32 RecipeId = 0; RecipeId < DirtyRecipeMask.Num(); ++RecipeId)
+	{
+		MarkRecipeDirty(RecipeId);
+	}
+}
+
+void UCraftingComponent::FlushDirtyRecipes()
+{
+	TArray<int32> ChangedRecipes;
+	for (const int32 RecipeId : DirtyRecipes)
+	{
+		DirtyRecipeMask[RecipeId] = false;
+
+		const bool bCraftable = CanCraftRecipe(RecipeId);
+		if (CraftableRecipes[RecipeId] != bCraftable)
+		{
+			CraftableRecipes[RecipeId] = bCraftable;
+			ChangedRecipes.Add(RecipeId);
+		}
+	}
+	DirtyRecipes.Reset();
+
+	if (!ChangedRecipes.IsEmpty())
+	{
+		OnCraftableRecipesChanged.Broadcast(ChangedRecipes);
+	}
+}
+
+void UCraftingComponent::RequestCraft(int32 RecipeId, int32 Count)
+{
+	if (GetOwner()->HasAuthority())
+	{
+		StartCraft(RecipeId, Count);
+		return;
+	}
+	ServerCraft(RecipeId, Count);
+}
+
+void UCraftingComponent::RequestCancelCraft(int32 EntryId)
+{
+	if (GetOwner()->HasAuthority())
+	{
+		CancelCraft(EntryId);
+		return;
+	}
+	ServerCancelCraft(EntryId);
+}
+
+void UCraftingComponent::ServerCraft_Implementation(int32 RecipeId, int32 Count)
+{
+	StartCraft(RecipeId, Count);
+}
+
+void UCraftingComponent::ServerCancelCraft_Implementation(int32 EntryId)
+{
+	CancelCraft(EntryId);
+}
+
+bool UCraftingComponent::StartCraft(int32 RecipeId, int32 Count)
+{
+	const FRecipeDefinition* Recipe = RecipeRegistry ? RecipeRegistry->FindRecipe(RecipeId) : nullptr;
+	if (!Recipe || Count <= 0 || Count > MaxBatchCount || CraftingQueue.Num() >= MaxQueueLength)
+	{
+		return false;
+	}
+
+	// One check and one reservation for the whole batch
+	if (!CanCraftRecipe(RecipeId, Count))
+	{
+		return false;
+	}
+	for (const FRecipeIngredient& Ingredient : Recipe->Ingredients)
+	{
+		TakeItem(Ingredient.ItemId, Ingredient.Quantity * Count);
+	}
+
+	AddQueueEntry(RecipeId, Count, false);
+	OnCraftingQueueChanged.Broadcast();
+	return true;
+}
+
+bool UCraftingComponent::StartCraftWithIntermediates(int32 RecipeId, int32 Count)
+{
+	if (!Character || Count <= 0 || Count > MaxBatchCount)
+	{
+		return false;
+	}
+
+	TArray<FCraftingStep> Steps;
+	if (!Planner.BuildPlan(RecipeId, Count, IngredientCounts, GetCharacterLevel(), Steps)
+		|| CraftingQueue.Num() + Steps.Num() > MaxQueueLength)
+	{
+		return false;
+	}
+
+	// Each step takes what it needs when it starts, intermediates don't exist until the step before finishes
+	for (const FCraftingStep& Step : Steps)
+	{
+		AddQueueEntry(Step.RecipeId, Step.Count, true);
+	}
+	OnCraftingQueueChanged.Broadcast();
+	return true;
+}
+
+void UCraftingComponent::AddQueueEntry(int32 RecipeId, int32 Count, bool bTakeIngredientsOnStart)
+{
+	FCraftingQueueEntry& Entry = CraftingQueue.AddDefaulted_GetRef();
+	Entry.EntryId = NextEntryId++;
+	Entry.RecipeId = RecipeId;
+	Entry.Count = Count;
+	Entry.Duration = CraftTime;
+	Entry.bTakeIngredientsOnStart = bTakeIngredientsOnStart;
+
+	if (CraftingQueue.Num() == 1)
+	{
+		if (const UCraftingSubsystem* CraftingSubsystem = GetWorld()->GetSubsystem<UCraftingSubsystem>())
+		{
+			StartHeadEntry(CraftingSubsystem->GetServerTime());
+		}
+	}
+}
+
+int32 UCraftingComponent::GetMaxCraftable(int32 RecipeId)
+{
+	return Character ? Planner.GetMaxCraftable(RecipeId, IngredientCounts, GetCharacterLevel()) : 0;
+}
+
+void UCraftingComponent::RequestCraftWithIntermediates(int32 RecipeId, int32 Count)
+{
+	if (GetOwner()->HasAuthority())
+	{
+		StartCraftWithIntermediates(RecipeId, Count);
+		return;
+	}
+	ServerCraftWithIntermediates(RecipeId, Count);
+}
+
+void UCraftingComponent::ServerCraftWithIntermediates_Implementation(int32 RecipeId, int32 Count)
+{
+	StartCraftWithIntermediates(RecipeId, Count);
+}
+
+void UCraftingComponent::CancelCraft(int32 EntryId)
+{
+	const int32 QueueIndex = CraftingQueue.IndexOfByPredicate([EntryId](const FCraftingQueueEntry& Entry)
+	{
+		return Entry.EntryId == EntryId;
+	});
+	if (QueueIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FCraftingQueueEntry Entry = CraftingQueue[QueueIndex];
+	CraftingQueue.RemoveAt(QueueIndex);
+
+	const FRecipeDefinition* Recipe = RecipeRegistry->FindRecipe(Entry.RecipeId);
+	if (Recipe && !Entry.bTakeIngredientsOnStart)
+	{
+		const int32 Remaining = Entry.Count - Entry.Completed;
+		for (const FRecipeIngredient& Ingredient : Recipe->Ingredients)
+		{
+			if (const int32 Lost = GiveItem(Ingredient.ItemId, Ingredient.Quantity * Remaining))
+			{
+				UE_LOG(LogCrafting, Warning, TEXT("%s: no room to refund %d of item %d"), *GetOwner()->GetName(), Lost,
+				       Ingredient.ItemId);
+			}
+		}
+	}
+
+	if (QueueIndex == 0 && !CraftingQueue.IsEmpty())
+	{
+		if (const UCraftingSubsystem* CraftingSubsystem = GetWorld()->GetSubsystem<UCraftingSubsystem>())
+		{
+			StartHeadEntry(CraftingSubsystem->GetServerTime());
+		}
+	}
+
+	OnCraftingQueueChanged.Broadcast();
+}
+
+void UCraftingComponent::StartHeadEntry(double StartTime)
+{
+	while (!CraftingQueue.IsEmpty())
+	{
+		FCraftingQueueEntry& Head = CraftingQueue[0];
+		if (Head.bTakeIngredientsOnStart)
+		{
+			// The inventory changed since the plan was made, drop the step
+			const FRecipeDefinition* Recipe = RecipeRegistry->FindRecipe(Head.RecipeId);
+			if (!Recipe || !CanCraftRecipe(Head.RecipeId, Head.Count))
+			{
+				CraftingQueue.RemoveAt(0);
+				continue;
+			}
+			for (const FRecipeIngredient& Ingredient : Recipe->Ingredients)
+			{
+				TakeItem(Ingredient.ItemId, Ingredient.Quantity * Head.Count);
+			}
+			Head.bTakeIngredientsOnStart = false;
+		}
+
+		Head.StartTime = StartTime;
+		if (UCraftingSubsystem* CraftingSubsystem = GetWorld()->GetSubsystem<UCraftingSubsystem>())
+		{
+			CraftingSubsystem->ScheduleCompletion(this, Head.EntryId, StartTime + Head.Duration);
+		}
+		return;
+	}
+}
+
+void UCraftingComponent::CompleteCraftingUnit(int32 EntryId, double DueTime)
+{
+	UCraftingSubsystem* CraftingSubsystem = GetWorld()->GetSubsystem<UCraftingSubsystem>();
+	if (CraftingQueue.IsEmpty() || CraftingQueue[0].EntryId != EntryId || !CraftingSubsystem)
+	{
+		// Cancelled since it was scheduled
+		return;
+	}
+
+	FCraftingQueueEntry& Head = CraftingQueue[0];
+	const FRecipeDefinition* Recipe = RecipeRegistry->FindRecipe(Head.RecipeId);
+	if (!Recipe)
+	{
+		return;
+	}
+
+	if (GetRoomFor(Recipe->OutputItemId) < Recipe->OutputQuantity)
+	{
+		CraftingSubsystem->ScheduleCompletion(this, EntryId, DueTime + NoRoomRetryDelay);
+		return;
+	}
+
+	GiveItem(Recipe->OutputItemId, Recipe->OutputQuantity);
+	if (UPlayerStatsComponent* StatsComponent = Character->FindComponentByClass<UPlayerStatsComponent>())
+	{
+		StatsComponent->GrantExperience(Recipe->Experience);
+	}
+
+	// A unit held back for room pushes the rest of the batch back with it
+	const double ExpectedTime = Head.StartTime + Head.Duration * (Head.Completed + 1);
+	if (DueTime > ExpectedTime)
+	{
+		Head.StartTime += DueTime - ExpectedTime;
+	}
+
+	if (++Head.Completed < Head.Count)
+	{
+		CraftingSubsystem->ScheduleCompletion(this, EntryId, Head.StartTime + Head.Duration * (Head.Completed + 1));
+		return;
+	}
+
+	CraftingQueue.RemoveAt(0);
+	if (!CraftingQueue.IsEmpty())
+	{
+		StartHeadEntry(DueTime);
+	}
+	OnCraftingQueueChanged.Broadcast();
+}
+
+float UCraftingComponent::GetEntryProgress(int32 QueueIndex) const
+{
+	if (!CraftingQueue.IsValidIndex(QueueIndex) || CraftingQueue[QueueIndex].StartTime <= 0.0)
+	{
+		return 0.f;
+	}
+
+	const FCraftingQueueEntry& Entry = CraftingQueue[QueueIndex];
+	const double TotalDuration = Entry.Duration * Entry.Count;
+	if (TotalDuration <= 0.0)
+	{
+		return 1.f;
+	}
+
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const double Now = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	return static_cast<float>(FMath::Clamp((Now - Entry.StartTime) / TotalDuration, 0.0, 1.0));
+}
+
+void UCraftingComponent::OnRep_CraftingQueue()
+{
+	OnCraftingQueueChanged.Broadcast();
+}
+
+int32 UCraftingComponent::GiveItem(FItemId ItemId, int32 Quantity)
+{
+	TInlineComponentArray<UItemContainerComponent*> Containers(GetOwner());
+	for (UItemContainerComponent* Container : Containers)
+	{
+		// Crafted armor goes to the inventory, not straight onto the player
+		if (Quantity > 0 && Container->GetContainerType() != EContainerType::PlayerArmor)
+		{
+			Quantity = Container->AddItem(ItemId, Quantity);
+		}
+	}
+	return Quantity;
+}
+
+int32 UCraftingComponent::GetIngredientCount(FItemId ItemId) const
+{
+	return IngredientCounts.GetCount(ItemId);
+}
+
+int32 UCraftingComponent::TakeItem(FItemId ItemId, int32 Quantity)
+{
+	TInlineComponentArray<UItemContainerComponent*> Containers(GetOwner());
+	for (UItemContainerComponent* Container : Containers)
+	{
+		if (Quantity > 0 && IsIngredientSource(Container))
+		{
+			Quantity = Container->RemoveItem(ItemId, Quantity);
+		}
+	}
+	return Quantity;
+}
+
+int32 UCraftingComponent::GetRoomFor(FItemId ItemId) const
+{
+	int32 Room = 0;
+	TInlineComponentArray<UItemContainerComponent*> Containers(GetOwner());
+	for (const UItemContainerComponent* Container : Containers)
+	{
+		if (Container->GetContainerType() != EContainerType::PlayerArmor)
+		{
+			Room += Container->GetRoomFor(ItemId);
+		}
+	}
+	return Room;
+}
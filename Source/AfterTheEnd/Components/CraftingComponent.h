@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AfterTheEnd/Components/ItemContainerComponent.h"
+#include "AfterTheEnd/Crafting/CraftingPlanner.h"
+#include "AfterTheEnd/Subsystems/ItemRegistrySubsystem.h"
+#include "CraftingComponent.generated.h"
+
+class ABaseCharacter;
+class URecipeRegistrySubsystem;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnCraftableRecipesChanged, const TArray<int32>&, ChangedRecipes);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnCraftingQueueChanged);
+
+/*
+ * A batch of one recipe in the crafting queue. Clients derive progress from the start time and
+ * duration, nothing replicates while it runs.
+ */
+USTRUCT(BlueprintType)
+struct FCraftingQueueEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category=Crafting)
+	int32 EntryId = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category=Crafting)
+	int32 RecipeId = INDEX_NONE;
+
+	UPROPERTY(BlueprintReadOnly, Category=Crafting)
+	int32 Count = 0;
+
+	// Server time the first unit started, 0 while waiting behind other entries
+	UPROPERTY(BlueprintReadOnly, Category=Crafting)
+	double StartTime = 0.0;
+
+	// Per unit
+	UPROPERTY(BlueprintReadOnly, Category=Crafting)
+	float Duration = 0.f;
+
+	// Units handed out so far, server only
+	UPROPERTY(NotReplicated)
+	int32 Completed = 0;
+
+	// Planned intermediates take their ingredients when they reach the head of the queue, server only
+	UPROPERTY(NotReplicated)
+	bool bTakeIngredientsOnStart = false;
+};
+
+/*
+ * Crafting for the owning character. Keeps the set of recipes that can be crafted right now up to
+ * date from the item counts of its inventory and hotbar: a changed count only re-evaluates the
+ * recipes using that item, and the UI is told which recipes flipped, once per frame.
+ *
+ * The crafting queue lives here too. It doesn't tick, UCraftingSubsystem calls back when the head
+ * entry's next unit is due.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UCraftingComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UCraftingComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Level and ingredients allow crafting Count of the recipe
+	bool CanCraftRecipe(int32 RecipeId, int32 Count = 1) const;
+
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	bool IsRecipeCraftable(int32 RecipeId) const { return CraftableRecipes.IsValidIndex(RecipeId) && CraftableRecipes[RecipeId]; }
+
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	TArray<int32> GetCraftableRecipes() const;
+
+	// Recipes whose craftable state changed since the last broadcast, query IsRecipeCraftable for the new state
+	UPROPERTY(BlueprintAssignable)
+	FOnCraftableRecipesChanged OnCraftableRecipesChanged;
+
+	// Queues Count units of the recipe, ingredients for all of them are taken up front
+	UFUNCTION(BlueprintCallable, Category=Crafting)
+	void RequestCraft(int32 RecipeId, int32 Count = 1);
+
+	// Refunds the ingredients of the units not crafted yet
+	UFUNCTION(BlueprintCallable, Category=Crafting)
+	void RequestCancelCraft(int32 EntryId);
+
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	const TArray<FCraftingQueueEntry>& GetCraftingQueue() const { return CraftingQueue; }
+
+	// 0 to 1 over the whole batch, computed locally from server time
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	float GetEntryProgress(int32 QueueIndex) const;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnCraftingQueueChanged OnCraftingQueueChanged;
+
+	// Most times the recipe can be crafted, crafting missing intermediates along the way
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	int32 GetMaxCraftable(int32 RecipeId);
+
+	// Queues the missing intermediates followed by the recipe itself
+	UFUNCTION(BlueprintCallable, Category=Crafting)
+	void RequestCraftWithIntermediates(int32 RecipeId, int32 Count = 1);
+
+	// Called by UCraftingSubsystem when a unit of the queue head is due
+	void CompleteCraftingUnit(int32 EntryId, double DueTime);
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	void HandleItemCountChanged(UItemContainerComponent* Container, FItemId ItemId, int32 Delta);
+
+	UFUNCTION()
+	void HandleLevelChanged(int32 NewLevel, int32 OldLevel);
+
+	void MarkRecipeDirty(int32 RecipeId);
+	void MarkAllRecipesDirty();
+	void FlushDirtyRecipes();
+
+	int32 GetCharacterLevel() const;
+
+	UFUNCTION(Server, Reliable)
+	void ServerCraft(int32 RecipeId, int32 Count);
+
+	UFUNCTION(Server, Reliable)
+	void ServerCancelCraft(int32 EntryId);
+
+	UFUNCTION(Server, Reliable)
+	void ServerCraftWithIntermediates(int32 RecipeId, int32 Count);
+
+	bool StartCraft(int32 RecipeId, int32 Count);
+	bool StartCraftWithIntermediates(int32 RecipeId, int32 Count);
+	void AddQueueEntry(int32 RecipeId, int32 Count, bool bTakeIngredientsOnStart);
+	void CancelCraft(int32 EntryId);
+	void StartHeadEntry(double StartTime);
+
+	// Across the character's containers but its armor, return what didn't fit or wasn't there.
+	// Ingredients only come out of the inventory and hotbar.
+	int32 GiveItem(FItemId ItemId, int32 Quantity);
+	int32 TakeItem(FItemId ItemId, int32 Quantity);
+	int32 GetRoomFor(FItemId ItemId) const;
+	int32 GetIngredientCount(FItemId ItemId) const;
+
+	UFUNCTION()
+	void OnRep_CraftingQueue();
+
+	// Seconds per crafted unit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Crafting, meta=(ClampMin=0))
+	float CraftTime = 2.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Crafting, meta=(ClampMin=1))
+	int32 MaxQueueLength = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Crafting, meta=(ClampMin=1))
+	int32 MaxBatchCount = 100;
+
+	// Delay before retrying a unit whose output didn't fit in the inventory
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Crafting, meta=(ClampMin=0.1))
+	float NoRoomRetryDelay = 1.f;
+
+	UPROPERTY(ReplicatedUsing=OnRep_CraftingQueue)
+	TArray<FCraftingQueueEntry> CraftingQueue;
+
+	int32 NextEntryId = 1;
+
+	UPROPERTY(Transient)
+	TObjectPtr<ABaseCharacter> Character;
+
+	UPROPERTY(Transient)
+	TObjectPtr<URecipeRegistrySubsystem> RecipeRegistry;
+
+	// What the inventory and hotbar hold, the only containers ingredients come out of
+	FItemCountHistogram IngredientCounts;
+
+	// Memoized against IngredientCounts
+	FCraftingPlanner Planner;
+
+	// Bit per recipe id
+	TBitArray<> CraftableRecipes;
+	TBitArray<> DirtyRecipeMask;
+	TArray<int32> DirtyRecipes;
+};
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HitboxHistoryComponent.h"
+#include "AfterTheEnd/Subsystems/MeleeCombatSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+
+// Sets default values for this component's properties
+UHitboxHistoryComponent::UHitboxHistoryComponent()
+{
+	// History is recorded in one pass by UMeleeCombatSubsystem
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UHitboxHistoryComponent::SetHitbox(UPrimitiveComponent* NewHitbox)
+{
+	Unregister();
+	Hitbox = NewHitbox;
+	if (HasBegunPlay())
+	{
+		Register();
+	}
+}
+
+// Called when the game starts
+void UHitboxHistoryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!Hitbox)
+	{
+		Hitbox = Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent());
+	}
+	Register();
+}
+
+void UHitboxHistoryComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Unregister();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UHitboxHistoryComponent::Register()
+{
+	if (!Hitbox || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	if (UMeleeCombatSubsystem* MeleeSubsystem = GetWorld()->GetSubsystem<UMeleeCombatSubsystem>())
+	{
+		HistoryHandle = MeleeSubsystem->RegisterTarget(Hitbox);
+	}
+}
+
+void UHitboxHistoryComponent::Unregister()
+{
+	if (HistoryHandle == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (UMeleeCombatSubsystem* MeleeSubsystem = GetWorld()->GetSubsystem<UMeleeCombatSubsystem>())
+	{
+		MeleeSubsystem->UnregisterTarget(HistoryHandle);
+	}
+	HistoryHandle = INDEX_NONE;
+}
@@ -0,0 +1,43 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "HitboxHistoryComponent.generated.h"
+
+/*
+ * Marks the owner as a melee target. On the server the hitbox is recorded every tick by
+ * UMeleeCombatSubsystem so swings can be resolved against where the client saw it.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UHitboxHistoryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UHitboxHistoryComponent();
+
+	// Overrides the recorded hitbox, defaults to the owner's root primitive
+	UFUNCTION(BlueprintCallable, Category=Combat)
+	void SetHitbox(UPrimitiveComponent* NewHitbox);
+
+	UPrimitiveComponent* GetHitbox() const { return Hitbox; }
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when the game ends or the owner is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void Register();
+	void Unregister();
+
+	UPROPERTY(Transient)
+	TObjectPtr<UPrimitiveComponent> Hitbox;
+
+	// Handle into UMeleeCombatSubsystem's history buffers, server only
+	int32 HistoryHandle = INDEX_NONE;
+};
@@ -2,15 +2,28 @@
 
 
 #include "InteractionComponent.h"
+#include "AfterTheEnd/Subsystems/InteractionSubsystem.h"
+#include "Components/SceneComponent.h"
+#include "UObject/CoreNet.h"
+
+bool FInteractableHandle::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	UObject* ActorObject = Actor;
+	bOutSuccess = Map->SerializeObject(Ar, AActor::StaticClass(), ActorObject);
+	if (Ar.IsLoading())
+	{
+		Actor = Cast<AActor>(ActorObject);
+	}
+
+	Ar << InteractionId;
+	return true;
+}
 
 // Sets default values for this component's properties
 UInteractionComponent::UInteractionComponent()
 {
-	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
-	// off to improve performance if you don't need them.
-	PrimaryComponentTick.bCanEverTick = true;
-
-	// ...
+	// Focus is detected by UInteractionFocusSubsystem, so interactables never need to tick
+	PrimaryComponentTick.bCanEverTick = false;
 }
 
 
@@ -19,17 +32,62 @@ void UInteractionComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// ...
-	
+	InteractionSubsystem = GetWorld()->GetSubsystem<UInteractionSubsystem>();
+	if (!InteractionSubsystem)
+	{
+		return;
+	}
+
+	RegistryHandle = InteractionSubsystem->RegisterInteractable(this);
+
+	USceneComponent* Root = GetOwner()->GetRootComponent();
+	if (Root && Root->Mobility == EComponentMobility::Movable)
+	{
+		RootOffset = Root->GetComponentTransform().InverseTransformPosition(
+			InteractionSubsystem->GetRegisteredLocation(this));
+		Root->TransformUpdated.AddUObject(this, &UInteractionComponent::HandleOwnerMoved);
+	}
 }
 
+void UInteractionComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USceneComponent* Root = GetOwner()->GetRootComponent())
+	{
+		Root->TransformUpdated.RemoveAll(this);
+	}
 
-// Called every frame
-void UInteractionComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+	if (InteractionSubsystem)
+	{
+		InteractionSubsystem->UnregisterInteractable(RegistryHandle);
+	}
+	RegistryHandle = INDEX_NONE;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UInteractionComponent::HandleOwnerMoved(USceneComponent* UpdatedComponent,
+                                             EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
 {
-	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	InteractionSubsystem->UpdateInteractable(RegistryHandle,
+	                                         UpdatedComponent->GetComponentTransform().TransformPosition(RootOffset));
+}
+
+FInteractableHandle UInteractionComponent::GetHandle() const
+{
+	FInteractableHandle Handle;
+	Handle.Actor = GetOwner();
+	Handle.InteractionId = InteractionId;
+	return Handle;
+}
 
-	// ...
+void UInteractionComponent::NotifyFocusGained(AActor* Instigator)
+{
+	OnFocusGained.Broadcast(Instigator);
+}
+
+void UInteractionComponent::NotifyFocusLost(AActor* Instigator)
+{
+	OnFocusLost.Broadcast(Instigator);
 }
 
 void UInteractionComponent::Interact(AActor* Instigator)
@@ -6,7 +6,42 @@
 #include "Components/ActorComponent.h"
 #include "InteractionComponent.generated.h"
 
+class UInteractionSubsystem;
+class UPackageMap;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnInteract, AActor*, Instigator);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnInteractionFocus, AActor*, Instigator);
+
+/*
+ * Compact network reference to an interactable: the owner's net GUID plus the component's InteractionId
+ */
+USTRUCT(BlueprintType)
+struct AFTERTHEEND_API FInteractableHandle
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<AActor> Actor = nullptr;
+
+	UPROPERTY()
+	uint8 InteractionId = 0;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FInteractableHandle& Other) const
+	{
+		return Actor == Other.Actor && InteractionId == Other.InteractionId;
+	}
+};
+
+template <>
+struct TStructOpsTypeTraits<FInteractableHandle> : public TStructOpsTypeTraitsBase2<FInteractableHandle>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
 
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
 class AFTERTHEEND_API UInteractionComponent : public UActorComponent
@@ -16,16 +51,46 @@ class AFTERTHEEND_API UInteractionComponent : public UActorComponent
 public:	
 	// Sets default values for this component's properties
 	UInteractionComponent();
-	
-	// Called every frame
-    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	UPROPERTY(BlueprintAssignable)
     FOnInteract OnInteract;
+
+	// Distinguishes several interactables on the same actor, e.g. a door and its code lock
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Interaction)
+	uint8 InteractionId = 0;
+
+	// Fired on the local client when a player starts or stops looking at this interactable
+	UPROPERTY(BlueprintAssignable)
+	FOnInteractionFocus OnFocusGained;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnInteractionFocus OnFocusLost;
     
     void Interact(AActor* Instigator);
 
+	void NotifyFocusGained(AActor* Instigator);
+	void NotifyFocusLost(AActor* Instigator);
+
+	FInteractableHandle GetHandle() const;
+	int32 GetRegistryHandle() const { return RegistryHandle; }
+
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+
+	// Called when the game ends or the owner is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Keeps the grid entry of a movable owner where the owner is, dropped items and physics props
+	void HandleOwnerMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags,
+	                      ETeleportType Teleport);
+
+	// Handle into UInteractionSubsystem's spatial grid
+	int32 RegistryHandle = INDEX_NONE;
+
+	// Registered location relative to the owner's root, so a move doesn't recompute the bounds
+	FVector RootOffset = FVector::ZeroVector;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UInteractionSubsystem> InteractionSubsystem;
 };
@@ -0,0 +1,452 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemContainerComponent.h"
+#include "Net/UnrealNetwork.h"
+
+namespace
+{
+	// Slots touched by a transaction with their contents from before it started
+	struct FSlotJournal
+	{
+		struct FEntry
+		{
+			UItemContainerComponent* Container;
+			int32 SlotIndex;
+			FItemSlot Saved;
+		};
+
+		TArray<FEntry, TInlineAllocator<8>> Entries;
+
+		bool Contains(const UItemContainerComponent* Container, int32 SlotIndex) const
+		{
+			return Entries.ContainsByPredicate([Container, SlotIndex](const FEntry& Entry)
+			{
+				return Entry.Container == Container && Entry.SlotIndex == SlotIndex;
+			});
+		}
+	};
+
+	void ResetIfEmpty(FItemSlot& Slot)
+	{
+		if (Slot.Quantity <= 0)
+		{
+			Slot.ItemId = InvalidItemId;
+			Slot.ItemName = NAME_None;
+			Slot.Quantity = 0;
+			Slot.Durability = 0;
+		}
+	}
+
+	void SwapContents(FItemSlot& First, FItemSlot& Second)
+	{
+		Swap(First.ItemId, Second.ItemId);
+		Swap(First.ItemName, Second.ItemName);
+		Swap(First.Quantity, Second.Quantity);
+		Swap(First.Durability, Second.Durability);
+	}
+
+	void MoveQuantity(FItemSlot& Source, FItemSlot& Target, int32 Amount)
+	{
+		if (Target.IsEmpty())
+		{
+			Target.ItemId = Source.ItemId;
+			Target.ItemName = Source.ItemName;
+			Target.Durability = Source.Durability;
+		}
+		Target.Quantity += Amount;
+		Source.Quantity -= Amount;
+		ResetIfEmpty(Source);
+	}
+}
+
+void FItemSlot::PostReplicatedAdd(const FItemSlotArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->NotifySlotReplicated(*this);
+	}
+}
+
+void FItemSlot::PostReplicatedChange(const FItemSlotArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->NotifySlotReplicated(*this);
+	}
+}
+
+// Sets default values for this component's properties
+UItemContainerComponent::UItemContainerComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetIsReplicatedByDefault(true);
+
+	Slots.Owner = this;
+}
+
+void UItemContainerComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UItemContainerComponent, Slots);
+}
+
+// Called when the game starts
+void UItemContainerComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Slots.Owner = this;
+
+	if (GetOwner()->HasAuthority() && Slots.Items.Num() != NumSlots)
+	{
+		Slots.Items.SetNum(NumSlots);
+		for (int32 SlotIndex = 0; SlotIndex < NumSlots; ++SlotIndex)
+		{
+			Slots.Items[SlotIndex].SlotIndex = static_cast<uint16>(SlotIndex);
+		}
+		Slots.MarkArrayDirty();
+	}
+}
+
+const FItemSlot* UItemContainerComponent::FindSlot(int32 SlotIndex) const
+{
+	// Server side and in the common client case the array index is the slot index
+	if (Slots.Items.IsValidIndex(SlotIndex) && Slots.Items[SlotIndex].SlotIndex == SlotIndex)
+	{
+		return &Slots.Items[SlotIndex];
+	}
+	return Slots.Items.FindByPredicate([SlotIndex](const FItemSlot& Slot) { return Slot.SlotIndex == SlotIndex; });
+}
+
+FItemSlot* UItemContainerComponent::FindSlot(int32 SlotIndex)
+{
+	return const_cast<FItemSlot*>(static_cast<const UItemContainerComponent*>(this)->FindSlot(SlotIndex));
+}
+
+FItemSlot UItemContainerComponent::GetSlot(int32 SlotIndex) const
+{
+	const FItemSlot* Slot = FindSlot(SlotIndex);
+	return Slot ? *Slot : FItemSlot();
+}
+
+void UItemContainerComponent::MarkSlotDirty(FItemSlot& Slot)
+{
+	ResetIfEmpty(Slot);
+
+	Slots.MarkItemDirty(Slot);
+	UpdateItemCounts(Slot);
+	OnSlotChanged.Broadcast(this, Slot.SlotIndex);
+}
+
+void UItemContainerComponent::SetSlot(int32 SlotIndex, FName ItemName, int32 Quantity, int32 Durability)
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	SetSlotItem(SlotIndex, ItemRegistry ? ItemRegistry->FindItemId(ItemName) : InvalidItemId, Quantity, Durability);
+}
+
+void UItemContainerComponent::SetSlotItem(int32 SlotIndex, FItemId ItemId, int32 Quantity, int32 Durability)
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	if (!ItemRegistry || !ItemRegistry->IsValidItem(ItemId))
+	{
+		ItemId = InvalidItemId;
+	}
+
+	if (FItemSlot* Slot = FindSlot(SlotIndex))
+	{
+		Slot->ItemId = ItemId;
+		Slot->ItemName = ItemRegistry ? ItemRegistry->GetRowName(ItemId) : NAME_None;
+		Slot->Quantity = ItemId == InvalidItemId ? 0 : Quantity;
+		Slot->Durability = Durability;
+		MarkSlotDirty(*Slot);
+	}
+}
+
+void UItemContainerComponent::ClearSlot(int32 SlotIndex)
+{
+	if (FItemSlot* Slot = FindSlot(SlotIndex))
+	{
+		if (!Slot->IsEmpty())
+		{
+			Slot->Quantity = 0;
+			MarkSlotDirty(*Slot);
+		}
+	}
+}
+
+void UItemContainerComponent::SwapSlots(int32 FirstIndex, int32 SecondIndex)
+{
+	FItemSlot* First = FindSlot(FirstIndex);
+	FItemSlot* Second = FindSlot(SecondIndex);
+	if (!First || !Second || First == Second)
+	{
+		return;
+	}
+
+	SwapContents(*First, *Second);
+	MarkSlotDirty(*First);
+	MarkSlotDirty(*Second);
+}
+
+void UItemContainerComponent::UpdateItemCounts(const FItemSlot& Slot)
+{
+	if (!CountedContents.IsValidIndex(Slot.SlotIndex))
+	{
+		CountedContents.SetNumZeroed(Slot.SlotIndex + 1);
+	}
+
+	TPair<FItemId, int32>& Counted = CountedContents[Slot.SlotIndex];
+	const TPair<FItemId, int32> Current(Slot.IsEmpty() ? InvalidItemId : Slot.ItemId, Slot.IsEmpty() ? 0 : Slot.Quantity);
+	if (Counted == Current)
+	{
+		return;
+	}
+
+	const TPair<FItemId, int32> Previous = Counted;
+	Counted = Current;
+
+	if (Previous.Key == Current.Key)
+	{
+		ItemCounts.AddCount(Current.Key, Current.Value - Previous.Value);
+		OnItemCountChanged.Broadcast(this, Current.Key, Current.Value - Previous.Value);
+		return;
+	}
+
+	if (Previous.Key != InvalidItemId)
+	{
+		ItemCounts.AddCount(Previous.Key, -Previous.Value);
+		OnItemCountChanged.Broadcast(this, Previous.Key, -Previous.Value);
+	}
+	if (Current.Key != InvalidItemId)
+	{
+		ItemCounts.AddCount(Current.Key, Current.Value);
+		OnItemCountChanged.Broadcast(this, Current.Key, Current.Value);
+	}
+}
+
+int32 UItemContainerComponent::K2_GetItemCount(FName ItemName) const
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	return ItemRegistry ? GetItemCount(ItemRegistry->FindItemId(ItemName)) : 0;
+}
+
+bool UItemContainerComponent::CanHoldItem(FItemId ItemId) const
+{
+	if (ContainerType != EContainerType::PlayerArmor)
+	{
+		return true;
+	}
+
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	return ItemRegistry && ItemRegistry->IsItemOfType(ItemId, EItemType::Armor);
+}
+
+int32 UItemContainerComponent::GetRoomFor(FItemId ItemId) const
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	if (!ItemRegistry || !ItemRegistry->IsValidItem(ItemId) || !CanHoldItem(ItemId))
+	{
+		return 0;
+	}
+
+	const int32 StackSize = ItemRegistry->GetStackSize(ItemId);
+	int32 Room = 0;
+	for (const FItemSlot& Slot : Slots.Items)
+	{
+		if (Slot.IsEmpty())
+		{
+			Room += StackSize;
+		}
+		else if (Slot.ItemId == ItemId)
+		{
+			Room += FMath::Max(StackSize - Slot.Quantity, 0);
+		}
+	}
+	return Room;
+}
+
+int32 UItemContainerComponent::AddItem(FItemId ItemId, int32 Quantity)
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	if (!ItemRegistry || !ItemRegistry->IsValidItem(ItemId) || !CanHoldItem(ItemId))
+	{
+		return Quantity;
+	}
+
+	const int32 StackSize = ItemRegistry->GetStackSize(ItemId);
+
+	// Top up existing stacks before starting new ones
+	for (FItemSlot& Slot : Slots.Items)
+	{
+		if (Quantity <= 0)
+		{
+			break;
+		}
+		if (!Slot.IsEmpty() && Slot.ItemId == ItemId && Slot.Quantity < StackSize)
+		{
+			const int32 Added = FMath::Min(Quantity, StackSize - Slot.Quantity);
+			Slot.Quantity += Added;
+			Quantity -= Added;
+			MarkSlotDirty(Slot);
+		}
+	}
+
+	for (FItemSlot& Slot : Slots.Items)
+	{
+		if (Quantity <= 0)
+		{
+			break;
+		}
+		if (Slot.IsEmpty())
+		{
+			const int32 Added = FMath::Min(Quantity, StackSize);
+			Slot.ItemId = ItemId;
+			Slot.ItemName = ItemRegistry->GetRowName(ItemId);
+			Slot.Quantity = Added;
+			Slot.Durability = ItemRegistry->FindDefinition(ItemId)->MaxHP;
+			Quantity -= Added;
+			MarkSlotDirty(Slot);
+		}
+	}
+	return Quantity;
+}
+
+int32 UItemContainerComponent::RemoveItem(FItemId ItemId, int32 Quantity)
+{
+	if (GetItemCount(ItemId) <= 0)
+	{
+		return Quantity;
+	}
+
+	// From the back, so the slots the player filled first are the last to be emptied
+	for (int32 Index = Slots.Items.Num() - 1; Index >= 0 && Quantity > 0; --Index)
+	{
+		FItemSlot& Slot = Slots.Items[Index];
+		if (!Slot.IsEmpty() && Slot.ItemId == ItemId)
+		{
+			const int32 Removed = FMath::Min(Quantity, Slot.Quantity);
+			Slot.Quantity -= Removed;
+			Quantity -= Removed;
+			MarkSlotDirty(Slot);
+		}
+	}
+	return Quantity;
+}
+
+bool UItemContainerComponent::ApplyTransaction(TArrayView<const FInventoryOp> Operations)
+{
+	FSlotJournal Journal;
+
+	auto TouchSlot = [&Journal](UItemContainerComponent* Container, int32 SlotIndex) -> FItemSlot*
+	{
+		FItemSlot* Slot = Container ? Container->FindSlot(SlotIndex) : nullptr;
+		if (Slot && !Journal.Contains(Container, SlotIndex))
+		{
+			Journal.Entries.Add({Container, SlotIndex, *Slot});
+		}
+		return Slot;
+	};
+
+	auto ApplyOperation = [&TouchSlot](const FInventoryOp& Operation)
+	{
+		FItemSlot* Source = TouchSlot(Operation.From, Operation.FromSlot);
+		FItemSlot* Target = TouchSlot(Operation.To, Operation.ToSlot);
+		if (!Source || !Target || Source == Target || Source->IsEmpty())
+		{
+			return false;
+		}
+
+		if (Operation.Type == EInventoryOpType::Swap)
+		{
+			if (!Operation.To->CanHoldItem(Source->ItemId)
+				|| (!Target->IsEmpty() && !Operation.From->CanHoldItem(Target->ItemId)))
+			{
+				return false;
+			}
+			SwapContents(*Source, *Target);
+			return true;
+		}
+
+		const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(Operation.To->GetWorld());
+		const int32 StackSize = ItemRegistry ? ItemRegistry->GetStackSize(Source->ItemId) : 1;
+		const int32 Requested = Operation.Quantity > 0 ? Operation.Quantity : Source->Quantity;
+		if (Requested > Source->Quantity || !Operation.To->CanHoldItem(Source->ItemId))
+		{
+			return false;
+		}
+
+		switch (Operation.Type)
+		{
+		case EInventoryOpType::Move:
+			if (!Target->IsEmpty() && (Target->ItemId != Source->ItemId || Target->Quantity + Requested > StackSize))
+			{
+				return false;
+			}
+			MoveQuantity(*Source, *Target, Requested);
+			return true;
+
+		case EInventoryOpType::Split:
+			if (!Target->IsEmpty() || Requested >= Source->Quantity)
+			{
+				return false;
+			}
+			MoveQuantity(*Source, *Target, Requested);
+			return true;
+
+		case EInventoryOpType::Merge:
+			{
+				if (Target->IsEmpty() || Target->ItemId != Source->ItemId)
+				{
+					return false;
+				}
+				const int32 Amount = FMath::Min(Requested, StackSize - Target->Quantity);
+				if (Amount <= 0)
+				{
+					return false;
+				}
+				MoveQuantity(*Source, *Target, Amount);
+				return true;
+			}
+
+		default:
+			return false;
+		}
+	};
+
+	bool bSucceeded = true;
+	for (const FInventoryOp& Operation : Operations)
+	{
+		if (!ApplyOperation(Operation))
+		{
+			bSucceeded = false;
+			break;
+		}
+	}
+
+	for (FSlotJournal::FEntry& Entry : Journal.Entries)
+	{
+		FItemSlot* Slot = Entry.Container->FindSlot(Entry.SlotIndex);
+		if (!bSucceeded)
+		{
+			*Slot = Entry.Saved;
+		}
+		else if (Slot->ItemId != Entry.Saved.ItemId || Slot->Quantity != Entry.Saved.Quantity
+			|| Slot->Durability != Entry.Saved.Durability)
+		{
+			Entry.Container->MarkSlotDirty(*Slot);
+		}
+	}
+	return bSucceeded;
+}
+
+void UItemContainerComponent::NotifySlotReplicated(FItemSlot& Slot)
+{
+	const UItemRegistrySubsystem* ItemRegistry = UItemRegistrySubsystem::Get(GetWorld());
+	Slot.ItemName = ItemRegistry ? ItemRegistry->GetRowName(Slot.ItemId) : NAME_None;
+
+	UpdateItemCounts(Slot);
+	OnSlotChanged.Broadcast(this, Slot.SlotIndex);
+}
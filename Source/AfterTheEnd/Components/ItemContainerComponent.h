@@ -0,0 +1,252 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "AfterTheEnd/Subsystems/ItemRegistrySubsystem.h"
+#include "ItemContainerComponent.generated.h"
+
+class UItemContainerComponent;
+
+// Mirrors E_ContainerType
+UENUM(BlueprintType)
+enum class EContainerType : uint8
+{
+	PlayerInventory,
+	PlayerHotbar,
+	PlayerStorage,
+	PlayerArmor
+};
+
+UENUM(BlueprintType)
+enum class EInventoryOpType : uint8
+{
+	// Quantity (0 for all) into an empty slot or onto the same item, fails if it doesn't all fit
+	Move,
+	// Part of a stack into an empty slot
+	Split,
+	// As much as fits onto the same item, the rest stays behind
+	Merge,
+	Swap
+};
+
+/*
+ * One step of an inventory transaction, e.g. a drag and drop between two slots.
+ */
+USTRUCT(BlueprintType)
+struct FInventoryOp
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	EInventoryOpType Type = EInventoryOpType::Move;
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	TObjectPtr<UItemContainerComponent> From = nullptr;
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	int32 FromSlot = 0;
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	TObjectPtr<UItemContainerComponent> To = nullptr;
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	int32 ToSlot = 0;
+
+	UPROPERTY(BlueprintReadWrite, Category=Inventory)
+	int32 Quantity = 0;
+};
+
+/*
+ * Item count per item id, kept up to date as slots change so "how many X" is an array read.
+ */
+struct AFTERTHEEND_API FItemCountHistogram
+{
+	int32 GetCount(FItemId ItemId) const { return Counts.IsValidIndex(ItemId) ? Counts[ItemId] : 0; }
+
+	void AddCount(FItemId ItemId, int32 Delta)
+	{
+		if (ItemId == InvalidItemId || Delta == 0)
+		{
+			return;
+		}
+		if (!Counts.IsValidIndex(ItemId))
+		{
+			Counts.SetNumZeroed(ItemId + 1);
+		}
+		Counts[ItemId] += Delta;
+	}
+
+	void Append(const FItemCountHistogram& Other)
+	{
+		for (int32 ItemId = 0; ItemId < Other.Counts.Num(); ++ItemId)
+		{
+			AddCount(static_cast<FItemId>(ItemId), Other.Counts[ItemId]);
+		}
+	}
+
+	void Reset() { Counts.Reset(); }
+
+private:
+	TArray<int32> Counts;
+};
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnItemCountChanged, UItemContainerComponent* /*Container*/, FItemId /*ItemId*/,
+                                       int32 /*Delta*/);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnSlotChanged, UItemContainerComponent*, Container, int32, SlotIndex);
+
+/*
+ * A single container slot. Only the fields the client needs to draw the slot, everything else
+ * about the item comes from UItemRegistrySubsystem.
+ */
+USTRUCT(BlueprintType)
+struct FItemSlot : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	// What replicates, the row name is resolved from it on arrival
+	UPROPERTY()
+	uint16 ItemId = InvalidItemId;
+
+	UPROPERTY(NotReplicated, BlueprintReadOnly, Category=Inventory)
+	FName ItemName;
+
+	UPROPERTY(BlueprintReadOnly, Category=Inventory)
+	int32 Quantity = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category=Inventory)
+	int32 Durability = 0;
+
+	// Fast arrays don't guarantee client side order, so each slot carries its index
+	UPROPERTY()
+	uint16 SlotIndex = 0;
+
+	bool IsEmpty() const { return Quantity <= 0; }
+
+	void PostReplicatedAdd(const struct FItemSlotArray& InArraySerializer);
+	void PostReplicatedChange(const struct FItemSlotArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FItemSlotArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FItemSlot> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<UItemContainerComponent> Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FItemSlot, FItemSlotArray>(Items, DeltaParms, *this);
+	}
+};
+
+template <>
+struct TStructOpsTypeTraits<FItemSlotArray> : public TStructOpsTypeTraitsBase2<FItemSlotArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/*
+ * Native replacement for BP_ItemsContainerComponent / BP_PlayerInventoryComponent. Slots are a
+ * flat array that replicates through a fast array, so a pickup only sends the slots it touched.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UItemContainerComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UItemContainerComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UFUNCTION(BlueprintPure, Category=Inventory)
+	int32 GetNumSlots() const { return Slots.Items.Num(); }
+
+	UFUNCTION(BlueprintPure, Category=Inventory)
+	FItemSlot GetSlot(int32 SlotIndex) const;
+
+	UFUNCTION(BlueprintPure, Category=Inventory)
+	EContainerType GetContainerType() const { return ContainerType; }
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Inventory)
+	void SetSlot(int32 SlotIndex, FName ItemName, int32 Quantity, int32 Durability = 0);
+
+	void SetSlotItem(int32 SlotIndex, FItemId ItemId, int32 Quantity, int32 Durability = 0);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Inventory)
+	void ClearSlot(int32 SlotIndex);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Inventory)
+	void SwapSlots(int32 FirstIndex, int32 SecondIndex);
+
+	/*
+	 * Applies all operations or none of them. Slots are only marked dirty once the whole list has
+	 * succeeded, so a transaction replicates as one update per container. Server only, callers
+	 * are responsible for checking the instigator may use the containers.
+	 */
+	static bool ApplyTransaction(TArrayView<const FInventoryOp> Operations);
+
+	// Whether this container accepts the item at all, armor slots only take armor
+	bool CanHoldItem(FItemId ItemId) const;
+
+	// How many more of the item fit, topping up stacks and filling empty slots
+	int32 GetRoomFor(FItemId ItemId) const;
+
+	// Server only, both return how much of Quantity could not be added or removed
+	int32 AddItem(FItemId ItemId, int32 Quantity);
+	int32 RemoveItem(FItemId ItemId, int32 Quantity);
+
+	// Fires once per changed slot, on the server when it changes and on clients when it replicates
+	UPROPERTY(BlueprintAssignable)
+	FOnSlotChanged OnSlotChanged;
+
+	// Called from FItemSlot on clients
+	void NotifySlotReplicated(FItemSlot& Slot);
+
+	int32 GetItemCount(FItemId ItemId) const { return ItemCounts.GetCount(ItemId); }
+
+	const FItemCountHistogram& GetItemCounts() const { return ItemCounts; }
+
+	UFUNCTION(BlueprintPure, Category=Inventory, meta=(DisplayName="Get Item Count"))
+	int32 K2_GetItemCount(FName ItemName) const;
+
+	// Fires for every change of a per item total, on server and clients
+	FOnItemCountChanged OnItemCountChanged;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	const FItemSlot* FindSlot(int32 SlotIndex) const;
+	FItemSlot* FindSlot(int32 SlotIndex);
+	void MarkSlotDirty(FItemSlot& Slot);
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Inventory)
+	EContainerType ContainerType = EContainerType::PlayerStorage;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Inventory, meta=(ClampMin=1, ClampMax=65535))
+	int32 NumSlots = 30;
+
+	UPROPERTY(Replicated)
+	FItemSlotArray Slots;
+
+	// Moves a slot's contribution to ItemCounts from what it last held to what it holds now
+	void UpdateItemCounts(const FItemSlot& Slot);
+
+	FItemCountHistogram ItemCounts;
+
+	// Contents each slot was last counted with, indexed by slot index
+	TArray<TPair<FItemId, int32>> CountedContents;
+};
@@ -0,0 +1,222 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlayerStatsComponent.h"
+#include "AfterTheEnd/Subsystems/ExperienceSubsystem.h"
+#include "AfterTheEnd/Subsystems/PlayerStatsSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "TimerManager.h"
+#include "Net/UnrealNetwork.h"
+
+void FPlayerStatItem::PostReplicatedAdd(const FPlayerStatArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->NotifyStatReplicated(*this);
+	}
+}
+
+void FPlayerStatItem::PostReplicatedChange(const FPlayerStatArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->NotifyStatReplicated(*this);
+	}
+}
+
+// Sets default values for this component's properties
+UPlayerStatsComponent::UPlayerStatsComponent()
+{
+	// Stats are simulated for all players at once by UPlayerStatsSubsystem
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetIsReplicatedByDefault(true);
+
+	Stats.Owner = this;
+}
+
+void UPlayerStatsComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UPlayerStatsComponent, Stats);
+	DOREPLIFETIME(UPlayerStatsComponent, Experience);
+	DOREPLIFETIME(UPlayerStatsComponent, Level);
+}
+
+// Called when the game starts
+void UPlayerStatsComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Stats.Owner = this;
+
+	if (!GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	// Server only, clients get the items as they replicate
+	if (Stats.Items.Num() != StatTypeCount)
+	{
+		Stats.Items.SetNum(StatTypeCount);
+		for (int32 Index = 0; Index < StatTypeCount; ++Index)
+		{
+			Stats.Items[Index].StatType = static_cast<EStatType>(Index);
+		}
+		Stats.MarkArrayDirty();
+	}
+
+	if (UPlayerStatsSubsystem* StatsSubsystem = GetWorld()->GetSubsystem<UPlayerStatsSubsystem>())
+	{
+		StatsHandle = StatsSubsystem->RegisterPlayer(this, MaxValues, DecayPerSecond);
+	}
+}
+
+void UPlayerStatsComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (StatsHandle != INDEX_NONE)
+	{
+		if (UPlayerStatsSubsystem* StatsSubsystem = GetWorld()->GetSubsystem<UPlayerStatsSubsystem>())
+		{
+			StatsSubsystem->UnregisterPlayer(StatsHandle);
+		}
+		StatsHandle = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+float UPlayerStatsComponent::GetStatValue(EStatType StatType) const
+{
+	if (StatsHandle != INDEX_NONE)
+	{
+		if (const UPlayerStatsSubsystem* StatsSubsystem = GetWorld()->GetSubsystem<UPlayerStatsSubsystem>())
+		{
+			return StatsSubsystem->GetValue(StatsHandle, StatType);
+		}
+	}
+	const FPlayerStatItem* Item = FindStat(StatType);
+	return Item ? Item->GetValue() : 0.f;
+}
+
+float UPlayerStatsComponent::GetStatMax(EStatType StatType) const
+{
+	const FPlayerStatItem* Item = FindStat(StatType);
+	return Item ? Item->MaxValue : 0.f;
+}
+
+const FPlayerStatItem* UPlayerStatsComponent::FindStat(EStatType StatType) const
+{
+	// Server side and in the common client case the array index is the stat type
+	const int32 Index = static_cast<int32>(StatType);
+	if (Stats.Items.IsValidIndex(Index) && Stats.Items[Index].StatType == StatType)
+	{
+		return &Stats.Items[Index];
+	}
+	return Stats.Items.FindByPredicate([StatType](const FPlayerStatItem& Item) { return Item.StatType == StatType; });
+}
+
+FPlayerStatItem* UPlayerStatsComponent::FindStat(EStatType StatType)
+{
+	return const_cast<FPlayerStatItem*>(static_cast<const UPlayerStatsComponent*>(this)->FindStat(StatType));
+}
+
+void UPlayerStatsComponent::ModifyStat(EStatType StatType, float Delta)
+{
+	if (StatsHandle == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (UPlayerStatsSubsystem* StatsSubsystem = GetWorld()->GetSubsystem<UPlayerStatsSubsystem>())
+	{
+		StatsSubsystem->ModifyValue(StatsHandle, StatType, Delta);
+	}
+}
+
+void UPlayerStatsComponent::SetStatMax(EStatType StatType, float NewMax)
+{
+	if (StatsHandle == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (UPlayerStatsSubsystem* StatsSubsystem = GetWorld()->GetSubsystem<UPlayerStatsSubsystem>())
+	{
+		StatsSubsystem->SetMaxValue(StatsHandle, StatType, NewMax);
+	}
+}
+
+void UPlayerStatsComponent::SetReplicatedStat(EStatType StatType, uint8 QuantizedValue, float MaxValue)
+{
+	FPlayerStatItem* Item = FindStat(StatType);
+	if (!Item)
+	{
+		return;
+	}
+
+	const uint16 QuantizedMax = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(MaxValue), 0, MAX_uint16));
+	if (Item->QuantizedValue == QuantizedValue && Item->MaxValue == QuantizedMax)
+	{
+		return;
+	}
+
+	Item->QuantizedValue = QuantizedValue;
+	Item->MaxValue = QuantizedMax;
+	Stats.MarkItemDirty(*Item);
+
+	OnStatChanged.Broadcast(StatType, GetStatValue(StatType));
+}
+
+void UPlayerStatsComponent::NotifyStatReplicated(const FPlayerStatItem& Item)
+{
+	OnStatChanged.Broadcast(Item.StatType, Item.GetValue());
+}
+
+void UPlayerStatsComponent::GrantExperience(int32 Amount)
+{
+	if (Amount <= 0 || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	if (PendingExperience == 0)
+	{
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UPlayerStatsComponent::FlushExperience);
+	}
+	PendingExperience += Amount;
+}
+
+void UPlayerStatsComponent::FlushExperience()
+{
+	const int32 Gained = PendingExperience;
+	PendingExperience = 0;
+	if (Gained <= 0)
+	{
+		return;
+	}
+
+	Experience += Gained;
+	OnExperienceChanged.Broadcast(Experience, Gained);
+
+	const UExperienceSubsystem* ExperienceSubsystem = UGameInstance::GetSubsystem<UExperienceSubsystem>(
+		GetWorld()->GetGameInstance());
+	const int32 NewLevel = ExperienceSubsystem ? ExperienceSubsystem->GetLevelForExperience(Experience) : Level;
+	if (NewLevel != Level)
+	{
+		const int32 OldLevel = Level;
+		Level = NewLevel;
+		OnLevelChanged.Broadcast(Level, OldLevel);
+	}
+}
+
+void UPlayerStatsComponent::OnRep_Experience(int32 OldExperience)
+{
+	OnExperienceChanged.Broadcast(Experience, Experience - OldExperience);
+}
+
+void UPlayerStatsComponent::OnRep_Level(int32 OldLevel)
+{
+	OnLevelChanged.Broadcast(Level, OldLevel);
+}
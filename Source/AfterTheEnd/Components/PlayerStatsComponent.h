@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "PlayerStatsComponent.generated.h"
+
+class UPlayerStatsComponent;
+
+// Mirrors E_StatType
+UENUM(BlueprintType)
+enum class EStatType : uint8
+{
+	Health,
+	Food,
+	Water,
+	Stamina,
+	MAX UMETA(Hidden)
+};
+
+constexpr int32 StatTypeCount = static_cast<int32>(EStatType::MAX);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnStatChanged, EStatType, StatType, float, NewValue);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnExperienceChanged, int32, Experience, int32, Gained);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnLevelChanged, int32, NewLevel, int32, OldLevel);
+
+/*
+ * One stat as seen by clients. The value travels as a byte of its maximum, the server keeps full
+ * precision in UPlayerStatsSubsystem.
+ */
+USTRUCT()
+struct FPlayerStatItem : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	EStatType StatType = EStatType::Health;
+
+	UPROPERTY()
+	uint8 QuantizedValue = 0;
+
+	UPROPERTY()
+	uint16 MaxValue = 0;
+
+	float GetValue() const { return QuantizedValue / 255.f * MaxValue; }
+
+	void PostReplicatedAdd(const struct FPlayerStatArray& InArraySerializer);
+	void PostReplicatedChange(const struct FPlayerStatArray& InArraySerializer);
+};
+
+USTRUCT()
+struct FPlayerStatArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<FPlayerStatItem> Items;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<UPlayerStatsComponent> Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FPlayerStatItem, FPlayerStatArray>(
+			Items, DeltaParms, *this);
+	}
+};
+
+template <>
+struct TStructOpsTypeTraits<FPlayerStatArray> : public TStructOpsTypeTraitsBase2<FPlayerStatArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/*
+ * Replaces the Blueprint S_PlayerStats handling. The server simulates the values in
+ * UPlayerStatsSubsystem, this component only holds the quantized copy that replicates.
+ */
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class AFTERTHEEND_API UPlayerStatsComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UPlayerStatsComponent();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UFUNCTION(BlueprintPure, Category=Stats)
+	float GetStatValue(EStatType StatType) const;
+
+	UFUNCTION(BlueprintPure, Category=Stats)
+	float GetStatMax(EStatType StatType) const;
+
+	// Server only, e.g. eating or taking damage
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Stats)
+	void ModifyStat(EStatType StatType, float Delta);
+
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Stats)
+	void SetStatMax(EStatType StatType, float NewMax);
+
+	UPROPERTY(BlueprintAssignable)
+	FOnStatChanged OnStatChanged;
+
+	// Grants are coalesced, the level is evaluated and notifications fire once per frame
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Experience)
+	void GrantExperience(int32 Amount);
+
+	UFUNCTION(BlueprintPure, Category=Experience)
+	int32 GetExperience() const { return Experience; }
+
+	UFUNCTION(BlueprintPure, Category=Experience)
+	int32 GetLevel() const { return Level; }
+
+	// Drives WBP_StatNotification, once per batch of grants rather than once per grant
+	UPROPERTY(BlueprintAssignable)
+	FOnExperienceChanged OnExperienceChanged;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnLevelChanged OnLevelChanged;
+
+	// Called by UPlayerStatsSubsystem when a stat's replicated byte changes
+	void SetReplicatedStat(EStatType StatType, uint8 QuantizedValue, float MaxValue);
+
+	// Called from FPlayerStatItem on clients
+	void NotifyStatReplicated(const FPlayerStatItem& Item);
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when the game ends or the owner is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Stats, meta=(ArraySizeEnum="EStatType"))
+	float MaxValues[StatTypeCount] = {100.f, 100.f, 100.f, 100.f};
+
+	// Units lost per second, negative values regenerate
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Stats, meta=(ArraySizeEnum="EStatType"))
+	float DecayPerSecond[StatTypeCount] = {0.f, 0.1f, 0.15f, -5.f};
+
+	UPROPERTY(Replicated)
+	FPlayerStatArray Stats;
+
+	UPROPERTY(ReplicatedUsing=OnRep_Experience)
+	int32 Experience = 0;
+
+	UPROPERTY(ReplicatedUsing=OnRep_Level)
+	int32 Level = 1;
+
+	// Experience granted this frame that hasn't been evaluated yet
+	int32 PendingExperience = 0;
+
+	void FlushExperience();
+
+	UFUNCTION()
+	void OnRep_Experience(int32 OldExperience);
+
+	UFUNCTION()
+	void OnRep_Level(int32 OldLevel);
+
+	// Clients may hold the items in any order
+	const FPlayerStatItem* FindStat(EStatType StatType) const;
+	FPlayerStatItem* FindStat(EStatType StatType);
+
+	// Slot in UPlayerStatsSubsystem's arrays, server only
+	int32 StatsHandle = INDEX_NONE;
+
+	friend class UPlayerStatsSubsystem;
+};
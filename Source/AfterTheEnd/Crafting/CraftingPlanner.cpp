@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CraftingPlanner.h"
+#include "AfterTheEnd/Components/ItemContainerComponent.h"
+#include "Algo/Reverse.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCraftingPlanner, Log, All);
+
+// Upper bound on a single max craftable answer, keeps the search and the demand sums bounded
+static constexpr int32 MaxCraftableCap = 1 << 20;
+
+// Saturation point for accumulated demand, far beyond any inventory and safe from overflow
+static constexpr int64 MaxDemand = int64(1) << 62;
+
+void FCraftingPlanner::Build(TConstArrayView<FRecipeDefinition> InRecipes, int32 NumItems)
+{
+	Recipes = InRecipes;
+
+	Producers.Init(INDEX_NONE, NumItems);
+	RecipeUsers.Reset();
+	RecipeUsers.SetNum(NumItems);
+	for (int32 RecipeId = 0; RecipeId < Recipes.Num(); ++RecipeId)
+	{
+		const FRecipeDefinition& Recipe = Recipes[RecipeId];
+		if (Producers[Recipe.OutputItemId] == INDEX_NONE)
+		{
+			Producers[Recipe.OutputItemId] = RecipeId;
+		}
+		for (const FRecipeIngredient& Ingredient : Recipe.Ingredients)
+		{
+			RecipeUsers[Ingredient.ItemId].AddUnique(RecipeId);
+		}
+	}
+
+	// Kahn's algorithm over ingredient -> output edges of the producing recipes
+	TArray<int32> PendingIngredients;
+	PendingIngredients.SetNumZeroed(NumItems);
+	for (int32 ItemId = 0; ItemId < NumItems; ++ItemId)
+	{
+		if (Producers[ItemId] != INDEX_NONE)
+		{
+			PendingIngredients[ItemId] = Recipes[Producers[ItemId]].Ingredients.Num();
+		}
+	}
+
+	TArray<FItemId> Ready;
+	for (int32 ItemId = 0; ItemId < NumItems; ++ItemId)
+	{
+		if (PendingIngredients[ItemId] == 0)
+		{
+			Ready.Add(static_cast<FItemId>(ItemId));
+		}
+	}
+
+	TopologicalRanks.Init(INDEX_NONE, NumItems);
+	int32 NextRank = 0;
+	while (!Ready.IsEmpty())
+	{
+		const FItemId ItemId = Ready.Pop(false);
+		TopologicalRanks[ItemId] = NextRank++;
+		for (const int32 RecipeId : RecipeUsers[ItemId])
+		{
+			const FItemId OutputId = Recipes[RecipeId].OutputItemId;
+			if (Producers[OutputId] != RecipeId)
+			{
+				continue;
+			}
+			// Once per ingredient entry, duplicates in a recipe count separately
+			for (const FRecipeIngredient& Ingredient : Recipes[RecipeId].Ingredients)
+			{
+				if (Ingredient.ItemId == ItemId && --PendingIngredients[OutputId] == 0)
+				{
+					Ready.Add(OutputId);
+				}
+			}
+		}
+	}
+
+	// Whatever is left sits on or behind a cycle, those items can only come from the inventory
+	int32 NumCyclic = 0;
+	for (int32 ItemId = 0; ItemId < NumItems; ++ItemId)
+	{
+		if (TopologicalRanks[ItemId] == INDEX_NONE)
+		{
+			Producers[ItemId] = INDEX_NONE;
+			TopologicalRanks[ItemId] = NextRank++;
+			++NumCyclic;
+		}
+	}
+	if (NumCyclic > 0)
+	{
+		UE_LOG(LogCraftingPlanner, Warning, TEXT("%d items are part of recipe cycles and won't be planned"), NumCyclic);
+	}
+
+	Closures.Reset();
+	Closures.SetNum(Recipes.Num());
+	ClosureBuilt.Init(false, Recipes.Num());
+	MaxCraftable.Init(0, Recipes.Num());
+	MaxCraftableValid.Init(false, Recipes.Num());
+	Demand.Init(0, NumItems);
+	Visited.Init(false, NumItems);
+}
+
+const TArray<FItemId>& FCraftingPlanner::GetClosure(int32 RecipeId)
+{
+	TArray<FItemId>& Closure = Closures[RecipeId];
+	if (ClosureBuilt[RecipeId])
+	{
+		return Closure;
+	}
+
+	for (const FRecipeIngredient& Ingredient : Recipes[RecipeId].Ingredients)
+	{
+		if (!Visited[Ingredient.ItemId])
+		{
+			Visited[Ingredient.ItemId] = true;
+			Closure.Add(Ingredient.ItemId);
+		}
+	}
+	for (int32 Index = 0; Index < Closure.Num(); ++Index)
+	{
+		const int32 Producer = Producers[Closure[Index]];
+		if (Producer == INDEX_NONE)
+		{
+			continue;
+		}
+		for (const FRecipeIngredient& Ingredient : Recipes[Producer].Ingredients)
+		{
+			if (!Visited[Ingredient.ItemId])
+			{
+				Visited[Ingredient.ItemId] = true;
+				Closure.Add(Ingredient.ItemId);
+			}
+		}
+	}
+
+	for (const FItemId ItemId : Closure)
+	{
+		Visited[ItemId] = false;
+	}
+
+	// Every consumer of an item comes before it, so its demand is complete when it's reached
+	Closure.Sort([this](FItemId A, FItemId B) { return TopologicalRanks[A] > TopologicalRanks[B]; });
+	Closure.Shrink();
+	ClosureBuilt[RecipeId] = true;
+	return Closure;
+}
+
+bool FCraftingPlanner::Expand(int32 RecipeId, int64 Count, const FItemCountHistogram& Counts, int32 Level,
+                              TArray<FCraftingStep>* OutSteps)
+{
+	const FRecipeDefinition& RootRecipe = Recipes[RecipeId];
+	if (RootRecipe.RequiredLevel > Level)
+	{
+		return false;
+	}
+
+	const TArray<FItemId>& Closure = GetClosure(RecipeId);
+	for (const FItemId ItemId : Closure)
+	{
+		Demand[ItemId] = 0;
+	}
+	for (const FRecipeIngredient& Ingredient : RootRecipe.Ingredients)
+	{
+		Demand[Ingredient.ItemId] = FMath::Min(Demand[Ingredient.ItemId] + Ingredient.Quantity * Count, MaxDemand);
+	}
+
+	for (const FItemId ItemId : Closure)
+	{
+		const int64 Shortfall = Demand[ItemId] - Counts.GetCount(ItemId);
+		if (Shortfall <= 0)
+		{
+			continue;
+		}
+
+		const int32 Producer = Producers[ItemId];
+		if (Producer == INDEX_NONE || Recipes[Producer].RequiredLevel > Level)
+		{
+			return false;
+		}
+
+		const FRecipeDefinition& Recipe = Recipes[Producer];
+		const int64 Crafts = (Shortfall + Recipe.OutputQuantity - 1) / Recipe.OutputQuantity;
+		if (Crafts > MAX_int32)
+		{
+			// Deep chains multiply up quickly, nobody holds enough to get there
+			return false;
+		}
+		for (const FRecipeIngredient& Ingredient : Recipe.Ingredients)
+		{
+			Demand[Ingredient.ItemId] = FMath::Min(Demand[Ingredient.ItemId] + Ingredient.Quantity * Crafts, MaxDemand);
+		}
+
+		if (OutSteps)
+		{
+			OutSteps->Add({Producer, static_cast<int32>(Crafts)});
+		}
+	}
+	return true;
+}
+
+int32 FCraftingPlanner::GetMaxCraftable(int32 RecipeId, const FItemCountHistogram& Counts, int32 Level)
+{
+	if (!Recipes.IsValidIndex(RecipeId))
+	{
+		return 0;
+	}
+	if (MaxCraftableValid[RecipeId])
+	{
+		return MaxCraftable[RecipeId];
+	}
+
+	// Feasibility is monotonic in the count, grow until it fails and then bisect
+	int32 Feasible = 0;
+	if (Expand(RecipeId, 1, Counts, Level, nullptr))
+	{
+		Feasible = 1;
+		int32 Infeasible = 2;
+		while (Infeasible <= MaxCraftableCap && Expand(RecipeId, Infeasible, Counts, Level, nullptr))
+		{
+			Feasible = Infeasible;
+			Infeasible *= 2;
+		}
+		Infeasible = FMath::Min(Infeasible, MaxCraftableCap + 1);
+
+		while (Infeasible - Feasible > 1)
+		{
+			const int32 Middle = Feasible + (Infeasible - Feasible) / 2;
+			if (Expand(RecipeId, Middle, Counts, Level, nullptr))
+			{
+				Feasible = Middle;
+			}
+			else
+			{
+				Infeasible = Middle;
+			}
+		}
+	}
+
+	MaxCraftable[RecipeId] = Feasible;
+	MaxCraftableValid[RecipeId] = true;
+	return Feasible;
+}
+
+bool FCraftingPlanner::BuildPlan(int32 RecipeId, int32 Count, const FItemCountHistogram& Counts, int32 Level,
+                                 TArray<FCraftingStep>& OutSteps)
+{
+	OutSteps.Reset();
+	if (!Recipes.IsValidIndex(RecipeId) || Count <= 0 || Count > MaxCraftableCap
+		|| !Expand(RecipeId, Count, Counts, Level, &OutSteps))
+	{
+		OutSteps.Reset();
+		return false;
+	}
+
+	// Expansion runs from the recipe towards raw items, crafting goes the other way
+	Algo::Reverse(OutSteps);
+	OutSteps.Add({RecipeId, Count});
+	return true;
+}
+
+void FCraftingPlanner::InvalidateItem(FItemId ItemId)
+{
+	if (!Visited.IsValidIndex(ItemId))
+	{
+		return;
+	}
+
+	// Walk from the item to everything that can be crafted from it
+	TArray<FItemId, TInlineAllocator<32>> Pending;
+	TArray<FItemId, TInlineAllocator<32>> Seen;
+	Pending.Add(ItemId);
+	Visited[ItemId] = true;
+	Seen.Add(ItemId);
+
+	while (!Pending.IsEmpty())
+	{
+		const FItemId Current = Pending.Pop(false);
+		for (const int32 RecipeId : RecipeUsers[Current])
+		{
+			MaxCraftableValid[RecipeId] = false;
+
+			const FItemId OutputId = Recipes[RecipeId].OutputItemId;
+			if (Producers[OutputId] == RecipeId && !Visited[OutputId])
+			{
+				Visited[OutputId] = true;
+				Seen.Add(OutputId);
+				Pending.Add(OutputId);
+			}
+		}
+	}
+
+	for (const FItemId SeenId : Seen)
+	{
+		Visited[SeenId] = false;
+	}
+}
+
+void FCraftingPlanner::InvalidateAll()
+{
+	MaxCraftableValid.SetRange(0, MaxCraftableValid.Num(), false);
+}
+
+static void RunCraftingPlannerBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumRecipes = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 5000;
+	const int32 NumRawItems = FMath::Max(NumRecipes / 10, 1);
+	const int32 NumItems = 1 + NumRawItems + NumRecipes;
+	const int32 NumTiers = 5;
+	const int32 TierSize = FMath::Max(FMath::DivideAndRoundUp(NumRecipes, NumTiers), 1);
+	const int32 NumChanges = 100;
+	if (NumItems > MAX_uint16)
+	{
+		UE_LOG(LogCraftingPlanner, Error, TEXT("Too many recipes for 16 bit item ids"));
+		return;
+	}
+
+	// Item 0 is invalid, then raw items, then one crafted item per recipe
+	FRandomStream Stream(1337);
+	TArray<FRecipeDefinition> Recipes;
+	Recipes.SetNum(NumRecipes);
+	for (int32 RecipeId = 0; RecipeId < NumRecipes; ++RecipeId)
+	{
+		FRecipeDefinition& Recipe = Recipes[RecipeId];
+		Recipe.OutputItemId = static_cast<FItemId>(1 + NumRawItems + RecipeId);
+		Recipe.OutputQuantity = Stream.RandRange(1, 2);
+
+		// Tiers of recipes, each one built from the tier below and raw items
+		const int32 Tier = RecipeId / TierSize;
+		const int32 NumIngredients = Stream.RandRange(2, 4);
+		for (int32 Index = 0; Index < NumIngredients; ++Index)
+		{
+			const int32 IngredientId = Tier == 0 || Stream.FRand() < 0.3f
+				                           ? Stream.RandRange(1, NumRawItems)
+				                           : 1 + NumRawItems + (Tier - 1) * TierSize + Stream.RandRange(0, TierSize - 1);
+			Recipe.Ingredients.Add({static_cast<FItemId>(IngredientId), Stream.RandRange(1, 3)});
+		}
+	}
+
+	FItemCountHistogram Counts;
+	for (int32 ItemId = 1; ItemId <= NumRawItems; ++ItemId)
+	{
+		Counts.AddCount(static_cast<FItemId>(ItemId), Stream.RandRange(0, 5000));
+	}
+
+	FCraftingPlanner Planner;
+	double StartTime = FPlatformTime::Seconds();
+	Planner.Build(Recipes, NumItems);
+	const double BuildTime = FPlatformTime::Seconds() - StartTime;
+
+	int64 TotalCraftable = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (int32 RecipeId = 0; RecipeId < NumRecipes; ++RecipeId)
+	{
+		TotalCraftable += Planner.GetMaxCraftable(RecipeId, Counts, MAX_int32);
+	}
+	const double ColdTime = FPlatformTime::Seconds() - StartTime;
+
+	StartTime = FPlatformTime::Seconds();
+	for (int32 RecipeId = 0; RecipeId < NumRecipes; ++RecipeId)
+	{
+		Planner.GetMaxCraftable(RecipeId, Counts, MAX_int32);
+	}
+	const double WarmTime = FPlatformTime::Seconds() - StartTime;
+
+	// A count change followed by the crafting window asking about every recipe again
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Change = 0; Change < NumChanges; ++Change)
+	{
+		const FItemId ItemId = static_cast<FItemId>(Stream.RandRange(1, NumRawItems));
+		Counts.AddCount(ItemId, Stream.RandRange(-10, 10));
+		Planner.InvalidateItem(ItemId);
+		for (int32 RecipeId = 0; RecipeId < NumRecipes; ++RecipeId)
+		{
+			Planner.GetMaxCraftable(RecipeId, Counts, MAX_int32);
+		}
+	}
+	const double IncrementalTime = FPlatformTime::Seconds() - StartTime;
+
+	TArray<FCraftingStep> Steps;
+	StartTime = FPlatformTime::Seconds();
+	Planner.BuildPlan(NumRecipes - 1, 1, Counts, MAX_int32, Steps);
+	const double PlanTime = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogCraftingPlanner, Display,
+	       TEXT("Crafting planner: %d recipes built in %.2f ms, max craftable for all %.2f ms cold / %.3f ms memoized, "
+		       "%.3f ms per count change with full requery, %d step plan in %.3f ms (total craftable %lld)"),
+	       NumRecipes, BuildTime * 1000.0, ColdTime * 1000.0, WarmTime * 1000.0, IncrementalTime * 1000.0 / NumChanges,
+	       Steps.Num(), PlanTime * 1000.0, TotalCraftable);
+}
+
+static FAutoConsoleCommand CraftingPlannerBenchmarkCommand(
+	TEXT("ate.Crafting.BenchmarkPlanner"),
+	TEXT("Builds a synthetic table of N recipes (default 5000) and times max craftable queries and invalidation"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunCraftingPlannerBenchmark));
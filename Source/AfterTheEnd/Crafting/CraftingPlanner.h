@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AfterTheEnd/Subsystems/RecipeRegistrySubsystem.h"
+
+struct FItemCountHistogram;
+
+struct FCraftingStep
+{
+	int32 RecipeId = INDEX_NONE;
+	int32 Count = 0;
+};
+
+/*
+ * Plans crafts whose ingredients may have to be crafted first. Recipes form a DAG over items, each
+ * craftable item uses the first recipe that produces it. A plan is found by walking a recipe's
+ * ingredient closure from outputs towards raw items, taking what's in the inventory and crafting
+ * the shortfall. The most craftable per recipe is memoized until a count it depends on changes.
+ */
+class AFTERTHEEND_API FCraftingPlanner
+{
+public:
+	// Recipes has to outlive the planner, item ids must be below NumItems
+	void Build(TConstArrayView<FRecipeDefinition> InRecipes, int32 NumItems);
+
+	// How many times the recipe can be crafted, crafting missing intermediates from Counts
+	int32 GetMaxCraftable(int32 RecipeId, const FItemCountHistogram& Counts, int32 Level);
+
+	// Steps to craft the recipe Count times, intermediates first and the recipe itself last
+	bool BuildPlan(int32 RecipeId, int32 Count, const FItemCountHistogram& Counts, int32 Level,
+	               TArray<FCraftingStep>& OutSteps);
+
+	// Forgets memoized results that depend on the item's count
+	void InvalidateItem(FItemId ItemId);
+	void InvalidateAll();
+
+	int32 GetNumRecipes() const { return Recipes.Num(); }
+
+private:
+	bool Expand(int32 RecipeId, int64 Count, const FItemCountHistogram& Counts, int32 Level,
+	            TArray<FCraftingStep>* OutSteps);
+
+	// Items the recipe may need, consumers before their ingredients
+	const TArray<FItemId>& GetClosure(int32 RecipeId);
+
+	TConstArrayView<FRecipeDefinition> Recipes;
+
+	// Recipe used to craft each item, INDEX_NONE for raw items and items on a cycle
+	TArray<int32> Producers;
+
+	// Position in a topological order of the producer graph, ingredients first
+	TArray<int32> TopologicalRanks;
+
+	// Recipes with the item as an ingredient
+	TArray<TArray<int32>> RecipeUsers;
+
+	TArray<TArray<FItemId>> Closures;
+	TBitArray<> ClosureBuilt;
+
+	TArray<int32> MaxCraftable;
+	TBitArray<> MaxCraftableValid;
+
+	// Scratch, indexed by item id
+	TArray<int64> Demand;
+	TBitArray<> Visited;
+};
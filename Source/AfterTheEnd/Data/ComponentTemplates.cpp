@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ComponentTemplates.h"
+#include "Engine/BlueprintGeneratedClass.h"
+#include "Engine/SCS_Node.h"
+#include "Engine/SimpleConstructionScript.h"
+#include "GameFramework/Actor.h"
+
+namespace ComponentTemplates
+{
+	void ForEach(UClass* Class,
+	             TFunctionRef<void(FName Name, const UActorComponent* Template, const FTransform& Transform)> Visitor)
+	{
+		const AActor* Defaults = Class->GetDefaultObject<AActor>();
+		const USceneComponent* NativeRoot = Defaults->GetRootComponent();
+		TMap<FName, FTransform> Transforms;
+
+		// Native components are default subobjects of the class defaults
+		TInlineComponentArray<UActorComponent*> NativeComponents(Defaults);
+		for (const UActorComponent* Component : NativeComponents)
+		{
+			FTransform Transform = FTransform::Identity;
+			for (const USceneComponent* Current = Cast<USceneComponent>(Component); Current && Current != NativeRoot;
+			     Current = Current->GetAttachParent())
+			{
+				Transform = Transform * Current->GetRelativeTransform();
+			}
+			Transforms.Add(Component->GetFName(), Transform);
+			Visitor(Component->GetFName(), Component, Transform);
+		}
+
+		// Blueprint components, parent classes first so inherited attach parents are known. Templates
+		// come from the actual class, which may override inherited ones.
+		UBlueprintGeneratedClass* ActualClass = Cast<UBlueprintGeneratedClass>(Class);
+		TArray<const UBlueprintGeneratedClass*, TInlineAllocator<4>> BlueprintClasses;
+		for (const UClass* Current = Class; Current; Current = Current->GetSuperClass())
+		{
+			if (const UBlueprintGeneratedClass* BlueprintClass = Cast<UBlueprintGeneratedClass>(Current))
+			{
+				BlueprintClasses.Insert(BlueprintClass, 0);
+			}
+		}
+
+		bool bHasRoot = NativeRoot != nullptr;
+		TFunction<void(const USCS_Node*, const FTransform&)> VisitNode;
+		VisitNode = [&](const USCS_Node* Node, const FTransform& ParentTransform)
+		{
+			const UActorComponent* Template = Node->GetActualComponentTemplate(ActualClass);
+			const USceneComponent* SceneTemplate = Cast<USceneComponent>(Template);
+			const FTransform Transform = SceneTemplate
+				                             ? SceneTemplate->GetRelativeTransform() * ParentTransform
+				                             : ParentTransform;
+			Transforms.Add(Node->GetVariableName(), Transform);
+			if (Template)
+			{
+				Visitor(Node->GetVariableName(), Template, Transform);
+			}
+			for (const USCS_Node* Child : Node->GetChildNodes())
+			{
+				VisitNode(Child, Transform);
+			}
+		};
+
+		for (const UBlueprintGeneratedClass* BlueprintClass : BlueprintClasses)
+		{
+			const USimpleConstructionScript* ConstructionScript = BlueprintClass->SimpleConstructionScript;
+			if (!ConstructionScript)
+			{
+				continue;
+			}
+
+			for (const USCS_Node* RootNode : ConstructionScript->GetRootNodes())
+			{
+				if (RootNode->ParentComponentOrVariableName != NAME_None)
+				{
+					VisitNode(RootNode, Transforms.FindRef(RootNode->ParentComponentOrVariableName));
+				}
+				else if (!bHasRoot)
+				{
+					// Becomes the root component, which sits at the actor transform
+					bHasRoot = true;
+					const UActorComponent* Template = RootNode->GetActualComponentTemplate(ActualClass);
+					const USceneComponent* SceneTemplate = Cast<USceneComponent>(Template);
+					const FTransform Inverse = SceneTemplate ? SceneTemplate->GetRelativeTransform().Inverse()
+						                           : FTransform::Identity;
+					VisitNode(RootNode, Inverse);
+				}
+				else
+				{
+					VisitNode(RootNode, FTransform::Identity);
+				}
+			}
+		}
+	}
+}
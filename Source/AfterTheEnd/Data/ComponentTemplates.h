@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * What an actor class spawns with, read without spawning it: the native default subobjects of its
+ * class defaults and the construction script nodes of it and its Blueprint parents.
+ */
+namespace ComponentTemplates
+{
+	// Calls Visitor with every component the class spawns with and its transform relative to the actor
+	AFTERTHEEND_API void ForEach(UClass* Class,
+	                             TFunctionRef<void(FName Name, const UActorComponent* Template,
+	                                               const FTransform& Transform)> Visitor);
+}
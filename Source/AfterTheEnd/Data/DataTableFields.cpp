@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DataTableFields.h"
+#include "UObject/UnrealType.h"
+
+namespace DataTableFields
+{
+	const FProperty* FindField(const UStruct* Struct, const TCHAR* AuthoredName)
+	{
+		if (!Struct)
+		{
+			return nullptr;
+		}
+
+		for (TFieldIterator<FProperty> It(Struct); It; ++It)
+		{
+			if (It->GetAuthoredName() == AuthoredName)
+			{
+				return *It;
+			}
+		}
+		return nullptr;
+	}
+
+	int64 GetInt(const FProperty* Property, const void* Container, int64 Default)
+	{
+		if (!Property)
+		{
+			return Default;
+		}
+
+		const void* Value = Property->ContainerPtrToValuePtr<void>(Container);
+		if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+		{
+			return NumericProperty->IsInteger()
+				       ? NumericProperty->GetSignedIntPropertyValue(Value)
+				       : static_cast<int64>(NumericProperty->GetFloatingPointPropertyValue(Value));
+		}
+		if (const FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+		{
+			return EnumProperty->GetUnderlyingProperty()->GetSignedIntPropertyValue(Value);
+		}
+		if (const FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+		{
+			return BoolProperty->GetPropertyValue(Value) ? 1 : 0;
+		}
+		return Default;
+	}
+
+	double GetFloat(const FProperty* Property, const void* Container, double Default)
+	{
+		if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+		{
+			const void* Value = Property->ContainerPtrToValuePtr<void>(Container);
+			return NumericProperty->IsFloatingPoint()
+				       ? NumericProperty->GetFloatingPointPropertyValue(Value)
+				       : static_cast<double>(NumericProperty->GetSignedIntPropertyValue(Value));
+		}
+		return Default;
+	}
+
+	void SetFloat(const FProperty* Property, void* Container, double Value)
+	{
+		if (const FNumericProperty* NumericProperty = CastField<FNumericProperty>(Property))
+		{
+			void* ValuePtr = Property->ContainerPtrToValuePtr<void>(Container);
+			if (NumericProperty->IsFloatingPoint())
+			{
+				NumericProperty->SetFloatingPointPropertyValue(ValuePtr, Value);
+			}
+			else
+			{
+				NumericProperty->SetIntPropertyValue(ValuePtr, static_cast<int64>(FMath::RoundToDouble(Value)));
+			}
+		}
+	}
+
+	FName GetName(const FProperty* Property, const void* Container)
+	{
+		if (!Property)
+		{
+			return NAME_None;
+		}
+
+		if (const FNameProperty* NameProperty = CastField<FNameProperty>(Property))
+		{
+			return NameProperty->GetPropertyValue_InContainer(Container);
+		}
+		if (const FStrProperty* StrProperty = CastField<FStrProperty>(Property))
+		{
+			return FName(*StrProperty->GetPropertyValue_InContainer(Container));
+		}
+		if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+		{
+			return FName(*TextProperty->GetPropertyValue_InContainer(Container).BuildSourceString());
+		}
+		return NAME_None;
+	}
+
+	FText GetText(const FProperty* Property, const void* Container)
+	{
+		if (const FTextProperty* TextProperty = CastField<FTextProperty>(Property))
+		{
+			return TextProperty->GetPropertyValue_InContainer(Container);
+		}
+
+		const FName Name = GetName(Property, Container);
+		return Name.IsNone() ? FText::GetEmpty() : FText::FromName(Name);
+	}
+
+	UObject* GetObject(const FProperty* Property, const void* Container)
+	{
+		if (const FObjectPropertyBase* ObjectProperty = CastField<FObjectPropertyBase>(Property))
+		{
+			return ObjectProperty->GetObjectPropertyValue_InContainer(Container);
+		}
+		return nullptr;
+	}
+
+	void ForEachInt(const FProperty* Property, const void* Container, TFunctionRef<void(int64 Value)> Visitor)
+	{
+		const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property);
+		if (!ArrayProperty)
+		{
+			return;
+		}
+
+		// Array elements are their inner property's container at offset 0
+		FScriptArrayHelper ArrayHelper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Container));
+		for (int32 Index = 0; Index < ArrayHelper.Num(); ++Index)
+		{
+			Visitor(GetInt(ArrayProperty->Inner, ArrayHelper.GetRawPtr(Index)));
+		}
+	}
+
+	void ForEachStruct(const FProperty* Property, const void* Container,
+	                   TFunctionRef<void(const UStruct* ElementStruct, const void* Element)> Visitor)
+	{
+		const FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property);
+		const FStructProperty* InnerProperty = ArrayProperty ? CastField<FStructProperty>(ArrayProperty->Inner) : nullptr;
+		if (!InnerProperty)
+		{
+			return;
+		}
+
+		FScriptArrayHelper ArrayHelper(ArrayProperty, ArrayProperty->ContainerPtrToValuePtr<void>(Container));
+		for (int32 Index = 0; Index < ArrayHelper.Num(); ++Index)
+		{
+			Visitor(InnerProperty->Struct, ArrayHelper.GetRawPtr(Index));
+		}
+	}
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Read access to DataTable rows by field name. The tables are authored against Blueprint
+ * structs (S_ItemInfo, S_ItemRecipe, ...) whose property names carry generated suffixes, so
+ * fields are matched by their authored name. Meant for compiling tables at load time, and for
+ * the odd Blueprint variable native code has to carry over, like a structure's health.
+ */
+namespace DataTableFields
+{
+	AFTERTHEEND_API const FProperty* FindField(const UStruct* Struct, const TCHAR* AuthoredName);
+
+	// Integers, bytes, enums and bools
+	AFTERTHEEND_API int64 GetInt(const FProperty* Property, const void* Container, int64 Default = 0);
+	AFTERTHEEND_API double GetFloat(const FProperty* Property, const void* Container, double Default = 0.0);
+	AFTERTHEEND_API void SetFloat(const FProperty* Property, void* Container, double Value);
+
+	// Names, strings and texts, texts by their source string
+	AFTERTHEEND_API FName GetName(const FProperty* Property, const void* Container);
+
+	// Texts, names and strings as display text
+	AFTERTHEEND_API FText GetText(const FProperty* Property, const void* Container);
+
+	// Object and class references
+	AFTERTHEEND_API UObject* GetObject(const FProperty* Property, const void* Container);
+
+	// Calls Visitor for every element of an array of integers, bytes or enums
+	AFTERTHEEND_API void ForEachInt(const FProperty* Property, const void* Container,
+	                                TFunctionRef<void(int64 Value)> Visitor);
+
+	// Calls Visitor for every element of an array of structs
+	AFTERTHEEND_API void ForEachStruct(const FProperty* Property, const void* Container,
+	                                   TFunctionRef<void(const UStruct* ElementStruct, const void* Element)> Visitor);
+}
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DestructionDebris.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Field/FieldSystemComponent.h"
+#include "Field/FieldSystemObjects.h"
+#include "GeometryCollection/GeometryCollectionComponent.h"
+#include "GeometryCollection/GeometryCollectionObject.h"
+
+// How far canned trees tip over, in degrees
+static constexpr float CannedFallAngle = 85.f;
+
+// Share of their size canned rocks lose while crumbling
+static constexpr float CannedShrink = 0.4f;
+
+ADestructionDebris::ADestructionDebris()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = false;
+	SetCanBeDamaged(false);
+}
+
+void ADestructionDebris::InitMesh(UObject* Mesh)
+{
+	if (UGeometryCollection* Collection = Cast<UGeometryCollection>(Mesh))
+	{
+		UGeometryCollectionComponent* CollectionComponent = NewObject<UGeometryCollectionComponent>(this, TEXT("Mesh"));
+		CollectionComponent->SetRestCollection(Collection);
+		MeshComponent = CollectionComponent;
+		bGeometryCollection = true;
+	}
+	else
+	{
+		UStaticMeshComponent* StaticMeshComponent = NewObject<UStaticMeshComponent>(this, TEXT("Mesh"));
+		StaticMeshComponent->SetStaticMesh(Cast<UStaticMesh>(Mesh));
+		MeshComponent = StaticMeshComponent;
+	}
+
+	// Only exists on this machine, so it mustn't get in the way of anything the server moves
+	MeshComponent->SetMobility(EComponentMobility::Movable);
+	MeshComponent->SetCollisionObjectType(ECC_PhysicsBody);
+	MeshComponent->SetCollisionResponseToAllChannels(ECR_Ignore);
+	MeshComponent->SetCollisionResponseToChannel(ECC_WorldStatic, ECR_Block);
+	MeshComponent->SetSimulatePhysics(false);
+	SetRootComponent(MeshComponent);
+	MeshComponent->RegisterComponent();
+
+	if (bGeometryCollection)
+	{
+		FieldSystem = NewObject<UFieldSystemComponent>(this, TEXT("FieldSystem"));
+		FieldSystem->SetupAttachment(MeshComponent);
+		FieldSystem->RegisterComponent();
+		StrainFalloff = NewObject<URadialFalloff>(this, TEXT("StrainFalloff"));
+	}
+
+	Deactivate();
+}
+
+void ADestructionDebris::Activate(const FTransform& MeshTransform, TConstArrayView<UMaterialInterface*> Materials)
+{
+	StartTransform = MeshTransform;
+	SetActorTransform(MeshTransform, false, nullptr, ETeleportType::ResetPhysics);
+	for (int32 Index = 0; Index < Materials.Num(); ++Index)
+	{
+		MeshComponent->SetMaterial(Index, Materials[Index]);
+	}
+
+	// A collection broken the last time comes back whole with its physics state
+	if (bGeometryCollection)
+	{
+		MeshComponent->RecreatePhysicsState();
+	}
+
+	Height = MeshComponent->Bounds.BoxExtent.Z * 2.f;
+	MeshComponent->SetCollisionEnabled(ECollisionEnabled::PhysicsOnly);
+	SetActorHiddenInGame(false);
+}
+
+void ADestructionDebris::StartSimulation(const FVector& Direction, float Impulse, float Strain, float StrainRadius)
+{
+	bSimulating = true;
+	MeshComponent->SetSimulatePhysics(true);
+
+	if (bGeometryCollection)
+	{
+		StrainFalloff->SetRadialFalloff(Strain, 0.f, 1.f, 0.f, StrainRadius, MeshComponent->Bounds.Origin,
+		                                EFieldFalloffType::Field_FallOff_None);
+		FieldSystem->ApplyPhysicsField(true, EFieldPhysicsType::Field_ExternalClusterStrain, nullptr, StrainFalloff);
+		return;
+	}
+
+	// Pushed at the top so it tips over rather than sliding away
+	MeshComponent->AddImpulseAtLocation(Direction * Impulse * MeshComponent->GetMass(),
+	                                    GetActorLocation() + GetActorUpVector() * Height);
+}
+
+void ADestructionDebris::SetCannedPose(const FVector& Direction, float Alpha)
+{
+	if (bGeometryCollection)
+	{
+		FTransform Pose = StartTransform;
+		Pose.AddToTranslation(FVector(0.f, 0.f, -0.5f * Height * Alpha));
+		Pose.SetScale3D(StartTransform.GetScale3D() * (1.f - CannedShrink * Alpha));
+		SetActorTransform(Pose);
+		return;
+	}
+
+	// Around its base, speeding up like it falls
+	const FVector Axis = FVector::CrossProduct(FVector::UpVector, Direction).GetSafeNormal();
+	const FQuat Tilt(Axis, FMath::DegreesToRadians(CannedFallAngle) * Alpha * Alpha);
+	SetActorTransform(FTransform(Tilt * StartTransform.GetRotation(), StartTransform.GetLocation(),
+	                             StartTransform.GetScale3D()));
+}
+
+void ADestructionDebris::StartFade()
+{
+	if (bSimulating)
+	{
+		bSimulating = false;
+		MeshComponent->SetSimulatePhysics(false);
+	}
+	MeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	FadeStartTransform = GetActorTransform();
+}
+
+void ADestructionDebris::SetFadePose(float Alpha)
+{
+	FTransform Pose = FadeStartTransform;
+	Pose.AddToTranslation(FVector(0.f, 0.f, -Height * Alpha));
+	SetActorTransform(Pose);
+}
+
+void ADestructionDebris::Deactivate()
+{
+	bSimulating = false;
+	MeshComponent->SetSimulatePhysics(false);
+	MeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetActorHiddenInGame(true);
+}
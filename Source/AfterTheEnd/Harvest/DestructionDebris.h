@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "DestructionDebris.generated.h"
+
+class UFieldSystemComponent;
+class UMaterialInterface;
+class URadialFalloff;
+
+/*
+ * Local stand-in for a destruct class, BP_DestructableTree or BP_DestructableRock, pooled by
+ * UDestructionSubsystem. Its mesh is its root: a static mesh felled by an impulse at its top, or a
+ * geometry collection broken by an external strain field the way FS_DestructionForce breaks the
+ * Blueprint rocks. Reused by moving it and resetting its physics instead of spawning another.
+ */
+UCLASS(NotBlueprintable)
+class AFTERTHEEND_API ADestructionDebris : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ADestructionDebris();
+
+	// Once after spawning, a UStaticMesh or a UGeometryCollection
+	void InitMesh(UObject* Mesh);
+
+	// Shown unbroken with its mesh at MeshTransform, not simulating yet
+	void Activate(const FTransform& MeshTransform, TConstArrayView<UMaterialInterface*> Materials);
+
+	void StartSimulation(const FVector& Direction, float Impulse, float Strain, float StrainRadius);
+
+	// Canned stand-in for the simulation, Alpha from 0 to 1: trees tip over towards Direction,
+	// anything else crumbles into the ground
+	void SetCannedPose(const FVector& Direction, float Alpha);
+
+	// Stops simulating where it came to rest, then sinks into the ground by SetFadePose
+	void StartFade();
+	void SetFadePose(float Alpha);
+
+	// Hidden and still until activated again
+	void Deactivate();
+
+	bool IsSimulating() const { return bSimulating; }
+
+protected:
+	UPROPERTY()
+	TObjectPtr<UPrimitiveComponent> MeshComponent;
+
+	// Geometry collections only
+	UPROPERTY()
+	TObjectPtr<UFieldSystemComponent> FieldSystem;
+
+	UPROPERTY()
+	TObjectPtr<URadialFalloff> StrainFalloff;
+
+	bool bGeometryCollection = false;
+	bool bSimulating = false;
+
+	FTransform StartTransform;
+	FTransform FadeStartTransform;
+	float Height = 0.f;
+};
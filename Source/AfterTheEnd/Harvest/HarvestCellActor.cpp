@@ -0,0 +1,366 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HarvestCellActor.h"
+#include "AfterTheEnd/Subsystems/HarvestSubsystem.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+
+// Instances are numbered with 16 bits
+static constexpr uint32 MaxDepletedWords = 65536 / 32;
+
+namespace
+{
+	// What a connection was last sent, the base the next update is written against
+	class FHarvestCellBaseState : public INetDeltaBaseState
+	{
+	public:
+		virtual bool IsStateEqual(INetDeltaBaseState* OtherState) override
+		{
+			const FHarvestCellBaseState* Other = static_cast<FHarvestCellBaseState*>(OtherState);
+			return Revision == Other->Revision && DepletedWords == Other->DepletedWords
+				&& PartialHealth == Other->PartialHealth;
+		}
+
+		TArray<uint32> DepletedWords;
+		TArray<FPartialHarvest> PartialHealth;
+		uint32 Revision = 0;
+	};
+
+	// Alternating lengths of clear and set runs, starting with clear
+	void WriteRuns(FArchive& Ar, const TArray<uint32>& Words)
+	{
+		bool bSet = false;
+		uint32 Run = 0;
+		for (const uint32 Word : Words)
+		{
+			if (Word == (bSet ? ~0u : 0u))
+			{
+				Run += 32;
+				continue;
+			}
+
+			for (int32 Bit = 0; Bit < 32; ++Bit)
+			{
+				if (((Word >> Bit) & 1) != static_cast<uint32>(bSet))
+				{
+					Ar.SerializeIntPacked(Run);
+					Run = 0;
+					bSet = !bSet;
+				}
+				++Run;
+			}
+		}
+
+		if (Words.Num() > 0)
+		{
+			Ar.SerializeIntPacked(Run);
+		}
+	}
+
+	bool ReadRuns(FArchive& Ar, TArray<uint32>& Words)
+	{
+		const uint32 NumBits = Words.Num() * 32;
+		bool bSet = false;
+		for (uint32 Bit = 0; Bit < NumBits; bSet = !bSet)
+		{
+			uint32 Run;
+			Ar.SerializeIntPacked(Run);
+			if (Ar.IsError() || Run > NumBits - Bit)
+			{
+				return false;
+			}
+
+			if (!bSet)
+			{
+				Bit += Run;
+				continue;
+			}
+
+			for (const uint32 End = Bit + Run; Bit < End; ++Bit)
+			{
+				Words[Bit / 32] |= 1u << (Bit % 32);
+			}
+		}
+		return true;
+	}
+
+	uint32 CountChangedWords(const TArray<uint32>& Old, const TArray<uint32>& New)
+	{
+		uint32 NumChanged = 0;
+		for (int32 Word = 0; Word < New.Num(); ++Word)
+		{
+			NumChanged += Old[Word] != New[Word];
+		}
+		return NumChanged;
+	}
+
+	// The changed words with their new value, each index as the distance from the one before. Values
+	// rather than flips, so replaying an update resent after a drop over a newer state is harmless.
+	void WriteChangedWords(FArchive& Ar, const TArray<uint32>& Old, const TArray<uint32>& New, uint32 NumChanged)
+	{
+		Ar.SerializeIntPacked(NumChanged);
+		uint32 Previous = 0;
+		for (int32 Word = 0; Word < New.Num(); ++Word)
+		{
+			if (Old[Word] != New[Word])
+			{
+				uint32 Skip = Word - Previous;
+				uint32 Value = New[Word];
+				Ar.SerializeIntPacked(Skip);
+				Ar << Value;
+				Previous = Word;
+			}
+		}
+	}
+
+	bool ReadChangedWords(FArchive& Ar, TArray<uint32>& Words)
+	{
+		uint32 NumChanged;
+		Ar.SerializeIntPacked(NumChanged);
+		uint32 Word = 0;
+		for (uint32 Index = 0; Index < NumChanged; ++Index)
+		{
+			uint32 Skip;
+			uint32 Value;
+			Ar.SerializeIntPacked(Skip);
+			Ar << Value;
+			Word += Skip;
+			if (Ar.IsError() || Word >= static_cast<uint32>(Words.Num()))
+			{
+				return false;
+			}
+			Words[Word] = Value;
+		}
+		return true;
+	}
+}
+
+bool FHarvestCellState::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	// Nothing in the state references objects
+	if (DeltaParms.bUpdateUnmappedObjects || DeltaParms.GatherGuidReferences || DeltaParms.MoveGuidToUnmapped)
+	{
+		return false;
+	}
+
+	if (DeltaParms.Writer)
+	{
+		const FHarvestCellBaseState* OldState = static_cast<const FHarvestCellBaseState*>(DeltaParms.OldState);
+		if (OldState && OldState->Revision == Revision)
+		{
+			return false;
+		}
+
+		FBitWriter& Writer = *DeltaParms.Writer;
+		uint32 NumWords = DepletedWords.Num();
+		Writer.SerializeIntPacked(NumWords);
+
+		// Runs when the connection has nothing to go from, or when so much changed at once that
+		// listing the changed words would likely be longer
+		const bool bSameSize = OldState && OldState->DepletedWords.Num() == DepletedWords.Num();
+		const uint32 NumChanged = bSameSize ? CountChangedWords(OldState->DepletedWords, DepletedWords) : 0;
+		uint8 bSnapshot = !bSameSize || NumChanged > NumWords / 4;
+		Writer.SerializeBits(&bSnapshot, 1);
+		if (bSnapshot)
+		{
+			WriteRuns(Writer, DepletedWords);
+		}
+		else
+		{
+			WriteChangedWords(Writer, OldState->DepletedWords, DepletedWords, NumChanged);
+		}
+
+		uint8 bPartialChanged = !OldState || OldState->PartialHealth != PartialHealth;
+		Writer.SerializeBits(&bPartialChanged, 1);
+		if (bPartialChanged)
+		{
+			uint32 NumPartial = PartialHealth.Num();
+			Writer.SerializeIntPacked(NumPartial);
+			for (FPartialHarvest Partial : PartialHealth)
+			{
+				Writer << Partial.Instance << Partial.Health;
+			}
+		}
+
+		TSharedPtr<FHarvestCellBaseState> NewState = MakeShared<FHarvestCellBaseState>();
+		NewState->DepletedWords = DepletedWords;
+		NewState->PartialHealth = PartialHealth;
+		NewState->Revision = Revision;
+		*DeltaParms.NewState = NewState;
+		return true;
+	}
+
+	if (DeltaParms.Reader)
+	{
+		FBitReader& Reader = *DeltaParms.Reader;
+		uint32 NumWords;
+		Reader.SerializeIntPacked(NumWords);
+		uint8 bSnapshot = 0;
+		Reader.SerializeBits(&bSnapshot, 1);
+		if (NumWords > MaxDepletedWords)
+		{
+			Reader.SetError();
+			return false;
+		}
+
+		bReceivedSnapshot = bSnapshot != 0;
+		if (bSnapshot)
+		{
+			DepletedWords.Reset();
+		}
+		DepletedWords.SetNumZeroed(NumWords);
+		if (!(bSnapshot ? ReadRuns(Reader, DepletedWords) : ReadChangedWords(Reader, DepletedWords)))
+		{
+			Reader.SetError();
+			return false;
+		}
+
+		uint8 bPartialChanged = 0;
+		Reader.SerializeBits(&bPartialChanged, 1);
+		if (bPartialChanged)
+		{
+			uint32 NumPartial;
+			Reader.SerializeIntPacked(NumPartial);
+			if (NumPartial > NumWords * 32)
+			{
+				Reader.SetError();
+				return false;
+			}
+
+			PartialHealth.SetNum(NumPartial);
+			for (FPartialHarvest& Partial : PartialHealth)
+			{
+				Reader << Partial.Instance << Partial.Health;
+			}
+		}
+
+		if (Owner && !Reader.IsError())
+		{
+			Owner->HandleStateReceived();
+		}
+		return !Reader.IsError();
+	}
+
+	return false;
+}
+
+AHarvestCellActor::AHarvestCellActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+
+	// Harvested resources only have to look right around the player
+	NetCullDistanceSquared = FMath::Square(15000.f);
+
+	// Flushed by every change, a cell nobody harvests in is only sent when it becomes relevant
+	NetDormancy = DORM_DormantAll;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent->SetMobility(EComponentMobility::Static);
+
+	State.Owner = this;
+}
+
+void AHarvestCellActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME_CONDITION(AHarvestCellActor, Cell, COND_InitialOnly);
+	DOREPLIFETIME(AHarvestCellActor, State);
+}
+
+void AHarvestCellActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	State.Owner = this;
+}
+
+void AHarvestCellActor::PostNetReceive()
+{
+	Super::PostNetReceive();
+
+	// After the whole bunch, the state may have been read before Cell. Only changes are something
+	// harvested just now, a snapshot is what the cell looked like when it became relevant.
+	if (bStateReceived)
+	{
+		bStateReceived = false;
+		if (UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>())
+		{
+			Harvest->ApplyCellState(*this, !State.bReceivedSnapshot);
+		}
+	}
+}
+
+void AHarvestCellActor::InitCell(const FIntPoint& InCell, int32 NumInstances)
+{
+	Cell = InCell;
+	State.DepletedWords.SetNumZeroed(FMath::DivideAndRoundUp(FMath::Min(NumInstances, 65536), 32));
+}
+
+void AHarvestCellActor::SetDepleted(int32 Instance, bool bDepleted)
+{
+	if (!State.DepletedWords.IsValidIndex(Instance / 32) || State.IsDepleted(Instance) == bDepleted)
+	{
+		return;
+	}
+
+	State.DepletedWords[Instance / 32] ^= 1u << (Instance % 32);
+	State.PartialHealth.RemoveAllSwap([Instance](const FPartialHarvest& Partial)
+	{
+		return Partial.Instance == Instance;
+	});
+	MarkStateDirty();
+}
+
+void AHarvestCellActor::SetPartialHealth(int32 Instance, float HealthFraction)
+{
+	const uint8 Health = static_cast<uint8>(FMath::Clamp(FMath::RoundToInt(HealthFraction * 255.f), 0, 255));
+	const int32 Index = State.PartialHealth.IndexOfByPredicate([Instance](const FPartialHarvest& Partial)
+	{
+		return Partial.Instance == Instance;
+	});
+
+	if (Health == 255)
+	{
+		if (Index == INDEX_NONE)
+		{
+			return;
+		}
+		State.PartialHealth.RemoveAtSwap(Index);
+	}
+	else if (Index == INDEX_NONE)
+	{
+		State.PartialHealth.Add({static_cast<uint16>(Instance), Health});
+	}
+	else if (State.PartialHealth[Index].Health != Health)
+	{
+		State.PartialHealth[Index].Health = Health;
+	}
+	else
+	{
+		return;
+	}
+	MarkStateDirty();
+}
+
+float AHarvestCellActor::GetHealthFraction(int32 Instance) const
+{
+	if (State.IsDepleted(Instance))
+	{
+		return 0.f;
+	}
+
+	const FPartialHarvest* Partial = State.PartialHealth.FindByPredicate([Instance](const FPartialHarvest& Entry)
+	{
+		return Entry.Instance == Instance;
+	});
+	return Partial ? Partial->Health / 255.f : 1.f;
+}
+
+void AHarvestCellActor::MarkStateDirty()
+{
+	++State.Revision;
+	FlushNetDormancy();
+}
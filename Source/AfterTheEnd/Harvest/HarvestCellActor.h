@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "HarvestCellActor.generated.h"
+
+// A partially harvested instance of a cell
+struct FPartialHarvest
+{
+	uint16 Instance;
+
+	// Share of its full health left, 255 being full
+	uint8 Health;
+
+	bool operator==(const FPartialHarvest& Other) const
+	{
+		return Instance == Other.Instance && Health == Other.Health;
+	}
+};
+
+/*
+ * What has been harvested in one cell: a bit per instance, set while it is depleted, and the health
+ * of the few instances that are partly harvested. Instances are numbered in the order
+ * UHarvestSubsystem sorts the cell's instances, which is the same on server and clients.
+ *
+ * Replicates against the state last sent to each connection. A connection without one, a late
+ * joiner or a client the cell just became relevant to, gets the bits run length encoded. After that
+ * only the changed words go out with their new value, or the runs again when those would be longer,
+ * and the partial health list whenever it changed.
+ */
+USTRUCT()
+struct FHarvestCellState
+{
+	GENERATED_BODY()
+
+	TArray<uint32> DepletedWords;
+	TArray<FPartialHarvest> PartialHealth;
+
+	// Bumped by the server on every change, a state with the same revision as the last one sent
+	// isn't sent again
+	uint32 Revision = 0;
+
+	// Client, whether the last update was the whole state rather than what changed since the one before
+	bool bReceivedSnapshot = false;
+
+	UPROPERTY(NotReplicated)
+	TObjectPtr<class AHarvestCellActor> Owner = nullptr;
+
+	bool IsDepleted(int32 Instance) const
+	{
+		return DepletedWords.IsValidIndex(Instance / 32)
+			&& (DepletedWords[Instance / 32] & (1u << (Instance % 32))) != 0;
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+};
+
+template <>
+struct TStructOpsTypeTraits<FHarvestCellState> : public TStructOpsTypeTraitsBase2<FHarvestCellState>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true
+	};
+};
+
+/*
+ * Carries one cell's FHarvestCellState to the clients it is relevant to. Spawned by the server for
+ * cells with anything harvested and dormant between changes, so idle cells cost nothing.
+ */
+UCLASS(NotBlueprintable)
+class AFTERTHEEND_API AHarvestCellActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AHarvestCellActor();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostNetReceive() override;
+
+	void InitCell(const FIntPoint& InCell, int32 NumInstances);
+
+	const FIntPoint& GetCell() const { return Cell; }
+
+	const FHarvestCellState& GetState() const { return State; }
+
+	// Server side changes, replicated with the next flush
+	void SetDepleted(int32 Instance, bool bDepleted);
+	void SetPartialHealth(int32 Instance, float HealthFraction);
+
+	// Full health when not partly harvested
+	float GetHealthFraction(int32 Instance) const;
+
+	void HandleStateReceived() { bStateReceived = true; }
+
+protected:
+	virtual void BeginPlay() override;
+
+	void MarkStateDirty();
+
+	UPROPERTY(Replicated)
+	FIntPoint Cell;
+
+	UPROPERTY(Replicated)
+	FHarvestCellState State;
+
+	bool bStateReceived = false;
+};
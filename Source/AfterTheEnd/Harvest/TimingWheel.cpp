@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TimingWheel.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTimingWheel, Log, All);
+
+FTimingWheel::FTimingWheel(uint64 StartTick)
+{
+	Reset(StartTick);
+}
+
+void FTimingWheel::Reset(uint64 StartTick)
+{
+	Entries.Reset();
+	FreeEntries = INDEX_NONE;
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+		{
+			Slots[Level][Slot] = INDEX_NONE;
+		}
+	}
+	CurrentTick = StartTick;
+	NumScheduled = 0;
+}
+
+void FTimingWheel::Schedule(uint64 Payload, uint64 DueTick)
+{
+	int32 Entry = FreeEntries;
+	if (Entry != INDEX_NONE)
+	{
+		FreeEntries = Entries[Entry].Next;
+	}
+	else
+	{
+		Entry = Entries.AddUninitialized();
+	}
+
+	Entries[Entry].Payload = Payload;
+	Entries[Entry].DueTick = FMath::Max(DueTick, CurrentTick + 1);
+	Link(Entry);
+	++NumScheduled;
+}
+
+void FTimingWheel::Link(int32 Entry)
+{
+	// The lowest level whose turn the due tick falls in. Entries moving down while advancing may be
+	// due at the current tick, which is the level 0 slot about to be expired.
+	const uint64 DueTick = FMath::Max(Entries[Entry].DueTick, CurrentTick);
+	int32 Level = 0;
+	while (Level < NumLevels - 1 && DueTick >> (SlotBits * (Level + 1)) != CurrentTick >> (SlotBits * (Level + 1)))
+	{
+		++Level;
+	}
+
+	const int32 Slot = static_cast<int32>(DueTick >> (SlotBits * Level)) & (NumSlots - 1);
+	Entries[Entry].Next = Slots[Level][Slot];
+	Slots[Level][Slot] = Entry;
+}
+
+int32 FTimingWheel::TakeSlot(int32 Level, int32 Slot)
+{
+	const int32 First = Slots[Level][Slot];
+	Slots[Level][Slot] = INDEX_NONE;
+	return First;
+}
+
+void FTimingWheel::Advance(uint64 Tick, TFunctionRef<void(uint64 Payload)> Expire)
+{
+	while (CurrentTick < Tick)
+	{
+		if (NumScheduled == 0)
+		{
+			CurrentTick = Tick;
+			return;
+		}
+
+		++CurrentTick;
+
+		// Higher levels first, what they move down may move down again
+		for (int32 Level = NumLevels - 1; Level > 0; --Level)
+		{
+			if ((CurrentTick & ((uint64(1) << (SlotBits * Level)) - 1)) != 0)
+			{
+				continue;
+			}
+
+			const int32 Slot = static_cast<int32>(CurrentTick >> (SlotBits * Level)) & (NumSlots - 1);
+			for (int32 Entry = TakeSlot(Level, Slot); Entry != INDEX_NONE;)
+			{
+				const int32 Next = Entries[Entry].Next;
+				Link(Entry);
+				Entry = Next;
+			}
+		}
+
+		// Freed before expiring, Expire may schedule into the same entries
+		for (int32 Entry = TakeSlot(0, static_cast<int32>(CurrentTick) & (NumSlots - 1)); Entry != INDEX_NONE;)
+		{
+			const int32 Next = Entries[Entry].Next;
+			const uint64 Payload = Entries[Entry].Payload;
+			Entries[Entry].Next = FreeEntries;
+			FreeEntries = Entry;
+			--NumScheduled;
+
+			Expire(Payload);
+			Entry = Next;
+		}
+	}
+}
+
+void FTimingWheel::ForEach(TFunctionRef<void(uint64 Payload, uint64 DueTick)> Function) const
+{
+	for (int32 Level = 0; Level < NumLevels; ++Level)
+	{
+		for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+		{
+			for (int32 Entry = Slots[Level][Slot]; Entry != INDEX_NONE; Entry = Entries[Entry].Next)
+			{
+				Function(Entries[Entry].Payload, Entries[Entry].DueTick);
+			}
+		}
+	}
+}
+
+void FTimingWheel::Serialize(FArchive& Ar)
+{
+	int32 NumEntries = NumScheduled;
+	Ar << NumEntries;
+
+	if (Ar.IsLoading())
+	{
+		Reset(CurrentTick);
+		for (int32 Index = 0; Index < NumEntries && !Ar.IsError(); ++Index)
+		{
+			uint64 Payload, Delay;
+			Ar << Payload << Delay;
+			Schedule(Payload, CurrentTick + Delay);
+		}
+		return;
+	}
+
+	ForEach([this, &Ar](uint64 Payload, uint64 DueTick)
+	{
+		uint64 Delay = DueTick - CurrentTick;
+		Ar << Payload << Delay;
+	});
+}
+
+static void RunTimingWheelBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumPayloads = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000000;
+	const uint64 MaxDelay = 86400;
+
+	// Respawns spread over a day of one second ticks
+	FRandomStream Stream(1337);
+	TArray<uint64> DueTicks;
+	DueTicks.Reserve(NumPayloads);
+	for (int32 Index = 0; Index < NumPayloads; ++Index)
+	{
+		DueTicks.Add(1 + Stream.RandHelper(MaxDelay));
+	}
+
+	FTimingWheel Wheel;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumPayloads; ++Index)
+	{
+		Wheel.Schedule(Index, DueTicks[Index]);
+	}
+	const double ScheduleTime = FPlatformTime::Seconds() - StartTime;
+
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	Wheel.Serialize(Writer);
+	FTimingWheel Loaded;
+	FMemoryReader Reader(Data);
+	Loaded.Serialize(Reader);
+
+	// Every payload has to expire exactly at its due tick, loaded or not
+	int32 NumExpired = 0, NumWrong = 0;
+	StartTime = FPlatformTime::Seconds();
+	for (uint64 Tick = 1; Tick <= MaxDelay; ++Tick)
+	{
+		Wheel.Advance(Tick, [&Wheel, &DueTicks, &NumExpired, &NumWrong](uint64 Payload)
+		{
+			++NumExpired;
+			NumWrong += DueTicks[Payload] != Wheel.GetCurrentTick() ? 1 : 0;
+		});
+	}
+	const double ExpireTime = FPlatformTime::Seconds() - StartTime;
+
+	Loaded.Advance(MaxDelay, [&Loaded, &DueTicks, &NumExpired, &NumWrong](uint64 Payload)
+	{
+		++NumExpired;
+		NumWrong += DueTicks[Payload] != Loaded.GetCurrentTick() ? 1 : 0;
+	});
+
+	UE_LOG(LogTimingWheel, Display,
+	       TEXT("Timing wheel: %d payloads, schedule %.1f ns, expire %.1f ns, serialized to %d bytes, "
+		       "%d of %d expired at the wrong tick"),
+	       NumPayloads, ScheduleTime * 1e9 / NumPayloads, ExpireTime * 1e9 / NumPayloads, Data.Num(), NumWrong,
+	       NumExpired);
+}
+
+static FAutoConsoleCommand TimingWheelBenchmarkCommand(
+	TEXT("ate.Harvest.BenchmarkRespawnWheel"),
+	TEXT("Schedules N respawns (default 1000000) over a day of ticks, times scheduling and expiring them"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunTimingWheelBenchmark));
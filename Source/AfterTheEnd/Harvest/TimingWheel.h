@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ * Hierarchical timing wheel of 64 bit payloads due at whole ticks. Four levels of 256 slots, each
+ * slot of a level spanning a full turn of the level below, cover 2^32 ticks ahead. Scheduling
+ * links into one slot and advancing a tick visits one slot, moving the slot of a higher level down
+ * when a lower level completes a turn, so both are O(1) however many payloads are pending.
+ *
+ * Serializes pending payloads as delays from the current tick, loading schedules them from the
+ * current tick of the loading wheel.
+ */
+class AFTERTHEEND_API FTimingWheel
+{
+public:
+	explicit FTimingWheel(uint64 StartTick = 0);
+
+	// Due ticks already passed are due at the next tick
+	void Schedule(uint64 Payload, uint64 DueTick);
+
+	// Expires everything due up to and including Tick, which may schedule more
+	void Advance(uint64 Tick, TFunctionRef<void(uint64 Payload)> Expire);
+
+	void ForEach(TFunctionRef<void(uint64 Payload, uint64 DueTick)> Function) const;
+
+	void Reset(uint64 StartTick);
+	void Serialize(FArchive& Ar);
+
+	uint64 GetCurrentTick() const { return CurrentTick; }
+	int32 Num() const { return NumScheduled; }
+
+private:
+	static constexpr int32 SlotBits = 8;
+	static constexpr int32 NumSlots = 1 << SlotBits;
+	static constexpr int32 NumLevels = 4;
+
+	struct FEntry
+	{
+		uint64 Payload;
+		uint64 DueTick;
+		int32 Next;
+	};
+
+	void Link(int32 Entry);
+
+	// Unlinks the slot and returns its first entry
+	int32 TakeSlot(int32 Level, int32 Slot);
+
+	// Slots are singly linked lists through Entries, freed entries a list of their own
+	TArray<FEntry> Entries;
+	int32 FreeEntries = INDEX_NONE;
+	int32 Slots[NumLevels][NumSlots];
+
+	uint64 CurrentTick;
+	int32 NumScheduled = 0;
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingAggregationSubsystem.h"
+#include "BuildingSnapSubsystem.h"
+#include "StructureRegistrySubsystem.h"
+#include "AfterTheEnd/Building/BuildingBaseAggregator.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarBaseRadius(
+	TEXT("ate.Building.BaseRadius"),
+	5000.f,
+	TEXT("Distance from a base's first piece within which new pieces join that base"));
+
+static const FName DestroyStructureName(TEXT("DestroyStructure"));
+
+bool UBuildingAggregationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UBuildingAggregationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	BuildingSnap = Collection.InitializeDependency<UBuildingSnapSubsystem>();
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.AddUObject(this, &UBuildingAggregationSubsystem::HandlePieceRegistered);
+		BuildingSnap->OnPieceUnregistered.AddUObject(this, &UBuildingAggregationSubsystem::HandlePieceUnregistered);
+	}
+}
+
+void UBuildingAggregationSubsystem::Deinitialize()
+{
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.RemoveAll(this);
+		BuildingSnap->OnPieceUnregistered.RemoveAll(this);
+	}
+
+	Super::Deinitialize();
+}
+
+void UBuildingAggregationSubsystem::HandlePieceRegistered(int32 PieceHandle)
+{
+	// Clients only mirror what the server aggregated
+	AActor* Piece = BuildingSnap->GetPieceActor(PieceHandle);
+	if (!Piece || !Piece->HasAuthority() || !StructureRegistry)
+	{
+		return;
+	}
+
+	const FStructureType& Type = StructureRegistry->GetStructureType(BuildingSnap->GetPieceType(PieceHandle));
+	if (Type.bInteractive || Type.Template.Meshes.IsEmpty())
+	{
+		return;
+	}
+
+	ABuildingBaseAggregator* Base = FindOrSpawnBase(Piece->GetActorLocation());
+	if (!Base)
+	{
+		return;
+	}
+
+	Base->AdoptPiece(PieceHandle, Piece);
+	if (PieceBases.Num() <= PieceHandle)
+	{
+		PieceBases.SetNum(PieceHandle + 1);
+	}
+	PieceBases[PieceHandle] = Base;
+}
+
+void UBuildingAggregationSubsystem::HandlePieceUnregistered(int32 PieceHandle)
+{
+	if (PieceBases.IsValidIndex(PieceHandle))
+	{
+		if (ABuildingBaseAggregator* Base = PieceBases[PieceHandle].Get())
+		{
+			Base->ForgetPiece(PieceHandle);
+		}
+		PieceBases[PieceHandle].Reset();
+	}
+}
+
+ABuildingBaseAggregator* UBuildingAggregationSubsystem::FindOrSpawnBase(const FVector& Location)
+{
+	Bases.RemoveAll([](const ABuildingBaseAggregator* Base) { return !IsValid(Base); });
+
+	const float RadiusSquared = FMath::Square(CVarBaseRadius.GetValueOnGameThread());
+	ABuildingBaseAggregator* BestBase = nullptr;
+	float BestDistanceSquared = RadiusSquared;
+	for (ABuildingBaseAggregator* Base : Bases)
+	{
+		const float DistanceSquared = FVector::DistSquared(Base->GetActorLocation(), Location);
+		if (DistanceSquared <= BestDistanceSquared)
+		{
+			BestDistanceSquared = DistanceSquared;
+			BestBase = Base;
+		}
+	}
+
+	if (!BestBase)
+	{
+		BestBase = GetWorld()->SpawnActor<ABuildingBaseAggregator>(Location, FRotator::ZeroRotator);
+		if (BestBase)
+		{
+			Bases.Add(BestBase);
+		}
+	}
+	return BestBase;
+}
+
+AActor* UBuildingAggregationSubsystem::PromotePiece(int32 PieceHandle)
+{
+	if (!BuildingSnap->IsValidPiece(PieceHandle))
+	{
+		return nullptr;
+	}
+
+	ABuildingBaseAggregator* Base = GetPieceBase(PieceHandle);
+	if (AActor* Piece = BuildingSnap->GetPieceActor(PieceHandle))
+	{
+		if (Base)
+		{
+			Base->NotifyPieceActive(Piece);
+		}
+		return Piece;
+	}
+	return Base ? Base->PromotePiece(PieceHandle) : nullptr;
+}
+
+void UBuildingAggregationSubsystem::DestroyPiece(int32 PieceHandle)
+{
+	AActor* Piece = PromotePiece(PieceHandle);
+	if (!Piece)
+	{
+		// Nothing left to play the destruction on
+		if (BuildingSnap->IsValidPiece(PieceHandle))
+		{
+			BuildingSnap->RemovePiece(PieceHandle);
+		}
+		return;
+	}
+	if (Piece->IsActorBeingDestroyed())
+	{
+		return;
+	}
+
+	// BP_BuildableMaster's DestroyStructure plays the destruction, anything else is just removed
+	UFunction* DestroyStructure = Piece->FindFunction(DestroyStructureName);
+	if (DestroyStructure && DestroyStructure->ParmsSize == 0)
+	{
+		Piece->ProcessEvent(DestroyStructure, nullptr);
+	}
+	else
+	{
+		Piece->Destroy();
+	}
+}
+
+AActor* UBuildingAggregationSubsystem::PromoteHitPiece(const FHitResult& Hit)
+{
+	AActor* HitActor = Hit.GetActor();
+	if (ABuildingBaseAggregator* Base = Cast<ABuildingBaseAggregator>(HitActor))
+	{
+		return Base->PromoteInstance(Hit.GetComponent(), Hit.Item);
+	}
+
+	if (HitActor && BuildingSnap->IsPiece(HitActor))
+	{
+		PromotePiece(BuildingSnap->FindPiece(HitActor));
+	}
+	return HitActor;
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingAggregationSubsystem.generated.h"
+
+class ABuildingBaseAggregator;
+class UBuildingSnapSubsystem;
+class UStructureRegistrySubsystem;
+
+/*
+ * Hands placed pieces to the ABuildingBaseAggregator of their base on the server, spawning one
+ * for pieces further than ate.Building.BaseRadius from every other base. Interactive structures
+ * always stay actors.
+ *
+ * Anything that traces against buildings and needs the real piece, tool hits going through
+ * BPI_StructureDamage or demolish, should pass its hit through PromoteHitPiece first.
+ */
+UCLASS()
+class AFTERTHEEND_API UBuildingAggregationSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Actor of the hit building piece, promoted if the hit landed on an instance
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	AActor* PromoteHitPiece(const FHitResult& Hit);
+
+	// Actor of a snap piece, promoted if the piece is aggregated
+	AActor* PromotePiece(int32 PieceHandle);
+
+	// Promotes the piece and plays BP_BuildableMaster's DestroyStructure on it
+	void DestroyPiece(int32 PieceHandle);
+
+	ABuildingBaseAggregator* GetPieceBase(int32 PieceHandle) const
+	{
+		return PieceBases.IsValidIndex(PieceHandle) ? PieceBases[PieceHandle].Get() : nullptr;
+	}
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetNumBases() const { return Bases.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void HandlePieceRegistered(int32 PieceHandle);
+	void HandlePieceUnregistered(int32 PieceHandle);
+
+	ABuildingBaseAggregator* FindOrSpawnBase(const FVector& Location);
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<ABuildingBaseAggregator>> Bases;
+
+	// Indexed by snap piece handle
+	TArray<TWeakObjectPtr<ABuildingBaseAggregator>> PieceBases;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingSnapSubsystem> BuildingSnap;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStructureRegistrySubsystem> StructureRegistry;
+};
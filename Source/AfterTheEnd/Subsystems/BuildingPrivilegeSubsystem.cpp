@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingPrivilegeSubsystem.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/PlayerState.h"
+
+bool UBuildingPrivilegeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+int32 UBuildingPrivilegeSubsystem::GetPlayerKey(const APlayerState* Player)
+{
+	if (!Player || !Player->GetUniqueId().IsValid())
+	{
+		return INDEX_NONE;
+	}
+
+	if (const int32* PlayerKey = PlayerKeys.Find(Player->GetUniqueId()))
+	{
+		return *PlayerKey;
+	}
+	return PlayerKeys.Add(Player->GetUniqueId(), PlayerKeys.Num());
+}
+
+void UBuildingPrivilegeSubsystem::SetAuthorized(int32 Claim, TConstArrayView<FUniqueNetIdRepl> Players)
+{
+	TArray<int32, TInlineAllocator<8>> Keys;
+	for (const FUniqueNetIdRepl& Player : Players)
+	{
+		if (Player.IsValid())
+		{
+			const int32* PlayerKey = PlayerKeys.Find(Player);
+			Keys.Add(PlayerKey ? *PlayerKey : PlayerKeys.Add(Player, PlayerKeys.Num()));
+		}
+	}
+	Grid.SetAuthorized(Claim, Keys);
+}
+
+const APlayerState* UBuildingPrivilegeSubsystem::GetPlayerState(const AController* Player)
+{
+	return Player ? Player->PlayerState.Get() : nullptr;
+}
+
+EBuildPrivilege UBuildingPrivilegeSubsystem::GetPrivilegeAt(const AController* Player, FVector Location)
+{
+	bool bAuthorized;
+	if (!Grid.IsClaimed(FVector2D(Location), GetPlayerKey(GetPlayerState(Player)), bAuthorized))
+	{
+		return EBuildPrivilege::Unclaimed;
+	}
+	return bAuthorized ? EBuildPrivilege::Authorized : EBuildPrivilege::Denied;
+}
+
+EBuildPrivilege UBuildingPrivilegeSubsystem::GetPrivilegeInBox(const AController* Player, FBox Box)
+{
+	return GetPrivilegeInArea(GetPlayerState(Player), FBox2D(FVector2D(Box.Min), FVector2D(Box.Max)));
+}
+
+EBuildPrivilege UBuildingPrivilegeSubsystem::GetPrivilegeInArea(const APlayerState* Player, const FBox2D& Area)
+{
+	bool bAuthorized;
+	if (!Grid.IsClaimed(Area, GetPlayerKey(Player), bAuthorized))
+	{
+		return EBuildPrivilege::Unclaimed;
+	}
+	return bAuthorized ? EBuildPrivilege::Authorized : EBuildPrivilege::Denied;
+}
+
+bool UBuildingPrivilegeSubsystem::CanOpen(const AController* Player, const AActor* Door)
+{
+	return Door && CanBuildAt(Player, Door->GetActorLocation());
+}
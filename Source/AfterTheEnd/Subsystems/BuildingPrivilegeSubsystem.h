@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameFramework/OnlineReplStructs.h"
+#include "AfterTheEnd/Building/PrivilegeGrid.h"
+#include "BuildingPrivilegeSubsystem.generated.h"
+
+class AController;
+class APlayerState;
+
+UENUM(BlueprintType)
+enum class EBuildPrivilege : uint8
+{
+	// Nobody claims the place
+	Unclaimed,
+	// Claimed, and every claim there authorizes the player
+	Authorized,
+	// Claimed by someone who hasn't authorized the player
+	Denied
+};
+
+/*
+ * Who may build or open doors where. Claims come from UBuildingPrivilegeComponent, which keeps
+ * them in sync on server and clients, and are kept in an FPrivilegeGrid so the placement preview
+ * and door interactions can ask every frame. Players are interned to small keys by unique net id,
+ * authorization survives reconnecting.
+ */
+UCLASS()
+class AFTERTHEEND_API UBuildingPrivilegeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	int32 AddClaim(const FBox2D& Bounds) { return Grid.AddClaim(Bounds); }
+	void RemoveClaim(int32 Claim) { Grid.RemoveClaim(Claim); }
+	void SetAuthorized(int32 Claim, TConstArrayView<FUniqueNetIdRepl> Players);
+
+	// INDEX_NONE for players without a unique net id, who are authorized nowhere
+	int32 GetPlayerKey(const APlayerState* Player);
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	EBuildPrivilege GetPrivilegeAt(const AController* Player, FVector Location);
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	EBuildPrivilege GetPrivilegeInBox(const AController* Player, FBox Box);
+
+	// For BP_BuildingComponent's placement, false only where someone else has a claim
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool CanBuildAt(const AController* Player, FVector Location)
+	{
+		return GetPrivilegeAt(Player, Location) != EBuildPrivilege::Denied;
+	}
+
+	// For doors, same rule as building at the door's location
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool CanOpen(const AController* Player, const AActor* Door);
+
+	// Footprint on the ground plane
+	EBuildPrivilege GetPrivilegeInArea(const APlayerState* Player, const FBox2D& Area);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	static const APlayerState* GetPlayerState(const AController* Player);
+
+	FPrivilegeGrid Grid;
+
+	TMap<FUniqueNetIdRepl, int32> PlayerKeys;
+};
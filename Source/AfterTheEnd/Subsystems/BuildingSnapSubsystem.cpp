@@ -0,0 +1,397 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingSnapSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "TimerManager.h"
+
+const FName UBuildingSnapSubsystem::PreviewTag(TEXT("BuildPreview"));
+
+bool UBuildingSnapSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UBuildingSnapSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(
+		FOnActorSpawned::FDelegate::CreateUObject(this, &UBuildingSnapSubsystem::HandleActorSpawned));
+}
+
+void UBuildingSnapSubsystem::Deinitialize()
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	GetWorld()->GetTimerManager().ClearAllTimersForObject(this);
+
+	Super::Deinitialize();
+}
+
+void UBuildingSnapSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Pieces saved into the level never go through the spawn handler
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		RegisterPiece(*It);
+	}
+}
+
+void UBuildingSnapSubsystem::HandleActorSpawned(AActor* Actor)
+{
+	if (!StructureRegistry || Actor->ActorHasTag(PreviewTag))
+	{
+		return;
+	}
+
+	const FStructureTypeId TypeId = StructureRegistry->FindStructureType(Actor->GetClass());
+	if (TypeId == InvalidStructureType)
+	{
+		return;
+	}
+
+	// An actor spawned for a piece that is already here, a promoted one
+	if (Pieces.IsValidIndex(PendingActorPiece) && Pieces[PendingActorPiece].TypeId == TypeId)
+	{
+		SetPieceActor(PendingActorPiece, Actor);
+		PendingActorPiece = INDEX_NONE;
+		return;
+	}
+
+	// This runs inside deferred spawns, which Blueprint Spawn Actor is, before the actor has a root
+	// component and so a transform. Registered once spawning has finished.
+	if (SpawnedActors.IsEmpty())
+	{
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UBuildingSnapSubsystem::RegisterSpawnedActors);
+	}
+	SpawnedActors.Add(Actor);
+}
+
+void UBuildingSnapSubsystem::RegisterSpawnedActors()
+{
+	TArray<TWeakObjectPtr<AActor>> Spawned = MoveTemp(SpawnedActors);
+	SpawnedActors.Reset();
+
+	for (const TWeakObjectPtr<AActor>& WeakActor : Spawned)
+	{
+		AActor* Actor = WeakActor.Get();
+		if (!Actor)
+		{
+			continue;
+		}
+
+		// Deferred spawns finished later than the frame they started in
+		if (!Actor->IsActorInitialized())
+		{
+			SpawnedActors.Add(Actor);
+			continue;
+		}
+
+		RegisterPiece(Actor);
+	}
+
+	if (!SpawnedActors.IsEmpty())
+	{
+		GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UBuildingSnapSubsystem::RegisterSpawnedActors);
+	}
+}
+
+void UBuildingSnapSubsystem::HandlePieceEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterPiece(Actor);
+}
+
+FIntVector UBuildingSnapSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize),
+	                  FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UBuildingSnapSubsystem::AddToCell(TMap<FIntVector, TArray<int32>>& Cells, const FIntVector& Cell, int32 Handle)
+{
+	Cells.FindOrAdd(Cell).Add(Handle);
+}
+
+void UBuildingSnapSubsystem::RemoveFromCell(TMap<FIntVector, TArray<int32>>& Cells, const FIntVector& Cell,
+                                            int32 Handle)
+{
+	if (TArray<int32>* CellHandles = Cells.Find(Cell))
+	{
+		CellHandles->RemoveSingleSwap(Handle, false);
+		if (CellHandles->IsEmpty())
+		{
+			Cells.Remove(Cell);
+		}
+	}
+}
+
+void UBuildingSnapSubsystem::ForEachInRadius(const TMap<FIntVector, TArray<int32>>& Cells, const FVector& Location,
+                                             float Radius, TFunctionRef<void(int32 Handle)> Visitor) const
+{
+	const FIntVector MinCell = GetCell(Location - FVector(Radius));
+	const FIntVector MaxCell = GetCell(Location + FVector(Radius));
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				if (const TArray<int32>* CellHandles = Cells.Find(FIntVector(X, Y, Z)))
+				{
+					for (const int32 Handle : *CellHandles)
+					{
+						Visitor(Handle);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UBuildingSnapSubsystem::RegisterPiece(AActor* Actor)
+{
+	if (!StructureRegistry || !Actor || Actor->ActorHasTag(PreviewTag) || PieceHandles.Contains(Actor))
+	{
+		return;
+	}
+
+	const FStructureTypeId TypeId = StructureRegistry->FindStructureType(Actor->GetClass());
+	if (TypeId == InvalidStructureType)
+	{
+		return;
+	}
+
+	// From the build template rather than the snap boxes, which Blueprint pieces add in their
+	// construction script
+	const FTransform Transform = Actor->GetActorTransform();
+	TArray<FBuildableTemplate::FSocket, TInlineAllocator<8>> WorldSockets;
+	GetTemplateSockets(TypeId, Transform, WorldSockets);
+	AddPiece(Actor, TypeId, Transform, WorldSockets);
+}
+
+void UBuildingSnapSubsystem::GetTemplateSockets(FStructureTypeId TypeId, const FTransform& Transform,
+                                                TArray<FBuildableTemplate::FSocket, TInlineAllocator<8>>&
+                                                OutSockets) const
+{
+	for (const FBuildableTemplate::FSocket& Socket : StructureRegistry->GetStructureType(TypeId).Template.Sockets)
+	{
+		OutSockets.Add({Socket.Accepts, Socket.Transform * Transform});
+	}
+}
+
+int32 UBuildingSnapSubsystem::AddTemplatePiece(FStructureTypeId TypeId, const FTransform& Transform)
+{
+	if (!StructureRegistry || TypeId == InvalidStructureType)
+	{
+		return INDEX_NONE;
+	}
+
+	TArray<FBuildableTemplate::FSocket, TInlineAllocator<8>> WorldSockets;
+	GetTemplateSockets(TypeId, Transform, WorldSockets);
+	return AddPiece(nullptr, TypeId, Transform, WorldSockets);
+}
+
+int32 UBuildingSnapSubsystem::AddPiece(AActor* Actor, FStructureTypeId TypeId, const FTransform& Transform,
+                                       TConstArrayView<FBuildableTemplate::FSocket> WorldSockets)
+{
+	const FVector Location = Transform.GetLocation();
+	const FStructureTypeMask TypeBit = UStructureRegistrySubsystem::GetTypeBit(TypeId);
+	const float ToleranceSquared = FMath::Square(OccupancyTolerance);
+
+	FPlacedPiece NewPiece;
+	NewPiece.Actor = Actor;
+	NewPiece.Location = Location;
+	NewPiece.Rotation = Transform.GetRotation();
+	NewPiece.Cell = GetCell(Location);
+	NewPiece.TypeId = TypeId;
+	const int32 PieceHandle = Pieces.Add(MoveTemp(NewPiece));
+	AddToCell(PieceCells, Pieces[PieceHandle].Cell, PieceHandle);
+
+	// Sockets of existing pieces this one sits on
+	ForEachInRadius(SocketCells, Location, OccupancyTolerance, [&](int32 SocketHandle)
+	{
+		FSnapSocket& Socket = Sockets[SocketHandle];
+		if (Socket.OccupiedBy == INDEX_NONE && (Socket.Accepts & TypeBit) != 0
+			&& FVector::DistSquared(Socket.Location, Location) <= ToleranceSquared)
+		{
+			Socket.OccupiedBy = PieceHandle;
+			Pieces[PieceHandle].OccupiedSockets.Add(SocketHandle);
+		}
+	});
+
+	// This piece's own sockets, some may already have something sitting on them
+	for (const FBuildableTemplate::FSocket& WorldSocket : WorldSockets)
+	{
+		FSnapSocket NewSocket;
+		NewSocket.Location = WorldSocket.Transform.GetLocation();
+		NewSocket.Rotation = WorldSocket.Transform.GetRotation();
+		NewSocket.Cell = GetCell(NewSocket.Location);
+		NewSocket.Accepts = WorldSocket.Accepts;
+		NewSocket.OwnerPiece = PieceHandle;
+		const int32 SocketHandle = Sockets.Add(NewSocket);
+		AddToCell(SocketCells, NewSocket.Cell, SocketHandle);
+		Pieces[PieceHandle].OwnSockets.Add(SocketHandle);
+
+		ForEachInRadius(PieceCells, NewSocket.Location, OccupancyTolerance, [&](int32 OtherHandle)
+		{
+			FSnapSocket& Socket = Sockets[SocketHandle];
+			FPlacedPiece& Other = Pieces[OtherHandle];
+			if (OtherHandle != PieceHandle && Socket.OccupiedBy == INDEX_NONE
+				&& (Socket.Accepts & UStructureRegistrySubsystem::GetTypeBit(Other.TypeId)) != 0
+				&& FVector::DistSquared(Other.Location, Socket.Location) <= ToleranceSquared)
+			{
+				Socket.OccupiedBy = OtherHandle;
+				Other.OccupiedSockets.Add(SocketHandle);
+			}
+		});
+	}
+
+	if (Actor)
+	{
+		PieceHandles.Add(Actor, PieceHandle);
+		Actor->OnEndPlay.AddDynamic(this, &UBuildingSnapSubsystem::HandlePieceEndPlay);
+	}
+
+	OnPieceRegistered.Broadcast(PieceHandle);
+	return PieceHandle;
+}
+
+void UBuildingSnapSubsystem::SetPieceActor(int32 PieceHandle, AActor* Actor)
+{
+	if (!Pieces.IsValidIndex(PieceHandle) || Pieces[PieceHandle].Actor.Get() == Actor)
+	{
+		return;
+	}
+
+	if (AActor* OldActor = Pieces[PieceHandle].Actor.Get())
+	{
+		OldActor->OnEndPlay.RemoveDynamic(this, &UBuildingSnapSubsystem::HandlePieceEndPlay);
+		PieceHandles.Remove(OldActor);
+	}
+
+	Pieces[PieceHandle].Actor = Actor;
+	if (Actor)
+	{
+		PieceHandles.Add(Actor, PieceHandle);
+		Actor->OnEndPlay.AddDynamic(this, &UBuildingSnapSubsystem::HandlePieceEndPlay);
+	}
+}
+
+void UBuildingSnapSubsystem::UnregisterPiece(AActor* Actor)
+{
+	RemovePiece(FindPiece(Actor));
+}
+
+void UBuildingSnapSubsystem::RemovePiece(int32 PieceHandle)
+{
+	if (!Pieces.IsValidIndex(PieceHandle))
+	{
+		return;
+	}
+
+	// Listeners still see the piece's attachments
+	OnPieceUnregistered.Broadcast(PieceHandle);
+
+	SetPieceActor(PieceHandle, nullptr);
+
+	const FPlacedPiece& Piece = Pieces[PieceHandle];
+	for (const int32 SocketHandle : Piece.OwnSockets)
+	{
+		const FSnapSocket& Socket = Sockets[SocketHandle];
+		if (Socket.OccupiedBy != INDEX_NONE)
+		{
+			Pieces[Socket.OccupiedBy].OccupiedSockets.RemoveSingleSwap(SocketHandle, false);
+		}
+		RemoveFromCell(SocketCells, Socket.Cell, SocketHandle);
+		Sockets.RemoveAt(SocketHandle);
+	}
+	for (const int32 SocketHandle : Piece.OccupiedSockets)
+	{
+		Sockets[SocketHandle].OccupiedBy = INDEX_NONE;
+	}
+
+	RemoveFromCell(PieceCells, Piece.Cell, PieceHandle);
+	Pieces.RemoveAt(PieceHandle);
+}
+
+int32 UBuildingSnapSubsystem::FindBestSocket(FStructureTypeId TypeId, const FVector& Location, float MaxDistance) const
+{
+	if (TypeId == InvalidStructureType)
+	{
+		return INDEX_NONE;
+	}
+
+	const FStructureTypeMask TypeBit = UStructureRegistrySubsystem::GetTypeBit(TypeId);
+	float BestDistanceSquared = FMath::Square(MaxDistance);
+	int32 BestHandle = INDEX_NONE;
+
+	ForEachInRadius(SocketCells, Location, MaxDistance, [&](int32 SocketHandle)
+	{
+		const FSnapSocket& Socket = Sockets[SocketHandle];
+		if (Socket.OccupiedBy != INDEX_NONE || (Socket.Accepts & TypeBit) == 0)
+		{
+			return;
+		}
+
+		const float DistanceSquared = FVector::DistSquared(Socket.Location, Location);
+		if (DistanceSquared < BestDistanceSquared)
+		{
+			BestDistanceSquared = DistanceSquared;
+			BestHandle = SocketHandle;
+		}
+	});
+
+	return BestHandle;
+}
+
+FTransform UBuildingSnapSubsystem::GetSocketTransform(int32 SocketHandle) const
+{
+	return Sockets.IsValidIndex(SocketHandle)
+		       ? FTransform(Sockets[SocketHandle].Rotation, Sockets[SocketHandle].Location)
+		       : FTransform::Identity;
+}
+
+bool UBuildingSnapSubsystem::FindSnapTransform(TSubclassOf<AActor> StructureClass, const FVector& Location,
+                                               float MaxDistance, FTransform& OutTransform) const
+{
+	if (!StructureRegistry || !StructureClass)
+	{
+		return false;
+	}
+
+	const int32 SocketHandle = FindBestSocket(StructureRegistry->FindStructureType(StructureClass), Location,
+	                                          MaxDistance);
+	if (SocketHandle == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutTransform = GetSocketTransform(SocketHandle);
+	return true;
+}
+
+void UBuildingSnapSubsystem::GetAttachedPieces(int32 PieceHandle, TArray<int32>& OutPieces) const
+{
+	OutPieces.Reset();
+	if (!Pieces.IsValidIndex(PieceHandle))
+	{
+		return;
+	}
+
+	const FPlacedPiece& Piece = Pieces[PieceHandle];
+	for (const int32 SocketHandle : Piece.OwnSockets)
+	{
+		if (Sockets[SocketHandle].OccupiedBy != INDEX_NONE)
+		{
+			OutPieces.AddUnique(Sockets[SocketHandle].OccupiedBy);
+		}
+	}
+	for (const int32 SocketHandle : Piece.OccupiedSockets)
+	{
+		OutPieces.AddUnique(Sockets[SocketHandle].OwnerPiece);
+	}
+}
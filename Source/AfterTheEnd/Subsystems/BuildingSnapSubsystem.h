@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AfterTheEnd/Subsystems/StructureRegistrySubsystem.h"
+#include "BuildingSnapSubsystem.generated.h"
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBuildingPieceEvent, int32 /*PieceHandle*/);
+
+/*
+ * Snap sockets of every placed building piece in a spatial hash keyed by quantized position, so
+ * the build preview finds its snap with a few hash lookups instead of tracing and overlapping
+ * against the base every frame. Sockets remember which piece sits on them, which also makes
+ * this the place to ask which pieces are attached to each other.
+ *
+ * Spawned pieces register themselves on the next tick, once spawning has finished and they have a
+ * transform, with the sockets of their structure's build template. Build previews are spawned from
+ * the same classes and have to carry the PreviewTag to stay out. A piece keeps its handle while
+ * it has no actor, see SetPieceActor, and pieces that only exist as instances can be added from
+ * their build template too.
+ */
+UCLASS()
+class AFTERTHEEND_API UBuildingSnapSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	static const FName PreviewTag;
+
+	// Nearest free socket within MaxDistance that accepts the structure class
+	UFUNCTION(BlueprintCallable, Category=Building)
+	bool FindSnapTransform(TSubclassOf<AActor> StructureClass, const FVector& Location, float MaxDistance,
+	                       FTransform& OutTransform) const;
+
+	// Returns the socket handle or INDEX_NONE
+	int32 FindBestSocket(FStructureTypeId TypeId, const FVector& Location, float MaxDistance) const;
+
+	FTransform GetSocketTransform(int32 SocketHandle) const;
+
+	// Piece the socket belongs to
+	int32 GetSocketPiece(int32 SocketHandle) const
+	{
+		return Sockets.IsValidIndex(SocketHandle) ? Sockets[SocketHandle].OwnerPiece : INDEX_NONE;
+	}
+
+	bool IsPiece(const AActor* Actor) const { return PieceHandles.Contains(Actor); }
+
+	// Piece handle of a placed actor or INDEX_NONE
+	int32 FindPiece(const AActor* Actor) const
+	{
+		const int32* PieceHandle = PieceHandles.Find(Actor);
+		return PieceHandle ? *PieceHandle : INDEX_NONE;
+	}
+
+	bool IsValidPiece(int32 PieceHandle) const { return Pieces.IsValidIndex(PieceHandle); }
+
+	FStructureTypeId GetPieceType(int32 PieceHandle) const { return Pieces[PieceHandle].TypeId; }
+
+	// Null while the piece is represented by something else
+	AActor* GetPieceActor(int32 PieceHandle) const { return Pieces[PieceHandle].Actor.Get(); }
+
+	FTransform GetPieceTransform(int32 PieceHandle) const
+	{
+		return FTransform(Pieces[PieceHandle].Rotation, Pieces[PieceHandle].Location);
+	}
+
+	// Swaps the actor standing for a piece without touching its sockets, nothing if it already is
+	void SetPieceActor(int32 PieceHandle, AActor* Actor);
+
+	// The next actor of the piece's structure spawned stands for the piece instead of registering as
+	// a new one, until cleared with INDEX_NONE. Set around spawning an actor for an existing piece.
+	void SetPendingPieceActor(int32 PieceHandle) { PendingActorPiece = PieceHandle; }
+
+	// Piece without an actor
+	int32 AddTemplatePiece(FStructureTypeId TypeId, const FTransform& Transform);
+	void RemovePiece(int32 PieceHandle);
+
+	// Pieces sitting on the piece's sockets and pieces whose sockets it sits on
+	void GetAttachedPieces(int32 PieceHandle, TArray<int32>& OutPieces) const;
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetNumPieces() const { return Pieces.Num(); }
+
+	// Upper bound of piece handles, for walking every piece with IsValidPiece
+	int32 GetMaxPieceHandle() const { return Pieces.GetMaxIndex(); }
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	int32 GetNumSockets() const { return Sockets.Num(); }
+
+	FOnBuildingPieceEvent OnPieceRegistered;
+	FOnBuildingPieceEvent OnPieceUnregistered;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	struct FSnapSocket
+	{
+		FVector Location;
+		FQuat Rotation;
+		FIntVector Cell;
+		FStructureTypeMask Accepts;
+		int32 OwnerPiece;
+		int32 OccupiedBy = INDEX_NONE;
+	};
+
+	struct FPlacedPiece
+	{
+		TWeakObjectPtr<AActor> Actor;
+		FVector Location;
+		FQuat Rotation;
+		FIntVector Cell;
+		FStructureTypeId TypeId;
+		TArray<int32, TInlineAllocator<8>> OwnSockets;
+		TArray<int32, TInlineAllocator<2>> OccupiedSockets;
+	};
+
+	void HandleActorSpawned(AActor* Actor);
+	void RegisterSpawnedActors();
+
+	UFUNCTION()
+	void HandlePieceEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	void RegisterPiece(AActor* Actor);
+	void UnregisterPiece(AActor* Actor);
+
+	// The structure's build template sockets placed at Transform
+	void GetTemplateSockets(FStructureTypeId TypeId, const FTransform& Transform,
+	                        TArray<FBuildableTemplate::FSocket, TInlineAllocator<8>>& OutSockets) const;
+
+	// Socket transforms in world space
+	int32 AddPiece(AActor* Actor, FStructureTypeId TypeId, const FTransform& Transform,
+	               TConstArrayView<FBuildableTemplate::FSocket> WorldSockets);
+
+	FIntVector GetCell(const FVector& Location) const;
+
+	// Calls Visitor with every handle in the cells overlapping the sphere
+	void ForEachInRadius(const TMap<FIntVector, TArray<int32>>& Cells, const FVector& Location, float Radius,
+	                     TFunctionRef<void(int32 Handle)> Visitor) const;
+
+	static void AddToCell(TMap<FIntVector, TArray<int32>>& Cells, const FIntVector& Cell, int32 Handle);
+	static void RemoveFromCell(TMap<FIntVector, TArray<int32>>& Cells, const FIntVector& Cell, int32 Handle);
+
+	// Roughly a piece's size, so a query touches a handful of cells
+	static constexpr float CellSize = 250.f;
+
+	// How far a piece's origin may be from a socket and still count as sitting on it
+	static constexpr float OccupancyTolerance = 10.f;
+
+	TSparseArray<FSnapSocket> Sockets;
+	TSparseArray<FPlacedPiece> Pieces;
+	TMap<FIntVector, TArray<int32>> SocketCells;
+	TMap<FIntVector, TArray<int32>> PieceCells;
+	TMap<TObjectKey<AActor>, int32> PieceHandles;
+
+	int32 PendingActorPiece = INDEX_NONE;
+
+	// Structures spawned since the last RegisterSpawnedActors
+	TArray<TWeakObjectPtr<AActor>> SpawnedActors;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStructureRegistrySubsystem> StructureRegistry;
+
+	FDelegateHandle ActorSpawnedHandle;
+};
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CraftingSubsystem.h"
+#include "AfterTheEnd/Components/CraftingComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
+
+bool UCraftingSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCraftingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCraftingSubsystem, STATGROUP_Tickables);
+}
+
+double UCraftingSubsystem::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+void UCraftingSubsystem::ScheduleCompletion(UCraftingComponent* CraftingComponent, int32 EntryId, double CompletionTime)
+{
+	CompletionHeap.HeapPush({CompletionTime, CraftingComponent, EntryId});
+}
+
+void UCraftingSubsystem::Tick(float DeltaTime)
+{
+	if (CompletionHeap.IsEmpty())
+	{
+		return;
+	}
+
+	const double Now = GetServerTime();
+	while (!CompletionHeap.IsEmpty() && CompletionHeap.HeapTop().CompletionTime <= Now)
+	{
+		FScheduledCompletion Completion;
+		CompletionHeap.HeapPop(Completion, false);
+
+		// May schedule the next completion, which is fine mid loop
+		if (UCraftingComponent* CraftingComponent = Completion.CraftingComponent.Get())
+		{
+			CraftingComponent->CompleteCraftingUnit(Completion.EntryId, Completion.CompletionTime);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CraftingSubsystem.generated.h"
+
+class UCraftingComponent;
+
+/*
+ * Completes crafting on the server. Every player's next completion sits in one min-heap keyed by
+ * server time, so a frame only looks at the crafts that are actually due instead of ticking every
+ * crafting queue.
+ */
+UCLASS()
+class AFTERTHEEND_API UCraftingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Calls CompleteCraftingUnit(EntryId) on the component once server time reaches CompletionTime
+	void ScheduleCompletion(UCraftingComponent* CraftingComponent, int32 EntryId, double CompletionTime);
+
+	// Time base shared by clients and server, used to stamp crafting progress
+	double GetServerTime() const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	struct FScheduledCompletion
+	{
+		double CompletionTime;
+		TWeakObjectPtr<UCraftingComponent> CraftingComponent;
+		int32 EntryId;
+
+		bool operator<(const FScheduledCompletion& Other) const { return CompletionTime < Other.CompletionTime; }
+	};
+
+	// Cancelled entries stay in the heap and are ignored by the component when they come due
+	TArray<FScheduledCompletion> CompletionHeap;
+};
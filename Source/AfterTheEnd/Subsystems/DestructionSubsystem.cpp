@@ -0,0 +1,270 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DestructionSubsystem.h"
+#include "AfterTheEnd/Data/ComponentTemplates.h"
+#include "AfterTheEnd/Harvest/DestructionDebris.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GeometryCollection/GeometryCollectionComponent.h"
+#include "GeometryCollection/GeometryCollectionObject.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDestruction, Log, All);
+
+static TAutoConsoleVariable<int32> CVarMaxSimulations(
+	TEXT("ate.Destruction.MaxSimulations"),
+	6,
+	TEXT("Debris simulating physics at once, anything broken past it plays a canned animation"));
+
+static TAutoConsoleVariable<float> CVarSimulationDistance(
+	TEXT("ate.Destruction.SimulationDistance"),
+	6000.f,
+	TEXT("Distance from the local player's view past which debris plays a canned animation"));
+
+static TAutoConsoleVariable<int32> CVarMaxDebris(
+	TEXT("ate.Destruction.MaxDebris"),
+	32,
+	TEXT("Debris lying around at once, the oldest queues to fade early past it"));
+
+static TAutoConsoleVariable<float> CVarBreakTime(
+	TEXT("ate.Destruction.BreakTime"),
+	6.f,
+	TEXT("Seconds debris lies around before it queues to fade"));
+
+static TAutoConsoleVariable<float> CVarFadeTime(
+	TEXT("ate.Destruction.FadeTime"),
+	2.f,
+	TEXT("Seconds debris takes to sink into the ground"));
+
+static TAutoConsoleVariable<int32> CVarFadesPerFrame(
+	TEXT("ate.Destruction.FadesPerFrame"),
+	2,
+	TEXT("Debris starting to fade each frame at most"));
+
+// Seconds the canned animation takes, within BreakTime
+static constexpr float CannedTime = 1.5f;
+
+bool UDestructionSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UDestructionSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDestructionSubsystem, STATGROUP_Tickables);
+}
+
+const UDestructionSubsystem::FDestructTemplate& UDestructionSubsystem::FindOrAddTemplate(UClass* DestructClass)
+{
+	if (const int32* TemplateId = TemplateIds.Find(DestructClass))
+	{
+		return Templates[*TemplateId];
+	}
+
+	// The first geometry collection or visible static mesh, which is what the Blueprint breaks
+	FDestructTemplate Template;
+	ComponentTemplates::ForEach(DestructClass, [&Template](FName Name, const UActorComponent* ComponentTemplate,
+	                                                       const FTransform& Transform)
+	{
+		UObject* Mesh = nullptr;
+		if (const UGeometryCollectionComponent* Collection = Cast<UGeometryCollectionComponent>(ComponentTemplate))
+		{
+			Mesh = const_cast<UGeometryCollection*>(Collection->GetRestCollection());
+		}
+		else if (const UStaticMeshComponent* StaticMesh = Cast<UStaticMeshComponent>(ComponentTemplate))
+		{
+			Mesh = StaticMesh->GetVisibleFlag() ? StaticMesh->GetStaticMesh() : nullptr;
+		}
+
+		if (Template.Mesh || !Mesh)
+		{
+			return;
+		}
+
+		const UPrimitiveComponent* MeshTemplate = CastChecked<UPrimitiveComponent>(ComponentTemplate);
+		Template.Mesh = Mesh;
+		Template.MeshTransform = Transform;
+		for (int32 Index = 0; Index < MeshTemplate->GetNumMaterials(); ++Index)
+		{
+			Template.Materials.Add(MeshTemplate->GetMaterial(Index));
+		}
+	});
+
+	if (!Template.Mesh)
+	{
+		UE_LOG(LogDestruction, Warning, TEXT("Destruct class %s has no geometry collection or static mesh"),
+		       *DestructClass->GetName());
+	}
+
+	// Remembered either way so a class without a mesh isn't looked through again
+	TemplateIds.Add(DestructClass, Templates.Num());
+	LoadedClasses.Add(DestructClass);
+	return Templates.Add_GetRef(MoveTemp(Template));
+}
+
+void UDestructionSubsystem::PlayDestruction(TSubclassOf<AActor> DestructClass, const FTransform& Transform,
+                                            FVector Direction)
+{
+	if (!DestructClass || GetWorld()->GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	const FDestructTemplate& Template = FindOrAddTemplate(DestructClass);
+	ADestructionDebris* Debris = Template.Mesh ? AcquireDebris(Template) : nullptr;
+	if (!Debris)
+	{
+		return;
+	}
+
+	// Past the cap the oldest debris still lying around makes room by fading early
+	if (Active.Num() >= CVarMaxDebris.GetValueOnGameThread())
+	{
+		for (FActiveDebris& Entry : Active)
+		{
+			if (Entry.Phase == EDebrisPhase::Breaking)
+			{
+				Entry.Phase = EDebrisPhase::WaitingToFade;
+				break;
+			}
+		}
+	}
+
+	Direction = Direction.GetSafeNormal2D();
+	if (Direction.IsNearlyZero())
+	{
+		Direction = Transform.GetRotation().GetForwardVector().GetSafeNormal2D();
+	}
+
+	const FTransform MeshTransform = Template.MeshTransform * Transform;
+	Debris->Activate(MeshTransform, Template.Materials);
+
+	FActiveDebris& Entry = Active.AddDefaulted_GetRef();
+	Entry.Debris = Debris;
+	Entry.Mesh = Template.Mesh;
+	Entry.Direction = Direction;
+	Entry.bCanned = !ShouldSimulate(MeshTransform.GetLocation());
+	if (Entry.bCanned)
+	{
+		return;
+	}
+
+	Debris->StartSimulation(Direction, FellImpulse, BreakStrain, BreakRadius);
+	++NumSimulating;
+}
+
+bool UDestructionSubsystem::ShouldSimulate(const FVector& Location) const
+{
+	if (NumSimulating >= CVarMaxSimulations.GetValueOnGameThread())
+	{
+		return false;
+	}
+
+	// Local players only, a listen server doesn't simulate for its remote players either
+	const float SimulationDistance = CVarSimulationDistance.GetValueOnGameThread();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController || !PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		if (FVector::DistSquared(ViewLocation, Location) <= FMath::Square(SimulationDistance))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+ADestructionDebris* UDestructionSubsystem::AcquireDebris(const FDestructTemplate& Template)
+{
+	TArray<TWeakObjectPtr<ADestructionDebris>>& Pool = Pools.FindOrAdd(Template.Mesh);
+	while (Pool.Num() > 0)
+	{
+		if (ADestructionDebris* Debris = Pool.Pop(false).Get())
+		{
+			return Debris;
+		}
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.ObjectFlags |= RF_Transient;
+	ADestructionDebris* Debris = GetWorld()->SpawnActor<ADestructionDebris>(SpawnParameters);
+	if (Debris)
+	{
+		Debris->InitMesh(Template.Mesh);
+	}
+	return Debris;
+}
+
+void UDestructionSubsystem::ReleaseDebris(ADestructionDebris* Debris, UObject* Mesh)
+{
+	Debris->Deactivate();
+	Pools.FindOrAdd(Mesh).Add(Debris);
+}
+
+void UDestructionSubsystem::Tick(float DeltaTime)
+{
+	const float BreakTime = FMath::Max(CVarBreakTime.GetValueOnGameThread(), CannedTime);
+	const float FadeTime = FMath::Max(CVarFadeTime.GetValueOnGameThread(), KINDA_SMALL_NUMBER);
+	int32 FadeBudget = CVarFadesPerFrame.GetValueOnGameThread();
+
+	NumSimulating = 0;
+	for (int32 Index = 0; Index < Active.Num();)
+	{
+		FActiveDebris& Entry = Active[Index];
+		ADestructionDebris* Debris = Entry.Debris.Get();
+		if (!Debris)
+		{
+			Active.RemoveAt(Index);
+			continue;
+		}
+
+		Entry.Time += DeltaTime;
+		if (Entry.Phase == EDebrisPhase::Breaking)
+		{
+			if (Entry.bCanned)
+			{
+				Debris->SetCannedPose(Entry.Direction, FMath::Min(Entry.Time / CannedTime, 1.f));
+			}
+			if (Entry.Time >= BreakTime)
+			{
+				Entry.Phase = EDebrisPhase::WaitingToFade;
+			}
+		}
+
+		if (Entry.Phase == EDebrisPhase::WaitingToFade && FadeBudget > 0)
+		{
+			--FadeBudget;
+			if (Entry.bCanned)
+			{
+				Debris->SetCannedPose(Entry.Direction, 1.f);
+			}
+			Debris->StartFade();
+			Entry.Phase = EDebrisPhase::Fading;
+			Entry.Time = 0.f;
+		}
+
+		if (Entry.Phase == EDebrisPhase::Fading)
+		{
+			Debris->SetFadePose(FMath::Min(Entry.Time / FadeTime, 1.f));
+			if (Entry.Time >= FadeTime)
+			{
+				ReleaseDebris(Debris, Entry.Mesh);
+				Active.RemoveAt(Index);
+				continue;
+			}
+		}
+
+		NumSimulating += Debris->IsSimulating() ? 1 : 0;
+		++Index;
+	}
+}
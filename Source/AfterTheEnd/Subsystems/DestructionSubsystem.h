@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "DestructionSubsystem.generated.h"
+
+class ADestructionDebris;
+class UMaterialInterface;
+
+/*
+ * Breaks harvested resources apart on this machine only, in place of spawning their replicated
+ * destruct class (BP_DestructableTree, BP_DestructableRock, ...), which simulated on the server and
+ * every client. Debris comes out of a pool per mesh and goes back into it, never destroyed.
+ *
+ * At most ate.Destruction.MaxSimulations pieces of debris simulate at once, and only within
+ * ate.Destruction.SimulationDistance of the local player. Past either, trees tip over and rocks
+ * crumble in a canned animation instead. Debris lies for ate.Destruction.BreakTime seconds, then
+ * queues to sink into the ground, at most ate.Destruction.FadesPerFrame starting each frame, so what
+ * ten players felling palms at once leave behind is cleared over several frames.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UDestructionSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Breaks what DestructClass breaks, placed as the actor would be at Transform, falling towards
+	// Direction. Cosmetic, does nothing on a dedicated server.
+	UFUNCTION(BlueprintCallable, Category=Harvesting)
+	void PlayDestruction(TSubclassOf<AActor> DestructClass, const FTransform& Transform, FVector Direction);
+
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	int32 GetNumSimulating() const { return NumSimulating; }
+
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	int32 GetNumDebris() const { return Active.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	struct FDestructTemplate
+	{
+		// UStaticMesh or UGeometryCollection, null if the class has neither
+		UObject* Mesh = nullptr;
+
+		// Of the mesh component, relative to the actor
+		FTransform MeshTransform;
+
+		TArray<UMaterialInterface*> Materials;
+	};
+
+	const FDestructTemplate& FindOrAddTemplate(UClass* DestructClass);
+	ADestructionDebris* AcquireDebris(const FDestructTemplate& Template);
+	void ReleaseDebris(ADestructionDebris* Debris, UObject* Mesh);
+
+	bool ShouldSimulate(const FVector& Location) const;
+
+	// Speed felled trees are pushed over with at their top
+	UPROPERTY(Config)
+	float FellImpulse = 200.f;
+
+	// Of the strain field breaking geometry collections, FS_DestructionForce's
+	UPROPERTY(Config)
+	float BreakStrain = 500000.f;
+
+	UPROPERTY(Config)
+	float BreakRadius = 500.f;
+
+	TArray<FDestructTemplate> Templates;
+	TMap<TObjectKey<UClass>, int32> TemplateIds;
+
+	// Keeps the destruct classes, and the meshes and materials of their templates, loaded
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UClass>> LoadedClasses;
+
+	// Inactive debris by mesh
+	TMap<TObjectKey<UObject>, TArray<TWeakObjectPtr<ADestructionDebris>>> Pools;
+
+	enum class EDebrisPhase : uint8
+	{
+		Breaking,
+		WaitingToFade,
+		Fading
+	};
+
+	struct FActiveDebris
+	{
+		TWeakObjectPtr<ADestructionDebris> Debris;
+		UObject* Mesh = nullptr;
+		FVector Direction;
+		float Time = 0.f;
+		EDebrisPhase Phase = EDebrisPhase::Breaking;
+		bool bCanned = false;
+	};
+
+	// Oldest first, which is the order they fade in
+	TArray<FActiveDebris> Active;
+
+	int32 NumSimulating = 0;
+};
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ExperienceSubsystem.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Algo/BinarySearch.h"
+#include "Engine/DataTable.h"
+
+void UExperienceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CompileExperienceTable();
+}
+
+void UExperienceSubsystem::CompileExperienceTable()
+{
+	// Level 1 needs nothing, each row is the experience needed for the next level
+	CumulativeThresholds.Reset();
+	CumulativeThresholds.Add(0);
+
+	const UDataTable* Table = ExperienceTable.LoadSynchronous();
+	if (!Table)
+	{
+		return;
+	}
+
+	const FProperty* ExperienceNeededField = DataTableFields::FindField(Table->GetRowStruct(), TEXT("ExperienceNeeded"));
+	if (!ExperienceNeededField)
+	{
+		return;
+	}
+
+	CumulativeThresholds.Reserve(Table->GetRowMap().Num() + 1);
+	for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+	{
+		const int32 ExperienceNeeded = static_cast<int32>(DataTableFields::GetInt(ExperienceNeededField, Row.Value));
+		CumulativeThresholds.Add(CumulativeThresholds.Last() + FMath::Max(ExperienceNeeded, 0));
+	}
+}
+
+int32 UExperienceSubsystem::GetLevelForExperience(int32 Experience) const
+{
+	// Number of thresholds already reached
+	return FMath::Max(Algo::UpperBound(CumulativeThresholds, Experience), 1);
+}
+
+int32 UExperienceSubsystem::GetExperienceForLevel(int32 Level) const
+{
+	if (CumulativeThresholds.IsEmpty())
+	{
+		return 0;
+	}
+	return CumulativeThresholds[FMath::Clamp(Level - 1, 0, CumulativeThresholds.Num() - 1)];
+}
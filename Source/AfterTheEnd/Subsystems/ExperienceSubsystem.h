@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "ExperienceSubsystem.generated.h"
+
+class UDataTable;
+
+/*
+ * DT_Experience compiled once into cumulative thresholds, so the level for an amount of
+ * experience is a binary search instead of a walk over table rows.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UExperienceSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	// Levels start at 1 with zero experience
+	UFUNCTION(BlueprintPure, Category=Experience)
+	int32 GetLevelForExperience(int32 Experience) const;
+
+	// Total experience needed to reach Level, clamped to the last level in the table
+	UFUNCTION(BlueprintPure, Category=Experience)
+	int32 GetExperienceForLevel(int32 Level) const;
+
+	UFUNCTION(BlueprintPure, Category=Experience)
+	int32 GetMaxLevel() const { return CumulativeThresholds.Num(); }
+
+protected:
+	void CompileExperienceTable();
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UDataTable> ExperienceTable;
+
+	// Element i is the total experience needed to reach level i + 1
+	TArray<int32> CumulativeThresholds;
+};
@@ -0,0 +1,698 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HarvestSubsystem.h"
+#include "AfterTheEnd/Data/ComponentTemplates.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "AfterTheEnd/Harvest/HarvestCellActor.h"
+#include "AfterTheEnd/Subsystems/DestructionSubsystem.h"
+#include "AfterTheEnd/Subsystems/HarvestYieldSubsystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogHarvest, Log, All);
+
+static TAutoConsoleVariable<float> CVarProxyIdleTime(
+	TEXT("ate.Harvest.ProxyIdleTime"),
+	20.f,
+	TEXT("Seconds a harvest proxy has to be left alone before it is turned back into its instance"));
+
+static TAutoConsoleVariable<float> CVarRespawnSaveInterval(
+	TEXT("ate.Harvest.RespawnSaveInterval"),
+	300.f,
+	TEXT("Seconds between saves of the pending resource respawns"));
+
+// How often idle proxies are looked for
+static constexpr float DemoteInterval = 2.f;
+
+// Respawns are due at whole seconds of world time
+static constexpr float RespawnInterval = 1.f;
+
+static constexpr int32 RespawnSaveVersion = 1;
+
+// Hidden instances keep their place in the instanced mesh, shrunk to nothing
+static constexpr float HiddenScale = 1e-3f;
+
+// How far a client may find an instance from the proxy's mesh and still take it for the proxy's
+static constexpr float ProxyMatchTolerance = 5.f;
+
+// Cells number their instances with 16 bits
+static constexpr int32 MaxCellInstances = 65536;
+
+bool UHarvestSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UHarvestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CompileHarvestableTypes();
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(
+		FOnActorSpawned::FDelegate::CreateUObject(this, &UHarvestSubsystem::HandleActorSpawned));
+}
+
+void UHarvestSubsystem::Deinitialize()
+{
+	if (bRespawnsLoaded)
+	{
+		SaveRespawns();
+	}
+
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	GetWorld()->GetTimerManager().ClearTimer(DemoteTimer);
+	GetWorld()->GetTimerManager().ClearTimer(RespawnTimer);
+	GetWorld()->GetTimerManager().ClearTimer(RespawnSaveTimer);
+
+	Super::Deinitialize();
+}
+
+void UHarvestSubsystem::CompileHarvestableTypes()
+{
+	for (const TSoftClassPtr<AActor>& SoftClass : HarvestableClasses)
+	{
+		UClass* HarvestClass = SoftClass.LoadSynchronous();
+		if (!HarvestClass)
+		{
+			UE_LOG(LogHarvest, Warning, TEXT("Harvestable class %s could not be loaded"), *SoftClass.ToString());
+			continue;
+		}
+
+		// The one visible static mesh of the class is what its instances are drawn with
+		FHarvestableType Type;
+		Type.HarvestClass = HarvestClass;
+		Type.HealthField = DataTableFields::FindField(HarvestClass, TEXT("Health"));
+		Type.FullHealth = DataTableFields::GetFloat(Type.HealthField, HarvestClass->GetDefaultObject());
+		ComponentTemplates::ForEach(HarvestClass, [&Type](FName Name, const UActorComponent* Template,
+		                                                  const FTransform& Transform)
+		{
+			const UStaticMeshComponent* MeshTemplate = Cast<UStaticMeshComponent>(Template);
+			if (!Type.Mesh && MeshTemplate && MeshTemplate->GetStaticMesh() && MeshTemplate->GetVisibleFlag())
+			{
+				Type.Mesh = MeshTemplate->GetStaticMesh();
+				Type.MeshTransform = Transform;
+			}
+		});
+
+		if (!Type.Mesh || MeshTypes.Contains(Type.Mesh))
+		{
+			UE_LOG(LogHarvest, Warning, TEXT("Harvestable class %s has no static mesh of its own"),
+			       *HarvestClass->GetName());
+			continue;
+		}
+
+		const int32 TypeId = Types.Add(Type);
+		MeshTypes.Add(Type.Mesh, TypeId);
+		ClassTypes.Add(HarvestClass, TypeId);
+		LoadedClasses.Add(HarvestClass);
+	}
+}
+
+void UHarvestSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// The yield tables live on the game instance, there by now
+	if (const UHarvestYieldSubsystem* HarvestYield = UHarvestYieldSubsystem::Get(&InWorld))
+	{
+		for (FHarvestableType& Type : Types)
+		{
+			Type.DestructClass = HarvestYield->GetDestructClass(HarvestYield->FindNodeId(Type.HarvestClass));
+		}
+	}
+
+	// Foliage and anything else drawing harvestable meshes as instances
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		TInlineComponentArray<UHierarchicalInstancedStaticMeshComponent*> Components(*It);
+		for (UHierarchicalInstancedStaticMeshComponent* InstancedMesh : Components)
+		{
+			RegisterInstancedMesh(InstancedMesh);
+		}
+	}
+	BuildCells();
+
+	if (InWorld.GetNetMode() != NM_Client)
+	{
+		InWorld.GetTimerManager().SetTimer(DemoteTimer, this, &UHarvestSubsystem::DemoteIdleProxies, DemoteInterval,
+		                                   true);
+
+		LoadRespawns();
+		InWorld.GetTimerManager().SetTimer(RespawnTimer, this, &UHarvestSubsystem::AdvanceRespawns, RespawnInterval,
+		                                   true);
+		InWorld.GetTimerManager().SetTimer(RespawnSaveTimer, this, &UHarvestSubsystem::SaveRespawns,
+		                                   FMath::Max(CVarRespawnSaveInterval.GetValueOnGameThread(), 1.f), true);
+	}
+}
+
+void UHarvestSubsystem::RegisterInstancedMesh(UHierarchicalInstancedStaticMeshComponent* InstancedMesh)
+{
+	const int32* TypeId = MeshTypes.Find(InstancedMesh->GetStaticMesh());
+	if (!TypeId || InstancedMeshIndices.Contains(InstancedMesh))
+	{
+		return;
+	}
+
+	const int32 MeshIndex = InstancedMeshes.Add({InstancedMesh, *TypeId});
+	InstancedMeshIndices.Add(InstancedMesh, MeshIndex);
+}
+
+void UHarvestSubsystem::BuildCells()
+{
+	struct FCellEntry
+	{
+		FInstanceKey Instance;
+		int32 TypeId;
+		FIntVector Location;
+
+		bool operator<(const FCellEntry& Other) const
+		{
+			if (TypeId != Other.TypeId)
+			{
+				return TypeId < Other.TypeId;
+			}
+			if (Location.X != Other.Location.X)
+			{
+				return Location.X < Other.Location.X;
+			}
+			if (Location.Y != Other.Location.Y)
+			{
+				return Location.Y < Other.Location.Y;
+			}
+			return Location.Z < Other.Location.Z;
+		}
+	};
+
+	TMap<FIntPoint, TArray<FCellEntry>> Entries;
+	InstanceSlots.SetNum(InstancedMeshes.Num());
+	for (int32 MeshIndex = 0; MeshIndex < InstancedMeshes.Num(); ++MeshIndex)
+	{
+		const UHierarchicalInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[MeshIndex].Component.Get();
+		const int32 NumInstances = InstancedMesh ? InstancedMesh->GetInstanceCount() : 0;
+		InstanceSlots[MeshIndex].SetNum(NumInstances);
+		for (int32 InstanceIndex = 0; InstanceIndex < NumInstances; ++InstanceIndex)
+		{
+			FTransform Transform;
+			InstancedMesh->GetInstanceTransform(InstanceIndex, Transform, true);
+			const FVector Location = Transform.GetLocation();
+			const FIntPoint Coord(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+			Entries.FindOrAdd(Coord).Add({
+				FInstanceKey(MeshIndex, InstanceIndex), InstancedMeshes[MeshIndex].TypeId,
+				FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z))
+			});
+		}
+	}
+
+	// Numbered by what they are and where, which doesn't depend on the order server and clients
+	// happen to load the foliage in
+	for (TPair<FIntPoint, TArray<FCellEntry>>& Pair : Entries)
+	{
+		TArray<FCellEntry>& CellEntries = Pair.Value;
+		CellEntries.Sort();
+		if (CellEntries.Num() > MaxCellInstances)
+		{
+			UE_LOG(LogHarvest, Warning, TEXT("Harvest cell %s has %d instances, only %d of them can be harvested"),
+			       *Pair.Key.ToString(), CellEntries.Num(), MaxCellInstances);
+			CellEntries.SetNum(MaxCellInstances);
+		}
+
+		const int32 CellIndex = Cells.AddDefaulted();
+		FHarvestCell& Cell = Cells[CellIndex];
+		Cell.Coord = Pair.Key;
+		Cell.AppliedWords.SetNumZeroed(FMath::DivideAndRoundUp(CellEntries.Num(), 32));
+		FBox Bounds(ForceInit);
+		for (const FCellEntry& Entry : CellEntries)
+		{
+			InstanceSlots[Entry.Instance.X][Entry.Instance.Y] = {CellIndex, Cell.Instances.Num()};
+			Cell.Instances.Add(Entry.Instance);
+			Bounds += FVector(Entry.Location);
+		}
+		Cell.Center = Bounds.GetCenter();
+		CellIndices.Add(Cell.Coord, CellIndex);
+	}
+
+	// Cell actors a late joining client received before its cells existed had nothing to apply to
+	for (TActorIterator<AHarvestCellActor> It(GetWorld()); It; ++It)
+	{
+		ApplyCellState(**It, false);
+	}
+}
+
+const UHarvestSubsystem::FCellSlot* UHarvestSubsystem::FindCellSlot(const FInstanceKey& Instance) const
+{
+	const FCellSlot* Slot = InstanceSlots.IsValidIndex(Instance.X) && InstanceSlots[Instance.X].IsValidIndex(Instance.Y)
+		                        ? &InstanceSlots[Instance.X][Instance.Y]
+		                        : nullptr;
+	return Slot && Slot->Cell != INDEX_NONE ? Slot : nullptr;
+}
+
+AHarvestCellActor* UHarvestSubsystem::FindOrSpawnCellActor(int32 CellIndex)
+{
+	FHarvestCell& Cell = Cells[CellIndex];
+	if (AHarvestCellActor* CellActor = Cell.Actor.Get())
+	{
+		return CellActor;
+	}
+
+	AHarvestCellActor* CellActor = GetWorld()->SpawnActor<AHarvestCellActor>(Cell.Center, FRotator::ZeroRotator);
+	if (CellActor)
+	{
+		CellActor->InitCell(Cell.Coord, Cell.Instances.Num());
+		Cell.Actor = CellActor;
+	}
+	return CellActor;
+}
+
+bool UHarvestSubsystem::IsInstanceDepleted(const FInstanceKey& Instance) const
+{
+	const FCellSlot* Slot = FindCellSlot(Instance);
+	return Slot && (Cells[Slot->Cell].AppliedWords[Slot->Instance / 32] & (1u << (Slot->Instance % 32))) != 0;
+}
+
+void UHarvestSubsystem::SetInstanceDepleted(const FInstanceKey& Instance, bool bDepleted)
+{
+	const FCellSlot* Slot = FindCellSlot(Instance);
+	if (Slot && SetCellInstanceDepleted(Slot->Cell, Slot->Instance, bDepleted, true) && bDepleted)
+	{
+		Respawns.Schedule(PackRespawn(Slot->Cell, Slot->Instance),
+		                  GetRespawnTick() + FMath::Max(FMath::CeilToInt(RespawnTime), 1));
+	}
+}
+
+bool UHarvestSubsystem::SetCellInstanceDepleted(int32 CellIndex, int32 CellInstance, bool bDepleted,
+                                                bool bPlayDestruction)
+{
+	FHarvestCell& Cell = Cells[CellIndex];
+	const bool bWasDepleted = (Cell.AppliedWords[CellInstance / 32] & (1u << (CellInstance % 32))) != 0;
+	AHarvestCellActor* CellActor = bWasDepleted != bDepleted ? FindOrSpawnCellActor(CellIndex) : nullptr;
+	if (!CellActor)
+	{
+		return false;
+	}
+
+	CellActor->SetDepleted(CellInstance, bDepleted);
+	ApplyCellState(*CellActor, bPlayDestruction);
+	return true;
+}
+
+uint64 UHarvestSubsystem::GetRespawnTick() const
+{
+	return static_cast<uint64>(GetWorld()->GetTimeSeconds());
+}
+
+uint64 UHarvestSubsystem::PackRespawn(int32 CellIndex, int32 CellInstance) const
+{
+	// By cell coordinates, cell indices aren't the same from one run to the next
+	const FIntPoint& Coord = Cells[CellIndex].Coord;
+	return static_cast<uint64>(Coord.X & 0xFFFFFF) << 40 | static_cast<uint64>(Coord.Y & 0xFFFFFF) << 16
+		| static_cast<uint64>(CellInstance);
+}
+
+bool UHarvestSubsystem::UnpackRespawn(uint64 Payload, int32& OutCellIndex, int32& OutCellInstance) const
+{
+	// Sign extended from 24 bits
+	const FIntPoint Coord(static_cast<int32>(static_cast<uint32>(Payload >> 40) << 8) >> 8,
+	                      static_cast<int32>(static_cast<uint32>(Payload >> 16) << 8) >> 8);
+	const int32* CellIndex = CellIndices.Find(Coord);
+	OutCellInstance = static_cast<int32>(Payload & 0xFFFF);
+	if (!CellIndex || !Cells[*CellIndex].Instances.IsValidIndex(OutCellInstance))
+	{
+		return false;
+	}
+	OutCellIndex = *CellIndex;
+	return true;
+}
+
+void UHarvestSubsystem::AdvanceRespawns()
+{
+	Respawns.Advance(GetRespawnTick(), [this](uint64 Payload)
+	{
+		int32 CellIndex, CellInstance;
+		if (UnpackRespawn(Payload, CellIndex, CellInstance))
+		{
+			SetCellInstanceDepleted(CellIndex, CellInstance, false, false);
+		}
+	});
+}
+
+FString UHarvestSubsystem::GetRespawnSavePath() const
+{
+	return FPaths::ProjectSavedDir() / TEXT("Harvest") / UWorld::RemovePIEPrefix(GetWorld()->GetMapName())
+		+ TEXT(".respawns");
+}
+
+void UHarvestSubsystem::LoadRespawns()
+{
+	Respawns.Reset(GetRespawnTick());
+	bRespawnsLoaded = true;
+
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *GetRespawnSavePath(), FILEREAD_Silent))
+	{
+		return;
+	}
+
+	FMemoryReader Reader(Data);
+	int32 Version = 0;
+	Reader << Version;
+	if (Version != RespawnSaveVersion)
+	{
+		UE_LOG(LogHarvest, Warning, TEXT("Ignoring pending respawns saved with version %d"), Version);
+		return;
+	}
+	Respawns.Serialize(Reader);
+
+	// What is waiting to respawn was depleted when saved
+	Respawns.ForEach([this](uint64 Payload, uint64 DueTick)
+	{
+		int32 CellIndex, CellInstance;
+		if (UnpackRespawn(Payload, CellIndex, CellInstance))
+		{
+			SetCellInstanceDepleted(CellIndex, CellInstance, true, false);
+		}
+	});
+	UE_LOG(LogHarvest, Log, TEXT("Loaded %d pending respawns"), Respawns.Num());
+}
+
+void UHarvestSubsystem::SaveRespawns()
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+	int32 Version = RespawnSaveVersion;
+	Writer << Version;
+	Respawns.Serialize(Writer);
+
+	if (!FFileHelper::SaveArrayToFile(Data, *GetRespawnSavePath()))
+	{
+		UE_LOG(LogHarvest, Warning, TEXT("Pending respawns could not be saved to %s"), *GetRespawnSavePath());
+	}
+}
+
+void UHarvestSubsystem::ApplyCellState(AHarvestCellActor& CellActor, bool bPlayDestruction)
+{
+	const int32* CellIndex = CellIndices.Find(CellActor.GetCell());
+	if (!CellIndex)
+	{
+		return;
+	}
+
+	FHarvestCell& Cell = Cells[*CellIndex];
+	Cell.Actor = &CellActor;
+
+	const TArray<uint32>& Words = CellActor.GetState().DepletedWords;
+	if (Words.Num() != Cell.AppliedWords.Num())
+	{
+		UE_LOG(LogHarvest, Warning, TEXT("Harvest cell %s has %d instances here but %d on the server"),
+		       *Cell.Coord.ToString(), Cell.Instances.Num(), Words.Num() * 32);
+	}
+
+	for (int32 Word = 0; Word < FMath::Min(Words.Num(), Cell.AppliedWords.Num()); ++Word)
+	{
+		for (uint32 Changed = Words[Word] ^ Cell.AppliedWords[Word]; Changed; Changed &= Changed - 1)
+		{
+			const int32 Bit = FMath::CountTrailingZeros(Changed);
+			if (!Cell.Instances.IsValidIndex(Word * 32 + Bit))
+			{
+				continue;
+			}
+
+			// A respawned instance stays hidden behind its proxy
+			const FInstanceKey& Instance = Cell.Instances[Word * 32 + Bit];
+			const bool bDepleted = (Words[Word] & (1u << Bit)) != 0;
+			if (bDepleted && bPlayDestruction)
+			{
+				PlayInstanceDestruction(Instance);
+			}
+			if (bDepleted || !Proxies.Contains(Instance))
+			{
+				SetInstanceHidden(Instance, bDepleted);
+			}
+		}
+		Cell.AppliedWords[Word] = Words[Word];
+	}
+}
+
+float UHarvestSubsystem::GetInstanceHealthFraction(const UPrimitiveComponent* Component, int32 InstanceIndex) const
+{
+	const int32* MeshIndex = InstancedMeshIndices.Find(Component);
+	const FCellSlot* Slot = MeshIndex ? FindCellSlot(FInstanceKey(*MeshIndex, InstanceIndex)) : nullptr;
+	if (!Slot)
+	{
+		return 1.f;
+	}
+
+	const AHarvestCellActor* CellActor = Cells[Slot->Cell].Actor.Get();
+	return CellActor ? CellActor->GetHealthFraction(Slot->Instance) : 1.f;
+}
+
+bool UHarvestSubsystem::IsHarvestableInstance(const UPrimitiveComponent* Component, int32 InstanceIndex) const
+{
+	const int32* MeshIndex = InstancedMeshIndices.Find(Component);
+	return MeshIndex && InstanceIndex != INDEX_NONE && !HiddenInstances.Contains(FInstanceKey(*MeshIndex, InstanceIndex));
+}
+
+AActor* UHarvestSubsystem::PromoteHitInstance(const FHitResult& Hit)
+{
+	const int32* MeshIndex = InstancedMeshIndices.Find(Hit.GetComponent());
+	if (!MeshIndex)
+	{
+		AActor* HitActor = Hit.GetActor();
+		NotifyProxyActive(HitActor);
+		return HitActor;
+	}
+	return PromoteInstance(FInstanceKey(*MeshIndex, Hit.Item));
+}
+
+AActor* UHarvestSubsystem::PromoteInstance(const FInstanceKey& Instance)
+{
+	if (FProxy* Proxy = Proxies.Find(Instance))
+	{
+		Proxy->LastActiveTime = GetWorld()->GetTimeSeconds();
+		return Proxy->Actor.Get();
+	}
+
+	const UHierarchicalInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes.IsValidIndex(Instance.X)
+		                                                                 ? InstancedMeshes[Instance.X].Component.Get()
+		                                                                 : nullptr;
+	FTransform InstanceTransform;
+	if (!InstancedMesh || IsInstanceDepleted(Instance)
+		|| !InstancedMesh->GetInstanceTransform(Instance.Y, InstanceTransform, true))
+	{
+		return nullptr;
+	}
+
+	// Placed so its mesh lands exactly where the instance was
+	const FHarvestableType& Type = Types[InstancedMeshes[Instance.X].TypeId];
+	const FTransform ProxyTransform = Type.MeshTransform.Inverse() * InstanceTransform;
+	AActor* Proxy = GetWorld()->SpawnActorDeferred<AActor>(Type.HarvestClass, ProxyTransform, nullptr, nullptr,
+	                                                       ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Proxy)
+	{
+		return nullptr;
+	}
+
+	// Known before FinishSpawning so the spawn handler doesn't go looking for its instance
+	AddProxy(Proxy, Instance);
+	Proxy->FinishSpawning(ProxyTransform);
+
+	// After BeginPlay, which starts it at full health. The cell keeps the health until the proxy is
+	// turned back or depleted, either of which overwrites it.
+	const FCellSlot* Slot = FindCellSlot(Instance);
+	const AHarvestCellActor* CellActor = Slot ? Cells[Slot->Cell].Actor.Get() : nullptr;
+	const float HealthFraction = CellActor ? CellActor->GetHealthFraction(Slot->Instance) : 1.f;
+	if (HealthFraction < 1.f && Type.HealthField)
+	{
+		DataTableFields::SetFloat(Type.HealthField, Proxy, HealthFraction * Type.FullHealth);
+	}
+	return Proxy;
+}
+
+void UHarvestSubsystem::AddProxy(AActor* Proxy, const FInstanceKey& Instance)
+{
+	Proxies.Add(Instance, {Proxy, GetWorld()->GetTimeSeconds()});
+	ProxyInstances.Add(Proxy, Instance);
+	Proxy->OnEndPlay.AddDynamic(this, &UHarvestSubsystem::HandleProxyEndPlay);
+	SetInstanceHidden(Instance, true);
+}
+
+void UHarvestSubsystem::NotifyProxyActive(AActor* Proxy)
+{
+	if (const FInstanceKey* Instance = ProxyInstances.Find(Proxy))
+	{
+		Proxies[*Instance].LastActiveTime = GetWorld()->GetTimeSeconds();
+	}
+}
+
+void UHarvestSubsystem::HandleActorSpawned(AActor* Actor)
+{
+	// Clients find the instance a replicated proxy stands in for by where its mesh is
+	const int32* TypeId = ClassTypes.Find(Actor->GetClass());
+	if (!TypeId || Actor->HasAuthority() || ProxyInstances.Contains(Actor))
+	{
+		return;
+	}
+
+	const FVector MeshLocation = (Types[*TypeId].MeshTransform * Actor->GetActorTransform()).GetLocation();
+	for (int32 MeshIndex = 0; MeshIndex < InstancedMeshes.Num(); ++MeshIndex)
+	{
+		const UHierarchicalInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[MeshIndex].Component.Get();
+		if (InstancedMeshes[MeshIndex].TypeId != *TypeId || !InstancedMesh)
+		{
+			continue;
+		}
+
+		for (const int32 InstanceIndex : InstancedMesh->GetInstancesOverlappingSphere(
+			     MeshLocation, ProxyMatchTolerance, true))
+		{
+			const FInstanceKey Instance(MeshIndex, InstanceIndex);
+			FTransform InstanceTransform;
+			if (!Proxies.Contains(Instance) && InstancedMesh->GetInstanceTransform(InstanceIndex, InstanceTransform, true)
+				&& FVector::DistSquared(InstanceTransform.GetLocation(), MeshLocation) <= FMath::Square(
+					ProxyMatchTolerance))
+			{
+				AddProxy(Actor, Instance);
+				return;
+			}
+		}
+	}
+}
+
+void UHarvestSubsystem::HandleProxyEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	FInstanceKey Instance;
+	if (!ProxyInstances.RemoveAndCopyValue(Actor, Instance))
+	{
+		return;
+	}
+	Proxies.Remove(Instance);
+
+	// Demoted proxies are taken out before they are destroyed, so a proxy ending here was harvested
+	// down on the server. Clients also see proxies leave relevancy, and keep the instance hidden
+	// when its depleted bit is set or, as the bit may come in a moment later, the proxy ran out of
+	// Health.
+	if (Actor->HasAuthority())
+	{
+		if (EndPlayReason == EEndPlayReason::Destroyed)
+		{
+			SetInstanceDepleted(Instance, true);
+		}
+		else
+		{
+			SetInstanceHidden(Instance, false);
+		}
+		return;
+	}
+
+	const FHarvestableType& Type = Types[InstancedMeshes[Instance.X].TypeId];
+	if (!IsInstanceDepleted(Instance) && DataTableFields::GetFloat(Type.HealthField, Actor, 1.0) > 0.0)
+	{
+		SetInstanceHidden(Instance, false);
+	}
+}
+
+void UHarvestSubsystem::DemoteIdleProxies()
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double IdleTime = CVarProxyIdleTime.GetValueOnGameThread();
+
+	TArray<FInstanceKey, TInlineAllocator<16>> Idle;
+	for (const TPair<FInstanceKey, FProxy>& Pair : Proxies)
+	{
+		const AActor* Proxy = Pair.Value.Actor.Get();
+		if (Proxy && !Proxy->IsActorBeingDestroyed() && Now - Pair.Value.LastActiveTime >= IdleTime)
+		{
+			Idle.Add(Pair.Key);
+		}
+	}
+
+	for (const FInstanceKey& Instance : Idle)
+	{
+		FProxy Proxy;
+		Proxies.RemoveAndCopyValue(Instance, Proxy);
+		AActor* Actor = Proxy.Actor.Get();
+		ProxyInstances.Remove(Actor);
+		Actor->OnEndPlay.RemoveDynamic(this, &UHarvestSubsystem::HandleProxyEndPlay);
+
+		// Cells are only spawned for instances actually left damaged
+		const FHarvestableType& Type = Types[InstancedMeshes[Instance.X].TypeId];
+		const FCellSlot* Slot = FindCellSlot(Instance);
+		const float HealthFraction = Type.FullHealth > 0.f
+			                             ? DataTableFields::GetFloat(Type.HealthField, Actor) / Type.FullHealth
+			                             : 1.f;
+		AHarvestCellActor* CellActor = Slot ? Cells[Slot->Cell].Actor.Get() : nullptr;
+		if (Slot && !CellActor && HealthFraction < 1.f)
+		{
+			CellActor = FindOrSpawnCellActor(Slot->Cell);
+		}
+		if (CellActor)
+		{
+			CellActor->SetPartialHealth(Slot->Instance, HealthFraction);
+		}
+		SetInstanceHidden(Instance, false);
+		Actor->Destroy();
+	}
+}
+
+void UHarvestSubsystem::SetInstanceHidden(const FInstanceKey& Instance, bool bHidden)
+{
+	UHierarchicalInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[Instance.X].Component.Get();
+	if (!InstancedMesh)
+	{
+		return;
+	}
+
+	if (bHidden)
+	{
+		FTransform Transform;
+		if (HiddenInstances.Contains(Instance) || !InstancedMesh->GetInstanceTransform(Instance.Y, Transform, true))
+		{
+			return;
+		}
+		HiddenInstances.Add(Instance, Transform);
+		Transform.SetScale3D(FVector(HiddenScale));
+		InstancedMesh->UpdateInstanceTransform(Instance.Y, Transform, true, true, true);
+	}
+	else
+	{
+		FTransform Transform;
+		if (HiddenInstances.RemoveAndCopyValue(Instance, Transform))
+		{
+			InstancedMesh->UpdateInstanceTransform(Instance.Y, Transform, true, true, true);
+		}
+	}
+}
+
+void UHarvestSubsystem::PlayInstanceDestruction(const FInstanceKey& Instance)
+{
+	const UHierarchicalInstancedStaticMeshComponent* InstancedMesh = InstancedMeshes[Instance.X].Component.Get();
+	UDestructionSubsystem* Destruction = GetWorld()->GetSubsystem<UDestructionSubsystem>();
+	const FHarvestableType& Type = Types[InstancedMeshes[Instance.X].TypeId];
+	if (!InstancedMesh || !Destruction || !Type.DestructClass)
+	{
+		return;
+	}
+
+	// Where the instance stood, hidden behind its proxy until now or not
+	FTransform InstanceTransform;
+	if (const FTransform* HiddenTransform = HiddenInstances.Find(Instance))
+	{
+		InstanceTransform = *HiddenTransform;
+	}
+	else if (!InstancedMesh->GetInstanceTransform(Instance.Y, InstanceTransform, true))
+	{
+		return;
+	}
+
+	// Nothing here knows where the hit came from, any side is as good
+	const float Angle = FMath::FRandRange(0.f, UE_TWO_PI);
+	Destruction->PlayDestruction(Type.DestructClass, Type.MeshTransform.Inverse() * InstanceTransform,
+	                             FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.f));
+}
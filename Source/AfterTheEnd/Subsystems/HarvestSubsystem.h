@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AfterTheEnd/Harvest/TimingWheel.h"
+#include "HarvestSubsystem.generated.h"
+
+class AHarvestCellActor;
+class UHierarchicalInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/*
+ * Harvestable resources placed as foliage instances instead of actors. Every instanced mesh in the
+ * world whose mesh is the mesh of one of the HarvestableClasses (BP_Palm01, BP_BeachRock01,
+ * BP_TropicalBush01, ...) is a resource, and an instance only becomes its BP_HarvestMaster actor
+ * while it is being harvested. The tool hit goes through PromoteHitInstance, which spawns the
+ * proxy in place of the instance and hides the instance. Proxies left alone for
+ * ate.Harvest.ProxyIdleTime seconds are turned back into their instance, keeping their Health.
+ * A proxy destroyed by harvesting leaves its instance depleted.
+ *
+ * What was harvested is kept per CellSize cell of the world, in an AHarvestCellActor holding a bit
+ * per depleted instance and the health of partly harvested ones. The server spawns one for every
+ * cell harvested in, and clients apply its bits to their instances as they arrive. Clients also
+ * hide an instance while the proxy standing in for it is relevant. An instance harvested down breaks
+ * into its node's destruct class through UDestructionSubsystem, on every machine it is applied on
+ * as a change rather than with the state of a cell that just became relevant.
+ *
+ * Depleted instances respawn RespawnTime seconds later, scheduled on one timing wheel for the
+ * whole world. The pending respawns are saved every ate.Harvest.RespawnSaveInterval seconds and
+ * when the world goes away, and loaded with the map, depleting their instances again.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UHarvestSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// Proxy for a hit resource instance, the hit actor itself if it wasn't an instance
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Harvesting)
+	AActor* PromoteHitInstance(const FHitResult& Hit);
+
+	// Keeps a proxy from being turned back into an instance for another ProxyIdleTime
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Harvesting)
+	void NotifyProxyActive(AActor* Proxy);
+
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	bool IsHarvestableInstance(const UPrimitiveComponent* Component, int32 InstanceIndex) const;
+
+	// Health left as a share of the full health, 0 once depleted
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	float GetInstanceHealthFraction(const UPrimitiveComponent* Component, int32 InstanceIndex) const;
+
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	int32 GetNumProxies() const { return Proxies.Num(); }
+
+	// Resource instance by (instanced mesh index, instance index)
+	using FInstanceKey = FIntPoint;
+
+	AActor* PromoteInstance(const FInstanceKey& Instance);
+
+	// Server, depletes an instance until it respawns or brings it back
+	void SetInstanceDepleted(const FInstanceKey& Instance, bool bDepleted);
+	bool IsInstanceDepleted(const FInstanceKey& Instance) const;
+
+	// Shows and hides instances for the bits of the cell that changed since it was last applied,
+	// breaking the newly depleted ones apart if bPlayDestruction
+	void ApplyCellState(AHarvestCellActor& CellActor, bool bPlayDestruction);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void CompileHarvestableTypes();
+	void RegisterInstancedMesh(UHierarchicalInstancedStaticMeshComponent* InstancedMesh);
+	void BuildCells();
+
+	AHarvestCellActor* FindOrSpawnCellActor(int32 CellIndex);
+
+	// True if the instance changed
+	bool SetCellInstanceDepleted(int32 CellIndex, int32 CellInstance, bool bDepleted, bool bPlayDestruction);
+
+	uint64 GetRespawnTick() const;
+	uint64 PackRespawn(int32 CellIndex, int32 CellInstance) const;
+	bool UnpackRespawn(uint64 Payload, int32& OutCellIndex, int32& OutCellInstance) const;
+
+	void AdvanceRespawns();
+
+	FString GetRespawnSavePath() const;
+	void LoadRespawns();
+	void SaveRespawns();
+
+	void HandleActorSpawned(AActor* Actor);
+
+	UFUNCTION()
+	void HandleProxyEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	void AddProxy(AActor* Proxy, const FInstanceKey& Instance);
+	void DemoteIdleProxies();
+
+	void SetInstanceHidden(const FInstanceKey& Instance, bool bHidden);
+	void PlayInstanceDestruction(const FInstanceKey& Instance);
+
+	UPROPERTY(Config)
+	TArray<TSoftClassPtr<AActor>> HarvestableClasses;
+
+	UPROPERTY(Config)
+	float CellSize = 5000.f;
+
+	// Seconds from depleting an instance to it growing back
+	UPROPERTY(Config)
+	float RespawnTime = 1800.f;
+
+	struct FHarvestableType
+	{
+		TSubclassOf<AActor> HarvestClass;
+		UStaticMesh* Mesh = nullptr;
+
+		// Of the mesh component, relative to the actor
+		FTransform MeshTransform;
+
+		const FProperty* HealthField = nullptr;
+		float FullHealth = 0.f;
+
+		// What it breaks into once depleted, from its harvest node
+		TSubclassOf<AActor> DestructClass;
+	};
+
+	TArray<FHarvestableType> Types;
+	TMap<TObjectKey<UStaticMesh>, int32> MeshTypes;
+	TMap<TObjectKey<UClass>, int32> ClassTypes;
+
+	// Keeps the harvestable classes and their meshes loaded
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UClass>> LoadedClasses;
+
+	struct FInstancedMesh
+	{
+		TWeakObjectPtr<UHierarchicalInstancedStaticMeshComponent> Component;
+		int32 TypeId;
+	};
+
+	TArray<FInstancedMesh> InstancedMeshes;
+	TMap<TObjectKey<UPrimitiveComponent>, int32> InstancedMeshIndices;
+
+	struct FProxy
+	{
+		TWeakObjectPtr<AActor> Actor;
+		double LastActiveTime;
+	};
+
+	TMap<FInstanceKey, FProxy> Proxies;
+	TMap<TObjectKey<AActor>, FInstanceKey> ProxyInstances;
+
+	// Original transforms of hidden instances
+	TMap<FInstanceKey, FTransform> HiddenInstances;
+
+	struct FHarvestCell
+	{
+		FIntPoint Coord;
+		FVector Center;
+
+		// Sorted by type and location, the same on server and clients, the cell's state numbers
+		// instances by their index here
+		TArray<FInstanceKey> Instances;
+
+		TWeakObjectPtr<AHarvestCellActor> Actor;
+
+		// Depleted bits already shown on the instances
+		TArray<uint32> AppliedWords;
+	};
+
+	TArray<FHarvestCell> Cells;
+	TMap<FIntPoint, int32> CellIndices;
+
+	struct FCellSlot
+	{
+		int32 Cell = INDEX_NONE;
+		int32 Instance = INDEX_NONE;
+	};
+
+	// Cell and number in it of every instance, by instanced mesh index and instance index
+	TArray<TArray<FCellSlot>> InstanceSlots;
+
+	const FCellSlot* FindCellSlot(const FInstanceKey& Instance) const;
+
+	// Server, respawns by cell coordinates and number in the cell, due at whole seconds of world time
+	FTimingWheel Respawns;
+	bool bRespawnsLoaded = false;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FTimerHandle DemoteTimer;
+	FTimerHandle RespawnTimer;
+	FTimerHandle RespawnSaveTimer;
+};
@@ -0,0 +1,248 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HarvestYieldSubsystem.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Engine/DataTable.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogHarvestYield, Log, All);
+
+namespace
+{
+	struct FAliasSlot
+	{
+		float Probability;
+		int32 Alias;
+	};
+
+	// Vose's alias method, weights have to sum to more than 0
+	void BuildAliasTable(TConstArrayView<float> Weights, TArrayView<FAliasSlot> OutSlots)
+	{
+		const int32 Num = Weights.Num();
+		float Sum = 0.f;
+		for (const float Weight : Weights)
+		{
+			Sum += Weight;
+		}
+
+		TArray<float, TInlineAllocator<8>> Scaled;
+		TArray<int32, TInlineAllocator<8>> Small, Large;
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Scaled.Add(Weights[Index] * Num / Sum);
+			(Scaled[Index] < 1.f ? Small : Large).Add(Index);
+		}
+
+		while (Small.Num() > 0 && Large.Num() > 0)
+		{
+			const int32 Less = Small.Pop(false);
+			const int32 More = Large.Pop(false);
+			OutSlots[Less] = {Scaled[Less], More};
+			Scaled[More] += Scaled[Less] - 1.f;
+			(Scaled[More] < 1.f ? Small : Large).Add(More);
+		}
+
+		// Whatever is left is 1 give or take rounding
+		for (const int32 Index : Small)
+		{
+			OutSlots[Index] = {1.f, Index};
+		}
+		for (const int32 Index : Large)
+		{
+			OutSlots[Index] = {1.f, Index};
+		}
+	}
+}
+
+void UHarvestYieldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Collection.InitializeDependency<UItemRegistrySubsystem>();
+	CompileResourceTables();
+}
+
+UHarvestYieldSubsystem* UHarvestYieldSubsystem::Get(const UWorld* World)
+{
+	return World ? UGameInstance::GetSubsystem<UHarvestYieldSubsystem>(World->GetGameInstance()) : nullptr;
+}
+
+void UHarvestYieldSubsystem::CompileResourceTables()
+{
+	Nodes.Reset();
+	NodeIds.Reset();
+	Entries.Reset();
+	Outcomes.Reset();
+	LoadedTables.Reset();
+
+	float TierYield[ToolTierCount], TierDamage[ToolTierCount];
+	for (int32 Tier = 0; Tier < ToolTierCount; ++Tier)
+	{
+		TierYield[Tier] = TierDamage[Tier] = 1.f;
+	}
+	for (const FHarvestToolTierScale& Scale : ToolTierScales)
+	{
+		if (Scale.ToolTier < EToolTier::MAX)
+		{
+			TierYield[static_cast<int32>(Scale.ToolTier)] = FMath::Max(Scale.Yield, 0.f);
+			TierDamage[static_cast<int32>(Scale.ToolTier)] = FMath::Max(Scale.Damage, 0.f);
+		}
+	}
+
+	const UItemRegistrySubsystem* ItemRegistry = GetGameInstance()->GetSubsystem<UItemRegistrySubsystem>();
+	for (const TSoftObjectPtr<UDataTable>& SoftTable : ResourceTables)
+	{
+		UDataTable* Table = SoftTable.LoadSynchronous();
+		if (!Table)
+		{
+			UE_LOG(LogHarvestYield, Warning, TEXT("Resource table %s could not be loaded"), *SoftTable.ToString());
+			continue;
+		}
+		LoadedTables.Add(Table);
+
+		// S_LargeItem, with GivenItems of S_ResourceStructure
+		const UStruct* RowStruct = Table->GetRowStruct();
+		const FProperty* ClassField = DataTableFields::FindField(RowStruct, TEXT("Class"));
+		const FProperty* GivenItemsField = DataTableFields::FindField(RowStruct, TEXT("GivenItems"));
+
+		for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+		{
+			if (NodeIds.Contains(Row.Key))
+			{
+				UE_LOG(LogHarvestYield, Warning, TEXT("%s has a row %s another resource table already has"),
+				       *Table->GetName(), *Row.Key.ToString());
+				continue;
+			}
+
+			struct FGivenItem
+			{
+				FName Resource;
+				int32 Quantity;
+				uint8 PreferredToolType;
+			};
+			TArray<FGivenItem, TInlineAllocator<4>> GivenItems;
+			DataTableFields::ForEachStruct(GivenItemsField, Row.Value,
+			                               [&GivenItems](const UStruct* ElementStruct, const void* Element)
+			{
+				const FProperty* ResourceField = DataTableFields::FindField(ElementStruct, TEXT("ResourceName"));
+				const FProperty* QuantityField = DataTableFields::FindField(ElementStruct, TEXT("Quantity"));
+				const FProperty* ToolTypeField = DataTableFields::FindField(ElementStruct, TEXT("PrefferedToolType"));
+
+				const int32 Quantity = static_cast<int32>(DataTableFields::GetInt(QuantityField, Element));
+				if (Quantity > 0)
+				{
+					GivenItems.Add({
+						DataTableFields::GetName(ResourceField, Element), Quantity,
+						static_cast<uint8>(DataTableFields::GetInt(ToolTypeField, Element))
+					});
+				}
+			});
+
+			const int32 NodeId = Nodes.Add({Row.Key, Cast<UClass>(DataTableFields::GetObject(ClassField, Row.Value))});
+			NodeIds.Add(Row.Key, NodeId);
+
+			for (int32 ToolType = 0; ToolType < HarvestToolTypeCount; ++ToolType)
+			{
+				// Hits as hard as its tier for a node any of whose resources prefer it
+				bool bPreferred = false;
+				for (const FGivenItem& GivenItem : GivenItems)
+				{
+					bPreferred |= GivenItem.PreferredToolType == ToolType;
+				}
+
+				for (int32 Tier = 0; Tier < ToolTierCount; ++Tier)
+				{
+					FYieldEntry& Entry = Entries.AddDefaulted_GetRef();
+					Entry.Damage = TierDamage[Tier] * (bPreferred ? 1.f : OtherToolDamage);
+
+					TArray<float, TInlineAllocator<4>> Weights;
+					float TotalWeight = 0.f;
+					for (const FGivenItem& GivenItem : GivenItems)
+					{
+						const float ToolYield = GivenItem.PreferredToolType == ToolType ? 1.f : OtherToolYield;
+						Weights.Add(GivenItem.Quantity * ToolYield * TierYield[Tier]);
+						TotalWeight += Weights.Last();
+					}
+
+					Entry.Amount = FMath::RoundToInt(TotalWeight);
+					if (Entry.Amount <= 0)
+					{
+						continue;
+					}
+
+					TArray<FAliasSlot, TInlineAllocator<4>> Slots;
+					Slots.SetNumUninitialized(Weights.Num());
+					BuildAliasTable(Weights, Slots);
+					Entry.FirstOutcome = Outcomes.Num();
+					Entry.NumOutcomes = Slots.Num();
+					for (int32 Index = 0; Index < Entry.NumOutcomes; ++Index)
+					{
+						FYieldOutcome& Outcome = Outcomes.AddDefaulted_GetRef();
+						Outcome.Resource = GivenItems[Index].Resource;
+						Outcome.Item = ItemRegistry ? ItemRegistry->FindItemId(Outcome.Resource) : InvalidItemId;
+						Outcome.Probability = Slots[Index].Probability;
+						Outcome.Alias = Slots[Index].Alias;
+					}
+				}
+			}
+		}
+	}
+
+	UE_LOG(LogHarvestYield, Log, TEXT("Compiled %d harvest nodes into %d yield entries"), Nodes.Num(),
+	       Entries.Num());
+}
+
+int32 UHarvestYieldSubsystem::FindNodeId(const UClass* HarvestClass) const
+{
+	for (const UClass* Class = HarvestClass; Class; Class = Class->GetSuperClass())
+	{
+		if (const int32* NodeId = NodeIds.Find(Class->GetFName()))
+		{
+			return *NodeId;
+		}
+	}
+	return INDEX_NONE;
+}
+
+int32 UHarvestYieldSubsystem::GetHarvestNodeId(const AActor* Harvestable) const
+{
+	return Harvestable ? FindNodeId(Harvestable->GetClass()) : INDEX_NONE;
+}
+
+bool UHarvestYieldSubsystem::RollYield(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier, float Random,
+                                       FHarvestYield& OutYield) const
+{
+	const int32 EntryIndex = GetEntryIndex(NodeId, ToolType, ToolTier);
+	if (EntryIndex == INDEX_NONE || Entries[EntryIndex].NumOutcomes == 0)
+	{
+		return false;
+	}
+
+	// The integer part of the scaled roll picks a slot, the fraction decides between it and its alias
+	const FYieldEntry& Entry = Entries[EntryIndex];
+	const float Scaled = FMath::Clamp(Random, 0.f, 0.99999f) * Entry.NumOutcomes;
+	const int32 Slot = FMath::FloorToInt(Scaled);
+	const FYieldOutcome& SlotOutcome = Outcomes[Entry.FirstOutcome + Slot];
+	const FYieldOutcome& Outcome = Scaled - Slot < SlotOutcome.Probability
+		                               ? SlotOutcome
+		                               : Outcomes[Entry.FirstOutcome + SlotOutcome.Alias];
+
+	OutYield.Resource = Outcome.Resource;
+	OutYield.Item = Outcome.Item;
+	OutYield.Amount = Entry.Amount;
+	return true;
+}
+
+bool UHarvestYieldSubsystem::RollHarvestYield(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier,
+                                              FName& OutResource, int32& OutAmount, float& OutDamageMultiplier) const
+{
+	FHarvestYield Yield;
+	const bool bYielded = RollYield(NodeId, ToolType, ToolTier, FMath::FRand(), Yield);
+	OutResource = Yield.Resource;
+	OutAmount = Yield.Amount;
+	OutDamageMultiplier = GetDamageMultiplier(NodeId, ToolType, ToolTier);
+	return bYielded;
+}
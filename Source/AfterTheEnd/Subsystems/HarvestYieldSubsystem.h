@@ -0,0 +1,168 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "AfterTheEnd/Subsystems/ItemRegistrySubsystem.h"
+#include "HarvestYieldSubsystem.generated.h"
+
+class UDataTable;
+
+// Mirrors E_HarvestingToolType
+UENUM(BlueprintType)
+enum class EHarvestToolType : uint8
+{
+	Pickaxe,
+	Hatchet,
+	MAX UMETA(Hidden)
+};
+
+// Mirrors E_ToolTier
+UENUM(BlueprintType)
+enum class EToolTier : uint8
+{
+	Stone,
+	Iron,
+	MAX UMETA(Hidden)
+};
+
+constexpr int32 HarvestToolTypeCount = static_cast<int32>(EHarvestToolType::MAX);
+constexpr int32 ToolTierCount = static_cast<int32>(EToolTier::MAX);
+
+// What a tool tier gets out of a resource of its preferred tool type, and how hard it hits it
+USTRUCT()
+struct FHarvestToolTierScale
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	EToolTier ToolTier = EToolTier::Stone;
+
+	UPROPERTY(Config)
+	float Yield = 1.f;
+
+	UPROPERTY(Config)
+	float Damage = 1.f;
+};
+
+// One roll of a hit
+struct FHarvestYield
+{
+	FName Resource;
+	FItemId Item = InvalidItemId;
+	int32 Amount = 0;
+};
+
+/*
+ * DT_LargetItemResources and DT_GroundResources compiled into a dense [harvest node x
+ * E_HarvestingToolType x E_ToolTier] table, a node being one row, BP_Palm01 or BP_TropicalBush02.
+ * Each entry holds the damage multiplier of a hit and an alias table over the row's GivenItems,
+ * weighted by their Quantity scaled for the tool, so a hit is one index and one random number.
+ *
+ * A hit yields one of the resources, picked by weight, in the amount of all of them together,
+ * which grants every resource its scaled Quantity per hit on average.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UHarvestYieldSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static UHarvestYieldSubsystem* Get(const UWorld* World);
+
+	// Node of a harvestable class or its closest parent with a row, INDEX_NONE without one
+	int32 FindNodeId(const UClass* HarvestClass) const;
+
+	bool IsValidNode(int32 NodeId) const { return Nodes.IsValidIndex(NodeId); }
+
+	// S_LargeItem's Class, what the node breaks into once harvested
+	TSubclassOf<AActor> GetDestructClass(int32 NodeId) const
+	{
+		return IsValidNode(NodeId) ? Nodes[NodeId].DestructClass : nullptr;
+	}
+
+	float GetDamageMultiplier(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier) const
+	{
+		const int32 Entry = GetEntryIndex(NodeId, ToolType, ToolTier);
+		return Entry != INDEX_NONE ? Entries[Entry].Damage : 0.f;
+	}
+
+	// Random in [0, 1), false if the tool gets nothing out of the node
+	bool RollYield(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier, float Random,
+	               FHarvestYield& OutYield) const;
+
+	int32 GetNumNodes() const { return Nodes.Num(); }
+
+	UFUNCTION(BlueprintPure, Category=Harvesting)
+	int32 GetHarvestNodeId(const AActor* Harvestable) const;
+
+	// For the tools' HarvestFoliage in place of looking up the row and looping over GivenItems
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Harvesting)
+	bool RollHarvestYield(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier, FName& OutResource,
+	                      int32& OutAmount, float& OutDamageMultiplier) const;
+
+protected:
+	void CompileResourceTables();
+
+	int32 GetEntryIndex(int32 NodeId, EHarvestToolType ToolType, EToolTier ToolTier) const
+	{
+		const int32 ToolTypeIndex = static_cast<int32>(ToolType);
+		const int32 ToolTierIndex = static_cast<int32>(ToolTier);
+		if (!IsValidNode(NodeId) || ToolTypeIndex >= HarvestToolTypeCount || ToolTierIndex >= ToolTierCount)
+		{
+			return INDEX_NONE;
+		}
+		return (NodeId * HarvestToolTypeCount + ToolTypeIndex) * ToolTierCount + ToolTierIndex;
+	}
+
+	UPROPERTY(Config)
+	TArray<TSoftObjectPtr<UDataTable>> ResourceTables;
+
+	UPROPERTY(Config)
+	TArray<FHarvestToolTierScale> ToolTierScales;
+
+	// Share of the yield and damage a tool gets out of a resource that prefers the other tool type
+	UPROPERTY(Config)
+	float OtherToolYield = 0.25f;
+
+	UPROPERTY(Config)
+	float OtherToolDamage = 0.5f;
+
+	// Keeps the tables, and the destruct classes they reference, loaded
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UDataTable>> LoadedTables;
+
+	struct FHarvestNode
+	{
+		FName RowName;
+		TSubclassOf<AActor> DestructClass;
+	};
+
+	TArray<FHarvestNode> Nodes;
+	TMap<FName, int32> NodeIds;
+
+	struct FYieldEntry
+	{
+		float Damage = 0.f;
+		int32 Amount = 0;
+		int32 FirstOutcome = 0;
+		int32 NumOutcomes = 0;
+	};
+
+	// Indexed by GetEntryIndex
+	TArray<FYieldEntry> Entries;
+
+	// Alias tables of all entries, an entry's outcomes are consecutive
+	struct FYieldOutcome
+	{
+		FName Resource;
+		FItemId Item = InvalidItemId;
+		float Probability = 1.f;
+		int32 Alias = 0;
+	};
+
+	TArray<FYieldOutcome> Outcomes;
+};
@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InteractionFocusSubsystem.h"
+#include "InteractionSubsystem.h"
+#include "AfterTheEnd/Character/BaseCharacter.h"
+#include "AfterTheEnd/Components/InteractionComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarInteractionFocusRate(
+	TEXT("ate.Interaction.FocusRate"),
+	10.f,
+	TEXT("Interaction focus traces per second for each local player"));
+
+bool UInteractionFocusSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	// Focus only matters to players looking through a viewport
+	return !IsRunningDedicatedServer() && Super::ShouldCreateSubsystem(Outer);
+}
+
+bool UInteractionFocusSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UInteractionFocusSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UInteractionFocusSubsystem, STATGROUP_Tickables);
+}
+
+void UInteractionFocusSubsystem::Tick(float DeltaTime)
+{
+	const float FocusRate = CVarInteractionFocusRate.GetValueOnGameThread();
+	TimeSinceLastTrace += DeltaTime;
+	if (FocusRate <= 0.f || TimeSinceLastTrace < 1.f / FocusRate)
+	{
+		return;
+	}
+	TimeSinceLastTrace = 0.f;
+
+	FocusStates.RemoveAllSwap([](const FFocusState& State) { return !State.PlayerController.IsValid(); });
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (!PlayerController || !PlayerController->IsLocalController())
+		{
+			continue;
+		}
+
+		FFocusState* State = FocusStates.FindByPredicate([PlayerController](const FFocusState& Existing)
+		{
+			return Existing.PlayerController == PlayerController;
+		});
+		if (!State)
+		{
+			State = &FocusStates.AddDefaulted_GetRef();
+			State->PlayerController = PlayerController;
+		}
+
+		// Previous result hasn't come back yet, don't stack traces
+		if (State->PendingTrace.IsValid())
+		{
+			continue;
+		}
+
+		StartFocusTrace(*State);
+	}
+}
+
+UInteractionComponent* UInteractionFocusSubsystem::GetFocusedInteractable(
+	const APlayerController* PlayerController) const
+{
+	const FFocusState* State = FocusStates.FindByPredicate([PlayerController](const FFocusState& Existing)
+	{
+		return Existing.PlayerController == PlayerController;
+	});
+	return State ? State->Focused.Get() : nullptr;
+}
+
+void UInteractionFocusSubsystem::StartFocusTrace(FFocusState& State)
+{
+	const ABaseCharacter* Character = Cast<ABaseCharacter>(State.PlayerController->GetPawn());
+	if (!Character)
+	{
+		SetFocus(State, nullptr);
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	State.PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	const FVector TraceEnd = ViewLocation + ViewRotation.Vector() * Character->GetInteractionDistance();
+
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(InteractionFocus), false, Character);
+	const FTraceDelegate TraceDelegate = FTraceDelegate::CreateUObject(this,
+	                                                                   &UInteractionFocusSubsystem::OnFocusTraceDone);
+
+	State.PendingTrace = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, ViewLocation, TraceEnd,
+	                                                         ECC_Visibility, QueryParams,
+	                                                         FCollisionResponseParams::DefaultResponseParam,
+	                                                         &TraceDelegate);
+}
+
+void UInteractionFocusSubsystem::OnFocusTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	FFocusState* State = FocusStates.FindByPredicate([&TraceHandle](const FFocusState& Existing)
+	{
+		return Existing.PendingTrace == TraceHandle;
+	});
+	if (!State)
+	{
+		return;
+	}
+	State->PendingTrace = FTraceHandle();
+
+	UInteractionComponent* NewFocus = nullptr;
+	if (TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit)
+	{
+		if (const UInteractionSubsystem* InteractionSubsystem = GetWorld()->GetSubsystem<UInteractionSubsystem>())
+		{
+			NewFocus = InteractionSubsystem->FindInteractableForActor(TraceDatum.OutHits[0].GetActor());
+		}
+	}
+
+	SetFocus(*State, NewFocus);
+}
+
+void UInteractionFocusSubsystem::SetFocus(FFocusState& State, UInteractionComponent* NewFocus)
+{
+	UInteractionComponent* PreviousFocus = State.Focused.Get();
+	// A stale pointer means the focused interactable was destroyed, the prompt still has to be cleared
+	if (PreviousFocus == NewFocus && !State.Focused.IsStale())
+	{
+		return;
+	}
+
+	State.Focused = NewFocus;
+
+	APlayerController* PlayerController = State.PlayerController.Get();
+	AActor* Instigator = PlayerController ? PlayerController->GetPawn() : nullptr;
+
+	if (PreviousFocus)
+	{
+		PreviousFocus->NotifyFocusLost(Instigator);
+	}
+	if (NewFocus)
+	{
+		NewFocus->NotifyFocusGained(Instigator);
+	}
+
+	OnFocusChanged.Broadcast(PlayerController, PreviousFocus, NewFocus);
+}
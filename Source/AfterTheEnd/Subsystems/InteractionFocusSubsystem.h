@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InteractionFocusSubsystem.generated.h"
+
+class APlayerController;
+class UInteractionComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnInteractionFocusChanged, APlayerController*, PlayerController,
+                                               UInteractionComponent*, PreviousFocus, UInteractionComponent*, NewFocus);
+
+/*
+ * Replaces per-interactable ticking. Every local player gets one async view trace at
+ * ate.Interaction.FocusRate, and focus events only fire when the traced interactable changes.
+ */
+UCLASS()
+class AFTERTHEEND_API UInteractionFocusSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	UFUNCTION(BlueprintPure, Category=Interaction)
+	UInteractionComponent* GetFocusedInteractable(const APlayerController* PlayerController) const;
+
+	// Drives the hover prompt, fires only when a local player's focus changes
+	UPROPERTY(BlueprintAssignable)
+	FOnInteractionFocusChanged OnFocusChanged;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	struct FFocusState
+	{
+		TWeakObjectPtr<APlayerController> PlayerController;
+		TWeakObjectPtr<UInteractionComponent> Focused;
+		FTraceHandle PendingTrace;
+	};
+
+	void StartFocusTrace(FFocusState& State);
+	void OnFocusTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+	void SetFocus(FFocusState& State, UInteractionComponent* NewFocus);
+
+	TArray<FFocusState> FocusStates;
+
+	float TimeSinceLastTrace = 0.f;
+};
@@ -0,0 +1,286 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InteractionSubsystem.h"
+#include "AfterTheEnd/Components/InteractionComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogInteraction, Log, All);
+
+FInteractionGrid::FInteractionGrid(float InCellSize)
+	: CellSize(InCellSize)
+{
+}
+
+FIntVector FInteractionGrid::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize),
+	                  FMath::FloorToInt(Location.Z / CellSize));
+}
+
+int32 FInteractionGrid::Add(const FVector& Location, float Radius, UInteractionComponent* Component)
+{
+	const FIntVector Cell = GetCell(Location);
+	const int32 Handle = Entries.Add({Location, Radius, Cell, Component});
+	MaxRadius = FMath::Max(MaxRadius, Radius);
+	Cells.FindOrAdd(Cell).Add(Handle);
+	return Handle;
+}
+
+void FInteractionGrid::Remove(int32 Handle)
+{
+	if (!Entries.IsValidIndex(Handle))
+	{
+		return;
+	}
+
+	const FIntVector Cell = Entries[Handle].Cell;
+	if (TArray<int32>* CellEntries = Cells.Find(Cell))
+	{
+		CellEntries->RemoveSingleSwap(Handle, false);
+		if (CellEntries->IsEmpty())
+		{
+			Cells.Remove(Cell);
+		}
+	}
+	Entries.RemoveAt(Handle);
+}
+
+void FInteractionGrid::Move(int32 Handle, const FVector& NewLocation)
+{
+	if (!Entries.IsValidIndex(Handle))
+	{
+		return;
+	}
+
+	FEntry& Entry = Entries[Handle];
+	Entry.Location = NewLocation;
+
+	const FIntVector NewCell = GetCell(NewLocation);
+	if (NewCell == Entry.Cell)
+	{
+		return;
+	}
+
+	if (TArray<int32>* CellEntries = Cells.Find(Entry.Cell))
+	{
+		CellEntries->RemoveSingleSwap(Handle, false);
+		if (CellEntries->IsEmpty())
+		{
+			Cells.Remove(Entry.Cell);
+		}
+	}
+	Entry.Cell = NewCell;
+	Cells.FindOrAdd(NewCell).Add(Handle);
+}
+
+int32 FInteractionGrid::FindBest(const FVector& ViewLocation, const FVector& ViewDirection, float MaxDistance,
+                                 float CosMaxAngle) const
+{
+	const float SearchDistance = MaxDistance + MaxRadius;
+	const FIntVector MinCell = GetCell(ViewLocation - FVector(SearchDistance));
+	const FIntVector MaxCell = GetCell(ViewLocation + FVector(SearchDistance));
+
+	// Ranked by how far the sphere is off the view axis, then by its center for spheres the axis
+	// passes through, e.g. an item lying on a crate
+	int32 BestHandle = INDEX_NONE;
+	float BestEdgeDot = CosMaxAngle;
+	float BestDot = -1.f;
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+			{
+				const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellEntries)
+				{
+					continue;
+				}
+
+				for (const int32 Handle : *CellEntries)
+				{
+					const FEntry& Entry = Entries[Handle];
+					const FVector ToEntry = Entry.Location - ViewLocation;
+					const float Distance = ToEntry.Size();
+					if (Distance - Entry.Radius > MaxDistance)
+					{
+						continue;
+					}
+
+					const float Dot = Distance < KINDA_SMALL_NUMBER
+						                  ? 1.f
+						                  : FVector::DotProduct(ToEntry / Distance, ViewDirection);
+
+					// Cosine of the angle between the view axis and the nearest edge of the sphere, 1 when
+					// the axis passes through it
+					float EdgeDot = 1.f;
+					if (Distance > Entry.Radius)
+					{
+						const float SinRadius = Entry.Radius / Distance;
+						const float CosRadius = FMath::Sqrt(1.f - SinRadius * SinRadius);
+						EdgeDot = Dot >= CosRadius
+							          ? 1.f
+							          : Dot * CosRadius + FMath::Sqrt(FMath::Max(1.f - Dot * Dot, 0.f)) * SinRadius;
+					}
+
+					if (EdgeDot > BestEdgeDot || (EdgeDot == BestEdgeDot && BestHandle != INDEX_NONE && Dot > BestDot))
+					{
+						BestEdgeDot = EdgeDot;
+						BestDot = Dot;
+						BestHandle = Handle;
+					}
+				}
+			}
+		}
+	}
+
+	return BestHandle;
+}
+
+UInteractionComponent* FInteractionGrid::Get(int32 Handle) const
+{
+	return Entries.IsValidIndex(Handle) ? Entries[Handle].Component.Get() : nullptr;
+}
+
+FVector FInteractionGrid::GetLocation(int32 Handle) const
+{
+	return Entries.IsValidIndex(Handle) ? Entries[Handle].Location : FVector::ZeroVector;
+}
+
+float FInteractionGrid::GetRadius(int32 Handle) const
+{
+	return Entries.IsValidIndex(Handle) ? Entries[Handle].Radius : 0.f;
+}
+
+int32 UInteractionSubsystem::RegisterInteractable(UInteractionComponent* Component)
+{
+	float Radius;
+	const FVector Location = GetInteractableLocation(Component, &Radius);
+	const int32 Handle = Grid.Add(Location, Radius, Component);
+	ActorHandles.Add(Component->GetOwner(), Handle);
+	return Handle;
+}
+
+void UInteractionSubsystem::UnregisterInteractable(int32 Handle)
+{
+	if (const UInteractionComponent* Component = Grid.Get(Handle))
+	{
+		ActorHandles.RemoveSingle(Component->GetOwner(), Handle);
+	}
+	Grid.Remove(Handle);
+}
+
+void UInteractionSubsystem::UpdateInteractable(int32 Handle, const FVector& NewLocation)
+{
+	Grid.Move(Handle, NewLocation);
+}
+
+UInteractionComponent* UInteractionSubsystem::FindBestInteractable(const FVector& ViewLocation,
+                                                                   const FVector& ViewDirection, float MaxDistance,
+                                                                   float MaxAngleDegrees) const
+{
+	const float CosMaxAngle = FMath::Cos(FMath::DegreesToRadians(MaxAngleDegrees));
+	return Grid.Get(Grid.FindBest(ViewLocation, ViewDirection.GetSafeNormal(), MaxDistance, CosMaxAngle));
+}
+
+UInteractionComponent* UInteractionSubsystem::FindInteractableForActor(const AActor* Actor) const
+{
+	const int32* Handle = ActorHandles.Find(Actor);
+	return Handle ? Grid.Get(*Handle) : nullptr;
+}
+
+UInteractionComponent* UInteractionSubsystem::FindInteractable(const FInteractableHandle& Handle) const
+{
+	for (auto It = ActorHandles.CreateConstKeyIterator(Handle.Actor.Get()); It; ++It)
+	{
+		UInteractionComponent* Component = Grid.Get(It.Value());
+		if (Component && Component->InteractionId == Handle.InteractionId)
+		{
+			return Component;
+		}
+	}
+	return nullptr;
+}
+
+FVector UInteractionSubsystem::GetRegisteredLocation(const UInteractionComponent* Component) const
+{
+	return Grid.GetLocation(Component->GetRegistryHandle());
+}
+
+float UInteractionSubsystem::GetRegisteredRadius(const UInteractionComponent* Component) const
+{
+	return Grid.GetRadius(Component->GetRegistryHandle());
+}
+
+FVector UInteractionSubsystem::GetInteractableLocation(const UInteractionComponent* Component, float* OutRadius)
+{
+	const AActor* Owner = Component->GetOwner();
+	if (OutRadius)
+	{
+		*OutRadius = 0.f;
+	}
+	if (!Owner)
+	{
+		return FVector::ZeroVector;
+	}
+
+	// Bounds center rather than the pivot, harvestables are usually pivoted at ground level
+	FVector Origin;
+	FVector Extent;
+	Owner->GetActorBounds(true, Origin, Extent);
+	if (Extent.IsNearlyZero())
+	{
+		return Owner->GetActorLocation();
+	}
+
+	if (OutRadius)
+	{
+		*OutRadius = Extent.Size();
+	}
+	return Origin;
+}
+
+static void RunInteractionBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumEntries = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000;
+	const int32 NumQueries = 10000;
+	const float WorldExtent = 200000.f;
+
+	FRandomStream Stream(1337);
+	FInteractionGrid BenchmarkGrid;
+
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumEntries; ++Index)
+	{
+		const FVector Location(Stream.FRandRange(-WorldExtent, WorldExtent),
+		                       Stream.FRandRange(-WorldExtent, WorldExtent), Stream.FRandRange(0.f, 2000.f));
+		BenchmarkGrid.Add(Location, 0.f, nullptr);
+	}
+	const double InsertTime = FPlatformTime::Seconds() - StartTime;
+
+	const float CosMaxAngle = FMath::Cos(FMath::DegreesToRadians(15.f));
+	int32 NumHits = 0;
+
+	StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < NumQueries; ++Index)
+	{
+		const FVector ViewLocation(Stream.FRandRange(-WorldExtent, WorldExtent),
+		                           Stream.FRandRange(-WorldExtent, WorldExtent), Stream.FRandRange(0.f, 2000.f));
+		if (BenchmarkGrid.FindBest(ViewLocation, Stream.GetUnitVector(), 500.f, CosMaxAngle) != INDEX_NONE)
+		{
+			++NumHits;
+		}
+	}
+	const double QueryTime = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogInteraction, Display, TEXT("Interaction grid: %d entries inserted in %.2f ms, %d queries at %.3f us each (%d hits)"),
+	       NumEntries, InsertTime * 1000.0, NumQueries, QueryTime * 1000000.0 / NumQueries, NumHits);
+}
+
+static FAutoConsoleCommand InteractionBenchmarkCommand(
+	TEXT("ate.Interaction.Benchmark"),
+	TEXT("Fills a standalone interaction grid with N entries (default 100000) and times view cone queries"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunInteractionBenchmark));
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InteractionSubsystem.generated.h"
+
+class UInteractionComponent;
+struct FInteractableHandle;
+
+/*
+ * Uniform grid of interactable locations. Kept apart from the subsystem so it can be
+ * filled and queried without a world (see ate.Interaction.Benchmark).
+ */
+class AFTERTHEEND_API FInteractionGrid
+{
+public:
+	explicit FInteractionGrid(float InCellSize = 1000.f);
+
+	// Radius of a sphere around Location covering the interactable, so it can be found from its edge
+	int32 Add(const FVector& Location, float Radius, UInteractionComponent* Component);
+	void Remove(int32 Handle);
+	void Move(int32 Handle, const FVector& NewLocation);
+
+	// Returns the handle of the entry closest to the view axis whose sphere reaches into the cone, or INDEX_NONE
+	int32 FindBest(const FVector& ViewLocation, const FVector& ViewDirection, float MaxDistance,
+	               float CosMaxAngle) const;
+
+	UInteractionComponent* Get(int32 Handle) const;
+	FVector GetLocation(int32 Handle) const;
+	float GetRadius(int32 Handle) const;
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	struct FEntry
+	{
+		FVector Location;
+		float Radius;
+		FIntVector Cell;
+		TWeakObjectPtr<UInteractionComponent> Component;
+	};
+
+	FIntVector GetCell(const FVector& Location) const;
+
+	float CellSize;
+
+	// Largest radius ever added, how far past the view distance a query has to look
+	float MaxRadius = 0.f;
+	TSparseArray<FEntry> Entries;
+	TMap<FIntVector, TArray<int32>> Cells;
+};
+
+UCLASS()
+class AFTERTHEEND_API UInteractionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Called by UInteractionComponent on BeginPlay, returns the handle it keeps until EndPlay
+	int32 RegisterInteractable(UInteractionComponent* Component);
+	void UnregisterInteractable(int32 Handle);
+
+	// Re-buckets an interactable whose owner has moved since it registered
+	void UpdateInteractable(int32 Handle, const FVector& NewLocation);
+
+	// Best interactable in the view cone within MaxDistance, without touching any actor's components
+	UFUNCTION(BlueprintCallable, Category=Interaction)
+	UInteractionComponent* FindBestInteractable(const FVector& ViewLocation, const FVector& ViewDirection,
+	                                            float MaxDistance, float MaxAngleDegrees = 15.f) const;
+
+	// Interactable owned by Actor, resolved through the registry instead of the actor's component list
+	UFUNCTION(BlueprintCallable, Category=Interaction)
+	UInteractionComponent* FindInteractableForActor(const AActor* Actor) const;
+
+	// Resolves a handle received over the network
+	UInteractionComponent* FindInteractable(const FInteractableHandle& Handle) const;
+
+	// Location the interactable was registered at, avoids recomputing the owner's bounds
+	FVector GetRegisteredLocation(const UInteractionComponent* Component) const;
+	float GetRegisteredRadius(const UInteractionComponent* Component) const;
+
+	UFUNCTION(BlueprintPure, Category=Interaction)
+	int32 GetNumInteractables() const { return Grid.Num(); }
+
+	static FVector GetInteractableLocation(const UInteractionComponent* Component, float* OutRadius = nullptr);
+
+protected:
+	FInteractionGrid Grid;
+
+	TMultiMap<TObjectKey<AActor>, int32> ActorHandles;
+};
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemRegistrySubsystem.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Engine/DataTable.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Texture2D.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogItemRegistry, Log, All);
+
+void UItemRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CompileItemTable();
+}
+
+UItemRegistrySubsystem* UItemRegistrySubsystem::Get(const UWorld* World)
+{
+	return World ? UGameInstance::GetSubsystem<UItemRegistrySubsystem>(World->GetGameInstance()) : nullptr;
+}
+
+void UItemRegistrySubsystem::CompileItemTable()
+{
+	Definitions.Reset();
+	RowNameToId.Reset();
+	Definitions.AddDefaulted();
+
+	const UDataTable* Table = ItemTable.LoadSynchronous();
+	if (Table)
+	{
+		const UStruct* RowStruct = Table->GetRowStruct();
+		const FProperty* NameField = DataTableFields::FindField(RowStruct, TEXT("ItemName"));
+		const FProperty* DescField = DataTableFields::FindField(RowStruct, TEXT("ItemDesc"));
+		const FProperty* TypeField = DataTableFields::FindField(RowStruct, TEXT("ItemType"));
+		const FProperty* RarityField = DataTableFields::FindField(RowStruct, TEXT("ItemRarity"));
+		const FProperty* StackableField = DataTableFields::FindField(RowStruct, TEXT("IsStackable?"));
+		const FProperty* StackSizeField = DataTableFields::FindField(RowStruct, TEXT("StackSize"));
+		const FProperty* MaxHPField = DataTableFields::FindField(RowStruct, TEXT("ItemMaxHP"));
+		const FProperty* DamageField = DataTableFields::FindField(RowStruct, TEXT("ItemDamage"));
+		const FProperty* MaxAmmoField = DataTableFields::FindField(RowStruct, TEXT("MaxAmmo"));
+		const FProperty* IconField = DataTableFields::FindField(RowStruct, TEXT("ItemIcon"));
+		const FProperty* ClassField = DataTableFields::FindField(RowStruct, TEXT("ItemClass"));
+
+		const int32 NumRows = FMath::Min(Table->GetRowMap().Num(), static_cast<int32>(MAX_uint16));
+		if (Table->GetRowMap().Num() > NumRows)
+		{
+			UE_LOG(LogItemRegistry, Error, TEXT("%s has more rows than item ids, extra rows are ignored"),
+			       *Table->GetName());
+		}
+
+		Definitions.Reserve(NumRows + 1);
+		RowNameToId.Reserve(NumRows);
+		for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+		{
+			if (Definitions.Num() > NumRows)
+			{
+				break;
+			}
+
+			const FItemId ItemId = static_cast<FItemId>(Definitions.Num());
+			FItemDefinition& Definition = Definitions.AddDefaulted_GetRef();
+			Definition.RowName = Row.Key;
+			Definition.DisplayName = DataTableFields::GetText(NameField, Row.Value);
+			Definition.Description = DataTableFields::GetText(DescField, Row.Value);
+			Definition.Type = static_cast<EItemType>(FMath::Clamp<int64>(
+				DataTableFields::GetInt(TypeField, Row.Value), 0, ItemTypeCount - 1));
+			Definition.Rarity = static_cast<EItemRarity>(DataTableFields::GetInt(RarityField, Row.Value));
+			Definition.StackSize = DataTableFields::GetInt(StackableField, Row.Value)
+				                       ? FMath::Max(static_cast<int32>(DataTableFields::GetInt(StackSizeField, Row.Value)), 1)
+				                       : 1;
+			Definition.MaxHP = static_cast<int32>(DataTableFields::GetInt(MaxHPField, Row.Value));
+			Definition.Damage = static_cast<float>(DataTableFields::GetFloat(DamageField, Row.Value));
+			Definition.MaxAmmo = static_cast<int32>(DataTableFields::GetInt(MaxAmmoField, Row.Value));
+			Definition.Icon = Cast<UTexture2D>(DataTableFields::GetObject(IconField, Row.Value));
+			Definition.ItemClass = Cast<UClass>(DataTableFields::GetObject(ClassField, Row.Value));
+
+			RowNameToId.Add(Row.Key, ItemId);
+		}
+	}
+
+	for (TBitArray<>& Mask : TypeMasks)
+	{
+		Mask.Init(false, Definitions.Num());
+	}
+	for (int32 ItemId = 1; ItemId < Definitions.Num(); ++ItemId)
+	{
+		TypeMasks[static_cast<int32>(Definitions[ItemId].Type)][ItemId] = true;
+	}
+
+	UE_LOG(LogItemRegistry, Log, TEXT("Compiled %d items"), Definitions.Num() - 1);
+}
+
+bool UItemRegistrySubsystem::K2_GetItemDefinition(int32 ItemId, FItemDefinition& OutDefinition) const
+{
+	if (ItemId < 0 || ItemId > MAX_uint16)
+	{
+		return false;
+	}
+
+	if (const FItemDefinition* Definition = FindDefinition(static_cast<FItemId>(ItemId)))
+	{
+		OutDefinition = *Definition;
+		return true;
+	}
+	return false;
+}
+
+TArray<int32> UItemRegistrySubsystem::GetItemsOfType(EItemType Type) const
+{
+	TArray<int32> ItemIds;
+	for (TConstSetBitIterator<> It(GetTypeMask(Type)); It; ++It)
+	{
+		ItemIds.Add(It.GetIndex());
+	}
+	return ItemIds;
+}
@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "ItemRegistrySubsystem.generated.h"
+
+class UDataTable;
+class UTexture2D;
+
+// Mirrors E_ItemType
+UENUM(BlueprintType)
+enum class EItemType : uint8
+{
+	Resource,
+	Equipable,
+	Armor,
+	Consumable,
+	Buildable,
+	MAX UMETA(Hidden)
+};
+
+constexpr int32 ItemTypeCount = static_cast<int32>(EItemType::MAX);
+
+// Mirrors E_ItemRarity
+UENUM(BlueprintType)
+enum class EItemRarity : uint8
+{
+	Common,
+	Uncommon,
+	Rare,
+	Epic,
+	Legendary
+};
+
+// Compact item id, index into UItemRegistrySubsystem's definitions. Stable for a given DT_Items.
+using FItemId = uint16;
+
+constexpr FItemId InvalidItemId = 0;
+
+/*
+ * One DT_Items row, read once out of S_ItemInfo.
+ */
+USTRUCT(BlueprintType)
+struct FItemDefinition
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	FName RowName;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	FText DisplayName;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	FText Description;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	EItemType Type = EItemType::Resource;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	EItemRarity Rarity = EItemRarity::Common;
+
+	// 1 for items that don't stack
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	int32 StackSize = 1;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	int32 MaxHP = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	float Damage = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	int32 MaxAmmo = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	TObjectPtr<UTexture2D> Icon = nullptr;
+
+	UPROPERTY(BlueprintReadOnly, Category=Item)
+	TSubclassOf<AActor> ItemClass;
+};
+
+/*
+ * DT_Items compiled into a dense array indexed by FItemId, so item queries are array indexing
+ * instead of row name lookups. Id 0 is reserved for "no item". Per type bit masks answer
+ * "is this a consumable" and "all buildables" without touching the definitions.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UItemRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static UItemRegistrySubsystem* Get(const UWorld* World);
+
+	FItemId FindItemId(FName RowName) const
+	{
+		const FItemId* ItemId = RowNameToId.Find(RowName);
+		return ItemId ? *ItemId : InvalidItemId;
+	}
+
+	bool IsValidItem(FItemId ItemId) const { return ItemId != InvalidItemId && Definitions.IsValidIndex(ItemId); }
+
+	const FItemDefinition* FindDefinition(FItemId ItemId) const
+	{
+		return IsValidItem(ItemId) ? &Definitions[ItemId] : nullptr;
+	}
+
+	FName GetRowName(FItemId ItemId) const { return IsValidItem(ItemId) ? Definitions[ItemId].RowName : NAME_None; }
+
+	int32 GetStackSize(FItemId ItemId) const { return IsValidItem(ItemId) ? Definitions[ItemId].StackSize : 0; }
+
+	bool IsItemOfType(FItemId ItemId, EItemType Type) const
+	{
+		const TBitArray<>& Mask = TypeMasks[static_cast<int32>(Type)];
+		return ItemId < Mask.Num() && Mask[ItemId];
+	}
+
+	// Bit per item id
+	const TBitArray<>& GetTypeMask(EItemType Type) const { return TypeMasks[static_cast<int32>(Type)]; }
+
+	// Ids run from 1 to GetNumItems() - 1
+	int32 GetNumItems() const { return Definitions.Num(); }
+
+	UFUNCTION(BlueprintPure, Category=Items, meta=(DisplayName="Find Item Id"))
+	int32 K2_FindItemId(FName RowName) const { return FindItemId(RowName); }
+
+	UFUNCTION(BlueprintPure, Category=Items, meta=(DisplayName="Get Item Definition"))
+	bool K2_GetItemDefinition(int32 ItemId, FItemDefinition& OutDefinition) const;
+
+	UFUNCTION(BlueprintPure, Category=Items)
+	TArray<int32> GetItemsOfType(EItemType Type) const;
+
+protected:
+	void CompileItemTable();
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UDataTable> ItemTable;
+
+	// Indexed by FItemId, element 0 is an empty definition
+	UPROPERTY(Transient)
+	TArray<FItemDefinition> Definitions;
+
+	TMap<FName, FItemId> RowNameToId;
+
+	TStaticArray<TBitArray<>, ItemTypeCount> TypeMasks;
+};
@@ -0,0 +1,204 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MeleeCombatSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/DamageType.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+#include "Kismet/GameplayStatics.h"
+
+static TAutoConsoleVariable<float> CVarMeleeMaxRewind(
+	TEXT("ate.Melee.MaxRewind"),
+	0.25f,
+	TEXT("Furthest back in seconds the server rewinds hitboxes for a melee swing"));
+
+bool UMeleeCombatSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UMeleeCombatSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UMeleeCombatSubsystem, STATGROUP_Tickables);
+}
+
+double UMeleeCombatSubsystem::GetServerTime() const
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
+
+int32 UMeleeCombatSubsystem::RegisterTarget(UPrimitiveComponent* Hitbox)
+{
+	FHitboxHistory History;
+	History.Hitbox = Hitbox;
+	History.LocalBox = Hitbox->CalcLocalBounds().GetBox();
+	History.BoundingRadius = Hitbox->Bounds.SphereRadius;
+	return Histories.Add(MoveTemp(History));
+}
+
+void UMeleeCombatSubsystem::UnregisterTarget(int32 Handle)
+{
+	if (Histories.IsValidIndex(Handle))
+	{
+		Histories.RemoveAt(Handle);
+	}
+}
+
+void UMeleeCombatSubsystem::QueueSwing(const FMeleeSwing& Swing)
+{
+	PendingSwings.Add(Swing);
+}
+
+void UMeleeCombatSubsystem::Tick(float DeltaTime)
+{
+	if (Histories.Num() == 0)
+	{
+		PendingSwings.Reset();
+		return;
+	}
+
+	const double Now = GetServerTime();
+	RecordHistory(Now);
+
+	if (PendingSwings.Num() > 0)
+	{
+		ResolveSwings(Now);
+	}
+}
+
+void UMeleeCombatSubsystem::RecordHistory(double Now)
+{
+	if (Now <= LastRecordTime)
+	{
+		return;
+	}
+	LastRecordTime = Now;
+
+	for (FHitboxHistory& History : Histories)
+	{
+		const UPrimitiveComponent* Hitbox = History.Hitbox.Get();
+		if (!Hitbox)
+		{
+			continue;
+		}
+
+		History.Head = (History.Head + 1) % HistorySize;
+		History.Transforms[History.Head] = Hitbox->GetComponentTransform();
+		History.Times[History.Head] = Now;
+		History.Count = FMath::Min(History.Count + 1, HistorySize);
+	}
+}
+
+FTransform UMeleeCombatSubsystem::GetTransformAtTime(const FHitboxHistory& History, double Time) const
+{
+	// Walk back from the newest sample until we find the pair that brackets Time
+	int32 Newer = History.Head;
+	for (int32 Step = 1; Step < History.Count; ++Step)
+	{
+		const int32 Older = (History.Head - Step + HistorySize) % HistorySize;
+		if (History.Times[Older] <= Time)
+		{
+			const double Span = History.Times[Newer] - History.Times[Older];
+			const float Alpha = Span > 0.0 ? static_cast<float>((Time - History.Times[Older]) / Span) : 0.f;
+
+			FTransform Result;
+			Result.Blend(History.Transforms[Older], History.Transforms[Newer], Alpha);
+			return Result;
+		}
+		Newer = Older;
+	}
+
+	// Older than anything recorded, clamp to the oldest sample
+	return History.Transforms[Newer];
+}
+
+void UMeleeCombatSubsystem::ResolveSwings(double Now)
+{
+	const double MaxRewind = CVarMeleeMaxRewind.GetValueOnGameThread();
+
+	for (const FMeleeSwing& Swing : PendingSwings)
+	{
+		AActor* Attacker = Swing.Attacker.Get();
+		if (!Attacker)
+		{
+			continue;
+		}
+
+		const double RewindTime = FMath::Clamp(Swing.Timestamp, Now - MaxRewind, Now);
+		const float SwingLength = FVector::Dist(Swing.Start, Swing.End);
+
+		const FHitboxHistory* BestHistory = nullptr;
+		FTransform BestTransform;
+		float BestHitTime = 1.f;
+		FVector BestHitLocation = FVector::ZeroVector;
+		FVector BestHitNormal = FVector::ZeroVector;
+
+		for (const FHitboxHistory& History : Histories)
+		{
+			const UPrimitiveComponent* Hitbox = History.Hitbox.Get();
+			if (!Hitbox || History.Count == 0 || Hitbox->GetOwner() == Attacker)
+			{
+				continue;
+			}
+
+			// Cheap reject on the latest sample before paying for the rewind
+			const float ReachSquared = FMath::Square(SwingLength + Swing.Radius + History.BoundingRadius);
+			if (FVector::DistSquared(History.Transforms[History.Head].GetLocation(), Swing.Start) > ReachSquared)
+			{
+				continue;
+			}
+
+			// Sweep the sphere against the box in the hitbox's local space
+			const FTransform Transform = GetTransformAtTime(History, RewindTime);
+			const FVector LocalStart = Transform.InverseTransformPosition(Swing.Start);
+			const FVector LocalEnd = Transform.InverseTransformPosition(Swing.End);
+			const FVector LocalExtent = FVector(Swing.Radius) / Transform.GetScale3D().GetAbs().ComponentMax(
+				FVector(KINDA_SMALL_NUMBER));
+
+			FVector HitLocation;
+			FVector HitNormal;
+			float HitTime;
+			if (FMath::LineExtentBoxIntersection(History.LocalBox, LocalStart, LocalEnd, LocalExtent, HitLocation,
+			                                     HitNormal, HitTime) && HitTime < BestHitTime)
+			{
+				BestHistory = &History;
+				BestTransform = Transform;
+				BestHitTime = HitTime;
+				BestHitLocation = HitLocation;
+				BestHitNormal = HitNormal;
+			}
+		}
+
+		if (!BestHistory)
+		{
+			continue;
+		}
+
+		AActor* Target = BestHistory->Hitbox->GetOwner();
+		const FVector ImpactPoint = BestTransform.TransformPosition(BestHitLocation);
+
+		// Hitboxes don't know about level geometry, don't let swings pass through walls
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(MeleeOcclusion), false, Attacker);
+		QueryParams.AddIgnoredActor(Target);
+		if (GetWorld()->LineTraceTestByChannel(Swing.Start, ImpactPoint, ECC_WorldStatic, QueryParams))
+		{
+			continue;
+		}
+
+		const FVector SwingDirection = (Swing.End - Swing.Start).GetSafeNormal();
+		FHitResult HitResult(Target, BestHistory->Hitbox.Get(), ImpactPoint,
+		                     BestTransform.TransformVectorNoScale(BestHitNormal).GetSafeNormal());
+		HitResult.TraceStart = Swing.Start;
+		HitResult.TraceEnd = Swing.End;
+		HitResult.Time = BestHitTime;
+
+		UGameplayStatics::ApplyPointDamage(Target, Swing.Damage, SwingDirection, HitResult,
+		                                   Swing.InstigatorController.Get(), Attacker, Swing.DamageType);
+		OnMeleeHit.Broadcast(Attacker, Target, HitResult);
+	}
+
+	PendingSwings.Reset();
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "Engine/HitResult.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MeleeCombatSubsystem.generated.h"
+
+class AController;
+class UDamageType;
+class UPrimitiveComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnMeleeHit, AActor*, Attacker, AActor*, Target, const FHitResult&,
+                                               HitResult);
+
+// A swing as received from the client, resolved by the server on its next tick
+struct FMeleeSwing
+{
+	TWeakObjectPtr<AActor> Attacker;
+	TWeakObjectPtr<AController> InstigatorController;
+	TSubclassOf<UDamageType> DamageType;
+	FVector Start;
+	FVector End;
+	float Radius;
+	float Damage;
+	double Timestamp;
+};
+
+/*
+ * Server side lag compensation for melee. Keeps a fixed ring of recent hitbox transforms for every
+ * registered target and resolves all swings queued during a frame in one pass, each one against
+ * the target poses at the time the attacking client swung.
+ */
+UCLASS()
+class AFTERTHEEND_API UMeleeCombatSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	int32 RegisterTarget(UPrimitiveComponent* Hitbox);
+	void UnregisterTarget(int32 Handle);
+
+	void QueueSwing(const FMeleeSwing& Swing);
+
+	// Time base shared by clients and server, used to stamp swings and history
+	double GetServerTime() const;
+
+	UPROPERTY(BlueprintAssignable)
+	FOnMeleeHit OnMeleeHit;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	static constexpr int32 HistorySize = 32;
+
+	struct FHitboxHistory
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Hitbox;
+		FBox LocalBox;
+		float BoundingRadius;
+		TStaticArray<FTransform, HistorySize> Transforms;
+		TStaticArray<double, HistorySize> Times;
+		int32 Head = 0;
+		int32 Count = 0;
+	};
+
+	void RecordHistory(double Now);
+	void ResolveSwings(double Now);
+	FTransform GetTransformAtTime(const FHitboxHistory& History, double Time) const;
+
+	TSparseArray<FHitboxHistory> Histories;
+	TArray<FMeleeSwing> PendingSwings;
+
+	double LastRecordTime = -1.0;
+};
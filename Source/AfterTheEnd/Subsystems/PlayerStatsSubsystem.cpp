@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlayerStatsSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarStatsStepTime(
+	TEXT("ate.Stats.StepTime"),
+	0.5f,
+	TEXT("Fixed timestep in seconds for player stat decay"));
+
+static TAutoConsoleVariable<int32> CVarStatsParallelThreshold(
+	TEXT("ate.Stats.ParallelThreshold"),
+	64,
+	TEXT("Player count from which stat decay runs as a ParallelFor"));
+
+bool UPlayerStatsSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UPlayerStatsSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPlayerStatsSubsystem, STATGROUP_Tickables);
+}
+
+int32 UPlayerStatsSubsystem::RegisterPlayer(UPlayerStatsComponent* Component,
+                                            const float (&InMaxValues)[StatTypeCount],
+                                            const float (&InDecayRates)[StatTypeCount])
+{
+	const int32 Handle = Components.Add(Component);
+	DirtyMasks.Add(0);
+
+	for (int32 Stat = 0; Stat < StatTypeCount; ++Stat)
+	{
+		Values[Stat].Add(InMaxValues[Stat]);
+		MaxValues[Stat].Add(InMaxValues[Stat]);
+		DecayRates[Stat].Add(InDecayRates[Stat]);
+		Quantized[Stat].Add(Quantize(InMaxValues[Stat], InMaxValues[Stat]));
+	}
+
+	PublishPlayer(Handle);
+	return Handle;
+}
+
+void UPlayerStatsSubsystem::UnregisterPlayer(int32 Handle)
+{
+	if (!Components.IsValidIndex(Handle))
+	{
+		return;
+	}
+
+	// Swap the last player into the hole and fix up its handle
+	Components.RemoveAtSwap(Handle, 1, false);
+	DirtyMasks.RemoveAtSwap(Handle, 1, false);
+	for (int32 Stat = 0; Stat < StatTypeCount; ++Stat)
+	{
+		Values[Stat].RemoveAtSwap(Handle, 1, false);
+		MaxValues[Stat].RemoveAtSwap(Handle, 1, false);
+		DecayRates[Stat].RemoveAtSwap(Handle, 1, false);
+		Quantized[Stat].RemoveAtSwap(Handle, 1, false);
+	}
+
+	if (Components.IsValidIndex(Handle))
+	{
+		if (UPlayerStatsComponent* Moved = Components[Handle].Get())
+		{
+			Moved->StatsHandle = Handle;
+		}
+	}
+}
+
+float UPlayerStatsSubsystem::GetValue(int32 Handle, EStatType StatType) const
+{
+	return Values[static_cast<int32>(StatType)][Handle];
+}
+
+void UPlayerStatsSubsystem::ModifyValue(int32 Handle, EStatType StatType, float Delta)
+{
+	const int32 Stat = static_cast<int32>(StatType);
+	float& Value = Values[Stat][Handle];
+	Value = FMath::Clamp(Value + Delta, 0.f, MaxValues[Stat][Handle]);
+
+	const uint8 NewQuantized = Quantize(Value, MaxValues[Stat][Handle]);
+	if (NewQuantized != Quantized[Stat][Handle])
+	{
+		Quantized[Stat][Handle] = NewQuantized;
+		DirtyMasks[Handle] |= 1 << Stat;
+		PublishPlayer(Handle);
+	}
+}
+
+void UPlayerStatsSubsystem::SetMaxValue(int32 Handle, EStatType StatType, float NewMax)
+{
+	const int32 Stat = static_cast<int32>(StatType);
+	MaxValues[Stat][Handle] = FMath::Max(NewMax, 0.f);
+	Values[Stat][Handle] = FMath::Min(Values[Stat][Handle], MaxValues[Stat][Handle]);
+	Quantized[Stat][Handle] = Quantize(Values[Stat][Handle], MaxValues[Stat][Handle]);
+
+	DirtyMasks[Handle] |= 1 << Stat;
+	PublishPlayer(Handle);
+}
+
+uint8 UPlayerStatsSubsystem::Quantize(float Value, float MaxValue)
+{
+	return MaxValue > 0.f ? static_cast<uint8>(FMath::RoundToInt(Value / MaxValue * 255.f)) : 0;
+}
+
+void UPlayerStatsSubsystem::Tick(float DeltaTime)
+{
+	const int32 NumPlayers = Components.Num();
+	if (NumPlayers == 0)
+	{
+		return;
+	}
+
+	const float StepTime = FMath::Max(CVarStatsStepTime.GetValueOnGameThread(), 0.01f);
+	TimeAccumulator += DeltaTime;
+
+	// Don't spiral after a hitch, anything beyond a few steps is dropped
+	int32 NumSteps = 0;
+	while (TimeAccumulator >= StepTime && NumSteps < 4)
+	{
+		Simulate(StepTime);
+		TimeAccumulator -= StepTime;
+		++NumSteps;
+	}
+	TimeAccumulator = FMath::Min(TimeAccumulator, StepTime);
+
+	if (NumSteps > 0)
+	{
+		PublishChanges();
+	}
+}
+
+void UPlayerStatsSubsystem::Simulate(float StepTime)
+{
+	const int32 NumPlayers = Components.Num();
+
+	auto SimulatePlayer = [this, StepTime](int32 Handle)
+	{
+		uint8 DirtyMask = 0;
+		for (int32 Stat = 0; Stat < StatTypeCount; ++Stat)
+		{
+			const float MaxValue = MaxValues[Stat][Handle];
+			float& Value = Values[Stat][Handle];
+			Value = FMath::Clamp(Value - DecayRates[Stat][Handle] * StepTime, 0.f, MaxValue);
+
+			const uint8 NewQuantized = Quantize(Value, MaxValue);
+			if (NewQuantized != Quantized[Stat][Handle])
+			{
+				Quantized[Stat][Handle] = NewQuantized;
+				DirtyMask |= 1 << Stat;
+			}
+		}
+		DirtyMasks[Handle] |= DirtyMask;
+	};
+
+	ParallelFor(NumPlayers, SimulatePlayer, NumPlayers < CVarStatsParallelThreshold.GetValueOnGameThread());
+}
+
+void UPlayerStatsSubsystem::PublishChanges()
+{
+	for (int32 Handle = 0; Handle < Components.Num(); ++Handle)
+	{
+		if (DirtyMasks[Handle] != 0)
+		{
+			PublishPlayer(Handle);
+		}
+	}
+}
+
+void UPlayerStatsSubsystem::PublishPlayer(int32 Handle)
+{
+	UPlayerStatsComponent* Component = Components[Handle].Get();
+	if (Component)
+	{
+		for (int32 Stat = 0; Stat < StatTypeCount; ++Stat)
+		{
+			if (DirtyMasks[Handle] & (1 << Stat) || Component->Stats.Items[Stat].ReplicationID == INDEX_NONE)
+			{
+				Component->SetReplicatedStat(static_cast<EStatType>(Stat), Quantized[Stat][Handle],
+				                             MaxValues[Stat][Handle]);
+			}
+		}
+	}
+	DirtyMasks[Handle] = 0;
+}
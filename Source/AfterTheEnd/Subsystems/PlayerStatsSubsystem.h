@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AfterTheEnd/Components/PlayerStatsComponent.h"
+#include "PlayerStatsSubsystem.generated.h"
+
+/*
+ * Server side simulation of every player's stats. Values live in struct-of-arrays form, one
+ * array per stat, and decay runs for all players in a single fixed step pass, spread over
+ * worker threads once there are enough players to make it worth it.
+ */
+UCLASS()
+class AFTERTHEEND_API UPlayerStatsSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	int32 RegisterPlayer(UPlayerStatsComponent* Component, const float (&InMaxValues)[StatTypeCount],
+	                     const float (&InDecayRates)[StatTypeCount]);
+	void UnregisterPlayer(int32 Handle);
+
+	float GetValue(int32 Handle, EStatType StatType) const;
+	void ModifyValue(int32 Handle, EStatType StatType, float Delta);
+	void SetMaxValue(int32 Handle, EStatType StatType, float NewMax);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void Simulate(float StepTime);
+	void PublishChanges();
+	void PublishPlayer(int32 Handle);
+
+	static uint8 Quantize(float Value, float MaxValue);
+
+	TStaticArray<TArray<float>, StatTypeCount> Values;
+	TStaticArray<TArray<float>, StatTypeCount> MaxValues;
+	TStaticArray<TArray<float>, StatTypeCount> DecayRates;
+	TStaticArray<TArray<uint8>, StatTypeCount> Quantized;
+
+	// Bit per stat whose quantized value changed during the last step
+	TArray<uint8> DirtyMasks;
+
+	TArray<TWeakObjectPtr<UPlayerStatsComponent>> Components;
+
+	float TimeAccumulator = 0.f;
+};
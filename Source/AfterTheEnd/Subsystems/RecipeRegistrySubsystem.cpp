@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RecipeRegistrySubsystem.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Engine/DataTable.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRecipeRegistry, Log, All);
+
+void URecipeRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	// Ingredients are stored as item ids
+	Collection.InitializeDependency<UItemRegistrySubsystem>();
+
+	Super::Initialize(Collection);
+
+	CompileRecipeTable();
+}
+
+URecipeRegistrySubsystem* URecipeRegistrySubsystem::Get(const UWorld* World)
+{
+	return World ? UGameInstance::GetSubsystem<URecipeRegistrySubsystem>(World->GetGameInstance()) : nullptr;
+}
+
+void URecipeRegistrySubsystem::CompileRecipeTable()
+{
+	Recipes.Reset();
+	RowNameToId.Reset();
+	RecipesByIngredient.Reset();
+	RecipesByOutput.Reset();
+
+	const UItemRegistrySubsystem* ItemRegistry = GetGameInstance()->GetSubsystem<UItemRegistrySubsystem>();
+	const UDataTable* Table = RecipeTable.LoadSynchronous();
+	if (!ItemRegistry || !Table)
+	{
+		return;
+	}
+
+	const UStruct* RowStruct = Table->GetRowStruct();
+	const FProperty* OutputField = DataTableFields::FindField(RowStruct, TEXT("ItemID"));
+	const FProperty* CategoryField = DataTableFields::FindField(RowStruct, TEXT("ItemCategory"));
+	const FProperty* LevelField = DataTableFields::FindField(RowStruct, TEXT("RequiredLevel"));
+	const FProperty* ExperienceField = DataTableFields::FindField(RowStruct, TEXT("ItemExperience"));
+	const FProperty* RequiredItemsField = DataTableFields::FindField(RowStruct, TEXT("RequiredItems"));
+
+	Recipes.Reserve(Table->GetRowMap().Num());
+	for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+	{
+		FRecipeDefinition Recipe;
+		Recipe.RowName = Row.Key;
+
+		// ItemID names the DT_Items row that is produced, older rows only have the row name
+		const FName OutputName = DataTableFields::GetName(OutputField, Row.Value);
+		Recipe.OutputItemId = ItemRegistry->FindItemId(OutputName.IsNone() ? Row.Key : OutputName);
+		Recipe.Category = static_cast<EItemCategory>(DataTableFields::GetInt(CategoryField, Row.Value));
+		Recipe.RequiredLevel = static_cast<int32>(DataTableFields::GetInt(LevelField, Row.Value));
+		Recipe.Experience = static_cast<int32>(DataTableFields::GetInt(ExperienceField, Row.Value));
+
+		bool bValid = Recipe.OutputItemId != InvalidItemId;
+		DataTableFields::ForEachStruct(RequiredItemsField, Row.Value, [&](const UStruct* ElementStruct, const void* Element)
+		{
+			const FProperty* ItemNameField = DataTableFields::FindField(ElementStruct, TEXT("ItemName"));
+			const FProperty* QuantityField = DataTableFields::FindField(ElementStruct, TEXT("ItemQuantity"));
+
+			FRecipeIngredient Ingredient;
+			Ingredient.ItemId = ItemRegistry->FindItemId(DataTableFields::GetName(ItemNameField, Element));
+			Ingredient.Quantity = static_cast<int32>(DataTableFields::GetInt(QuantityField, Element));
+			bValid &= Ingredient.ItemId != InvalidItemId && Ingredient.Quantity > 0;
+			Recipe.Ingredients.Add(Ingredient);
+		});
+
+		if (!bValid)
+		{
+			UE_LOG(LogRecipeRegistry, Warning, TEXT("Recipe %s references unknown items, skipped"), *Row.Key.ToString());
+			continue;
+		}
+
+		RowNameToId.Add(Row.Key, Recipes.Add(MoveTemp(Recipe)));
+	}
+
+	RecipesByIngredient.SetNum(ItemRegistry->GetNumItems());
+	RecipesByOutput.SetNum(ItemRegistry->GetNumItems());
+	for (int32 RecipeId = 0; RecipeId < Recipes.Num(); ++RecipeId)
+	{
+		const FRecipeDefinition& Recipe = Recipes[RecipeId];
+		RecipesByOutput[Recipe.OutputItemId].Add(RecipeId);
+		for (const FRecipeIngredient& Ingredient : Recipe.Ingredients)
+		{
+			RecipesByIngredient[Ingredient.ItemId].AddUnique(RecipeId);
+		}
+	}
+
+	UE_LOG(LogRecipeRegistry, Log, TEXT("Compiled %d recipes"), Recipes.Num());
+}
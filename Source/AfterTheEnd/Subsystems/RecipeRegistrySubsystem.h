@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "AfterTheEnd/Subsystems/ItemRegistrySubsystem.h"
+#include "RecipeRegistrySubsystem.generated.h"
+
+class UDataTable;
+
+// Mirrors E_ItemCategory
+UENUM(BlueprintType)
+enum class EItemCategory : uint8
+{
+	Misc,
+	Tools,
+	Armor,
+	Structures
+};
+
+struct FRecipeIngredient
+{
+	FItemId ItemId = InvalidItemId;
+	int32 Quantity = 0;
+};
+
+/*
+ * One DT_PlayerItemRecipes row, read once out of S_ItemRecipe with item names resolved to ids.
+ */
+struct FRecipeDefinition
+{
+	FName RowName;
+	FItemId OutputItemId = InvalidItemId;
+	int32 OutputQuantity = 1;
+	EItemCategory Category = EItemCategory::Misc;
+	int32 RequiredLevel = 0;
+	int32 Experience = 0;
+	TArray<FRecipeIngredient, TInlineAllocator<4>> Ingredients;
+};
+
+/*
+ * DT_PlayerItemRecipes compiled into an array indexed by recipe id, plus an inverted index from
+ * ingredient to the recipes using it, so a changed item count only touches the recipes it can
+ * affect.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API URecipeRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static URecipeRegistrySubsystem* Get(const UWorld* World);
+
+	int32 GetNumRecipes() const { return Recipes.Num(); }
+
+	TConstArrayView<FRecipeDefinition> GetRecipes() const { return Recipes; }
+
+	const FRecipeDefinition* FindRecipe(int32 RecipeId) const
+	{
+		return Recipes.IsValidIndex(RecipeId) ? &Recipes[RecipeId] : nullptr;
+	}
+
+	int32 FindRecipeId(FName RowName) const
+	{
+		const int32* RecipeId = RowNameToId.Find(RowName);
+		return RecipeId ? *RecipeId : INDEX_NONE;
+	}
+
+	// Recipes with ItemId as an ingredient
+	TConstArrayView<int32> GetRecipesUsing(FItemId ItemId) const
+	{
+		return RecipesByIngredient.IsValidIndex(ItemId) ? TConstArrayView<int32>(RecipesByIngredient[ItemId])
+			       : TConstArrayView<int32>();
+	}
+
+	// Recipes producing ItemId
+	TConstArrayView<int32> GetRecipesFor(FItemId ItemId) const
+	{
+		return RecipesByOutput.IsValidIndex(ItemId) ? TConstArrayView<int32>(RecipesByOutput[ItemId])
+			       : TConstArrayView<int32>();
+	}
+
+	UFUNCTION(BlueprintPure, Category=Crafting)
+	FName GetRecipeRowName(int32 RecipeId) const { return Recipes.IsValidIndex(RecipeId) ? Recipes[RecipeId].RowName : NAME_None; }
+
+	UFUNCTION(BlueprintPure, Category=Crafting, meta=(DisplayName="Find Recipe Id"))
+	int32 K2_FindRecipeId(FName RowName) const { return FindRecipeId(RowName); }
+
+protected:
+	void CompileRecipeTable();
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UDataTable> RecipeTable;
+
+	TArray<FRecipeDefinition> Recipes;
+
+	TMap<FName, int32> RowNameToId;
+
+	// Both indexed by item id
+	TArray<TArray<int32>> RecipesByIngredient;
+	TArray<TArray<int32>> RecipesByOutput;
+};
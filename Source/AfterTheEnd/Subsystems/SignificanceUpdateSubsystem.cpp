@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "SignificanceUpdateSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "SignificanceManager.h"
+
+static TAutoConsoleVariable<float> CVarSignificanceUpdateRate(
+	TEXT("ate.Significance.UpdateRate"),
+	5.f,
+	TEXT("Significance updates per second"));
+
+bool USignificanceUpdateSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId USignificanceUpdateSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USignificanceUpdateSubsystem, STATGROUP_Tickables);
+}
+
+void USignificanceUpdateSubsystem::Tick(float DeltaTime)
+{
+	const float UpdateRate = CVarSignificanceUpdateRate.GetValueOnGameThread();
+	TimeSinceLastUpdate += DeltaTime;
+	if (UpdateRate <= 0.f || TimeSinceLastUpdate < 1.f / UpdateRate)
+	{
+		return;
+	}
+	TimeSinceLastUpdate = 0.f;
+
+	USignificanceManager* SignificanceManager = FSignificanceManagerModule::Get(GetWorld());
+	if (!SignificanceManager)
+	{
+		return;
+	}
+
+	// Remote controllers only exist on the server, so this covers every player there and local ones on clients
+	Viewpoints.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APlayerController* PlayerController = It->Get())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			Viewpoints.Emplace(ViewRotation, ViewLocation);
+		}
+	}
+
+	SignificanceManager->Update(Viewpoints);
+}
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SignificanceUpdateSubsystem.generated.h"
+
+/*
+ * The significance manager has no tick of its own. This feeds it player viewpoints at
+ * ate.Significance.UpdateRate: every player on the server, local players on clients.
+ */
+UCLASS()
+class AFTERTHEEND_API USignificanceUpdateSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	TArray<FTransform> Viewpoints;
+
+	float TimeSinceLastUpdate = 0.f;
+};
@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StructuralStabilitySubsystem.h"
+#include "BuildingAggregationSubsystem.h"
+#include "BuildingSnapSubsystem.h"
+#include "StructureRegistrySubsystem.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarMaxSupportDistance(
+	TEXT("ate.Building.MaxSupportDistance"),
+	12,
+	TEXT("Longest chain of pieces between a piece and the ground that still holds it up, read on map load"));
+
+static TAutoConsoleVariable<int32> CVarCollapseBatchSize(
+	TEXT("ate.Building.CollapseBatchSize"),
+	16,
+	TEXT("Unsupported building pieces collapsed per frame"));
+
+bool UStructuralStabilitySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UStructuralStabilitySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UStructuralStabilitySubsystem, STATGROUP_Tickables);
+}
+
+void UStructuralStabilitySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Graph = FStructuralGraph(CVarMaxSupportDistance.GetValueOnGameThread());
+	StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	BuildingSnap = Collection.InitializeDependency<UBuildingSnapSubsystem>();
+	BuildingAggregation = Collection.InitializeDependency<UBuildingAggregationSubsystem>();
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.AddUObject(this, &UStructuralStabilitySubsystem::HandlePieceRegistered);
+		BuildingSnap->OnPieceUnregistered.AddUObject(this, &UStructuralStabilitySubsystem::HandlePieceUnregistered);
+	}
+}
+
+void UStructuralStabilitySubsystem::Deinitialize()
+{
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.RemoveAll(this);
+		BuildingSnap->OnPieceUnregistered.RemoveAll(this);
+	}
+
+	Super::Deinitialize();
+}
+
+void UStructuralStabilitySubsystem::HandlePieceRegistered(int32 PieceHandle)
+{
+	if (GetWorld()->GetNetMode() == NM_Client || !StructureRegistry)
+	{
+		return;
+	}
+
+	TArray<int32> Attached;
+	BuildingSnap->GetAttachedPieces(PieceHandle, Attached);
+
+	TArray<int32, TInlineAllocator<8>> Neighbours;
+	for (const int32 Other : Attached)
+	{
+		const int32 Node = FindNode(Other);
+		if (Node != INDEX_NONE)
+		{
+			Neighbours.Add(Node);
+		}
+	}
+
+	const FStructureType& Type = StructureRegistry->GetStructureType(BuildingSnap->GetPieceType(PieceHandle));
+	const int32 Node = Graph.AddNode(Type.bCanPlaceOnGround, Neighbours);
+
+	while (PieceNodes.Num() <= PieceHandle)
+	{
+		PieceNodes.Add(INDEX_NONE);
+	}
+	while (NodePieces.Num() <= Node)
+	{
+		NodePieces.Add(INDEX_NONE);
+	}
+	PieceNodes[PieceHandle] = Node;
+	NodePieces[Node] = PieceHandle;
+
+	if (!Graph.IsSupported(Node))
+	{
+		QueueCollapse(MakeArrayView(&Node, 1));
+	}
+}
+
+void UStructuralStabilitySubsystem::HandlePieceUnregistered(int32 PieceHandle)
+{
+	const int32 Node = FindNode(PieceHandle);
+	if (Node == INDEX_NONE)
+	{
+		return;
+	}
+
+	PieceNodes[PieceHandle] = INDEX_NONE;
+	NodePieces[Node] = INDEX_NONE;
+
+	TArray<int32> Unsupported;
+	Graph.RemoveNode(Node, Unsupported);
+	QueueCollapse(Unsupported);
+}
+
+void UStructuralStabilitySubsystem::QueueCollapse(TConstArrayView<int32> Nodes)
+{
+	for (const int32 Node : Nodes)
+	{
+		PendingCollapse.Add(NodePieces[Node]);
+	}
+}
+
+void UStructuralStabilitySubsystem::Tick(float DeltaTime)
+{
+	if (PendingCollapse.IsEmpty())
+	{
+		return;
+	}
+
+	// Pieces collapsing here unregister and may queue more, which waits for the next frame
+	const int32 BatchSize = FMath::Min(FMath::Max(CVarCollapseBatchSize.GetValueOnGameThread(), 1),
+	                                   PendingCollapse.Num());
+	TArray<int32> Batch(PendingCollapse.GetData(), BatchSize);
+	PendingCollapse.RemoveAt(0, BatchSize, false);
+
+	for (const int32 PieceHandle : Batch)
+	{
+		const int32 Node = FindNode(PieceHandle);
+		if (Node != INDEX_NONE && !Graph.IsSupported(Node))
+		{
+			CollapsePiece(PieceHandle);
+		}
+	}
+}
+
+void UStructuralStabilitySubsystem::CollapsePiece(int32 PieceHandle)
+{
+	if (BuildingAggregation)
+	{
+		BuildingAggregation->DestroyPiece(PieceHandle);
+	}
+	else if (AActor* Piece = BuildingSnap->GetPieceActor(PieceHandle))
+	{
+		Piece->Destroy();
+	}
+	else
+	{
+		BuildingSnap->RemovePiece(PieceHandle);
+	}
+}
+
+float UStructuralStabilitySubsystem::GetStability(const AActor* Piece) const
+{
+	const int32 Node = FindNode(BuildingSnap ? BuildingSnap->FindPiece(Piece) : INDEX_NONE);
+	return Node != INDEX_NONE ? Graph.GetStability(Node) : 0.f;
+}
+
+bool UStructuralStabilitySubsystem::IsSupported(const AActor* Piece) const
+{
+	const int32 Node = FindNode(BuildingSnap ? BuildingSnap->FindPiece(Piece) : INDEX_NONE);
+	return Node != INDEX_NONE && Graph.IsSupported(Node);
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "AfterTheEnd/Building/StructuralGraph.h"
+#include "StructuralStabilitySubsystem.generated.h"
+
+class UBuildingAggregationSubsystem;
+class UBuildingSnapSubsystem;
+class UStructureRegistrySubsystem;
+
+/*
+ * Server side structural integrity. Snap pieces are nodes of an FStructuralGraph linked through
+ * their sockets, pieces that can be placed on the ground are its roots. Aggregated pieces stay in
+ * the graph and are promoted to collapse. Pieces that lose
+ * their way down are collapsed a batch per frame, ate.Building.CollapseBatchSize at a time, so
+ * knocking out a foundation under a large base doesn't destroy everything above it in one frame.
+ */
+UCLASS()
+class AFTERTHEEND_API UStructuralStabilitySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// 1 on the ground, 0 for pieces about to collapse and anything that isn't a placed piece
+	UFUNCTION(BlueprintPure, Category=Building)
+	float GetStability(const AActor* Piece) const;
+
+	UFUNCTION(BlueprintPure, Category=Building)
+	bool IsSupported(const AActor* Piece) const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void HandlePieceRegistered(int32 PieceHandle);
+	void HandlePieceUnregistered(int32 PieceHandle);
+
+	int32 FindNode(int32 PieceHandle) const
+	{
+		return PieceNodes.IsValidIndex(PieceHandle) ? PieceNodes[PieceHandle] : INDEX_NONE;
+	}
+
+	void QueueCollapse(TConstArrayView<int32> Nodes);
+	void CollapsePiece(int32 PieceHandle);
+
+	FStructuralGraph Graph;
+
+	// Graph node by snap piece handle and back
+	TArray<int32> PieceNodes;
+	TArray<int32> NodePieces;
+
+	// Piece handles, checked again when their batch comes up since something may have been placed
+	// under them or the handle reused
+	TArray<int32> PendingCollapse;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingSnapSubsystem> BuildingSnap;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingAggregationSubsystem> BuildingAggregation;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStructureRegistrySubsystem> StructureRegistry;
+};
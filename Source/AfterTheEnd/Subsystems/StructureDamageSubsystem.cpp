@@ -0,0 +1,366 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StructureDamageSubsystem.h"
+#include "BuildingAggregationSubsystem.h"
+#include "BuildingSnapSubsystem.h"
+#include "StructureRegistrySubsystem.h"
+#include "AfterTheEnd/Building/BuildingBaseAggregator.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<float> CVarDecayBudgetMs(
+	TEXT("ate.Building.DecayBudgetMs"),
+	0.25f,
+	TEXT("Milliseconds per frame spent sweeping building pieces for decay"));
+
+static TAutoConsoleVariable<float> CVarDecayInterval(
+	TEXT("ate.Building.DecayInterval"),
+	60.f,
+	TEXT("Seconds between the starts of two decay sweeps over all building pieces"));
+
+// Pieces swept between two looks at the clock
+static constexpr int32 DecayClockStride = 64;
+
+namespace
+{
+	// E_StructureDamageType by display name
+	const FName DamageTypeNames[UStructureDamageSubsystem::NumDamageTypes] = {
+		TEXT("None"), TEXT("Wood"), TEXT("Stone"), TEXT("Metal")
+	};
+}
+
+bool UStructureDamageSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UStructureDamageSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UStructureDamageSubsystem, STATGROUP_Tickables);
+}
+
+void UStructureDamageSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	StructureRegistry = UStructureRegistrySubsystem::Get(GetWorld());
+	BuildingSnap = Collection.InitializeDependency<UBuildingSnapSubsystem>();
+	BuildingAggregation = Collection.InitializeDependency<UBuildingAggregationSubsystem>();
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.AddUObject(this, &UStructureDamageSubsystem::HandlePieceRegistered);
+	}
+
+	CompileTables();
+}
+
+void UStructureDamageSubsystem::Deinitialize()
+{
+	if (BuildingSnap)
+	{
+		BuildingSnap->OnPieceRegistered.RemoveAll(this);
+	}
+
+	Super::Deinitialize();
+}
+
+int32 UStructureDamageSubsystem::FindDamageType(FName DisplayName)
+{
+	for (int32 DamageType = 0; DamageType < NumDamageTypes; ++DamageType)
+	{
+		if (DamageTypeNames[DamageType] == DisplayName)
+		{
+			return DamageType;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void UStructureDamageSubsystem::CompileTables()
+{
+	// Anything not in config hits at full strength, CanDealDamageTypes still decides whether it hits
+	for (float (&Row)[NumDamageTypes] : Multipliers)
+	{
+		for (float& Multiplier : Row)
+		{
+			Multiplier = 1.f;
+		}
+	}
+	for (const FStructureDamageMultiplier& Entry : DamageMultipliers)
+	{
+		const int32 DamageType = FindDamageType(Entry.DamageType);
+		const int32 Tier = FindDamageType(Entry.StructureTier);
+		if (DamageType != INDEX_NONE && Tier != INDEX_NONE)
+		{
+			Multipliers[DamageType][Tier] = FMath::Max(Entry.Multiplier, 0.f);
+		}
+	}
+
+	float DecaySeconds[NumDamageTypes] = {};
+	for (const FStructureDecayTime& Entry : DecayTimes)
+	{
+		const int32 Tier = FindDamageType(Entry.StructureTier);
+		if (Tier != INDEX_NONE)
+		{
+			DecaySeconds[Tier] = FMath::Max(Entry.Hours, 0.f) * 3600.f;
+		}
+	}
+
+	StructureHealth.Reset();
+	const int32 NumStructureTypes = StructureRegistry ? StructureRegistry->GetNumStructureTypes() : 0;
+	for (int32 TypeId = 0; TypeId < NumStructureTypes; ++TypeId)
+	{
+		FStructureHealth& Health = StructureHealth.AddDefaulted_GetRef();
+		const UClass* BuildClass = StructureRegistry->GetStructureType(TypeId).BuildClass;
+		if (!BuildClass)
+		{
+			continue;
+		}
+
+		const UObject* Defaults = BuildClass->GetDefaultObject();
+		Health.HealthField = DataTableFields::FindField(BuildClass, TEXT("CurrentHP"));
+		Health.MaxHealth = DataTableFields::GetFloat(DataTableFields::FindField(BuildClass, TEXT("MaxHP")), Defaults);
+		Health.Tier = static_cast<uint8>(FMath::Clamp<int64>(
+			DataTableFields::GetInt(DataTableFields::FindField(BuildClass, TEXT("StructureTier")), Defaults),
+			0, NumDamageTypes - 1));
+		if (DecaySeconds[Health.Tier] > 0.f)
+		{
+			Health.DecayRate = Health.MaxHealth / DecaySeconds[Health.Tier];
+		}
+	}
+}
+
+const UStructureDamageSubsystem::FDamageSourceFields& UStructureDamageSubsystem::FindDamageSourceFields(
+	const UClass* CauserClass) const
+{
+	if (const FDamageSourceFields* Fields = DamageSourceFields.Find(CauserClass))
+	{
+		return *Fields;
+	}
+
+	FDamageSourceFields Fields;
+	Fields.DamageType = DataTableFields::FindField(CauserClass, TEXT("StructureDamageType"));
+	Fields.DamageTiers = CastField<FStructProperty>(DataTableFields::FindField(CauserClass, TEXT("DamageTiers")));
+	if (Fields.DamageTiers)
+	{
+		Fields.CanDealDamageTypes = DataTableFields::FindField(Fields.DamageTiers->Struct, TEXT("CanDealDamageTypes"));
+	}
+	return DamageSourceFields.Add(CauserClass, Fields);
+}
+
+float UStructureDamageSubsystem::GetDamageMultiplier(const AActor* DamageCauser, uint8 StructureTier) const
+{
+	// Like CanDamageStructure, a causer that can't name the tier in its S_DamageTiers deals nothing
+	if (!DamageCauser || StructureTier >= NumDamageTypes)
+	{
+		return 0.f;
+	}
+
+	const FDamageSourceFields& Fields = FindDamageSourceFields(DamageCauser->GetClass());
+	if (!Fields.CanDealDamageTypes)
+	{
+		return 0.f;
+	}
+
+	bool bCanDamage = false;
+	DataTableFields::ForEachInt(Fields.CanDealDamageTypes, Fields.DamageTiers->ContainerPtrToValuePtr<void>(DamageCauser),
+	                            [StructureTier, &bCanDamage](int64 Tier)
+	                            {
+		                            bCanDamage |= Tier == StructureTier;
+	                            });
+	if (!bCanDamage)
+	{
+		return 0.f;
+	}
+
+	const int64 DamageType = FMath::Clamp<int64>(DataTableFields::GetInt(Fields.DamageType, DamageCauser), 0,
+	                                             NumDamageTypes - 1);
+	return Multipliers[DamageType][StructureTier];
+}
+
+void UStructureDamageSubsystem::HandlePieceRegistered(int32 PieceHandle)
+{
+	while (LastDecayTimes.Num() <= PieceHandle)
+	{
+		LastDecayTimes.Add(0.0);
+	}
+	LastDecayTimes[PieceHandle] = GetWorld()->GetTimeSeconds();
+}
+
+void UStructureDamageSubsystem::QueueDamage(AActor* Structure, float Damage, AActor* DamageCauser)
+{
+	if (BuildingSnap)
+	{
+		QueuePieceDamage(BuildingSnap->FindPiece(Structure), Damage, DamageCauser);
+	}
+}
+
+void UStructureDamageSubsystem::QueueHitDamage(const FHitResult& Hit, float Damage, AActor* DamageCauser)
+{
+	if (!BuildingSnap)
+	{
+		return;
+	}
+
+	const AActor* HitActor = Hit.GetActor();
+	const ABuildingBaseAggregator* Base = Cast<ABuildingBaseAggregator>(HitActor);
+	QueuePieceDamage(Base ? Base->GetInstanceSnapPiece(Hit.GetComponent(), Hit.Item) : BuildingSnap->FindPiece(HitActor),
+	                 Damage, DamageCauser);
+}
+
+void UStructureDamageSubsystem::QueuePieceDamage(int32 PieceHandle, float Damage, const AActor* DamageCauser)
+{
+	if (Damage <= 0.f || !BuildingSnap || !BuildingSnap->IsValidPiece(PieceHandle))
+	{
+		return;
+	}
+
+	const FStructureTypeId TypeId = BuildingSnap->GetPieceType(PieceHandle);
+	if (!StructureHealth.IsValidIndex(TypeId))
+	{
+		return;
+	}
+
+	// Resolved now, the causer may be gone by the time the queue is applied
+	const float Amount = Damage * GetDamageMultiplier(DamageCauser, StructureHealth[TypeId].Tier);
+	if (Amount > 0.f)
+	{
+		QueuedDamage.Add({PieceHandle, Amount});
+	}
+}
+
+float UStructureDamageSubsystem::GetPieceHealth(int32 PieceHandle) const
+{
+	if (const AActor* Piece = BuildingSnap->GetPieceActor(PieceHandle))
+	{
+		return DataTableFields::GetFloat(StructureHealth[BuildingSnap->GetPieceType(PieceHandle)].HealthField, Piece,
+		                                 -1.0);
+	}
+
+	const ABuildingBaseAggregator* Base = BuildingAggregation ? BuildingAggregation->GetPieceBase(PieceHandle) : nullptr;
+	return Base ? Base->GetPieceHealth(PieceHandle) : -1.f;
+}
+
+void UStructureDamageSubsystem::SetPieceHealth(int32 PieceHandle, float Health)
+{
+	if (AActor* Piece = BuildingSnap->GetPieceActor(PieceHandle))
+	{
+		DataTableFields::SetFloat(StructureHealth[BuildingSnap->GetPieceType(PieceHandle)].HealthField, Piece, Health);
+	}
+	else if (ABuildingBaseAggregator* Base = BuildingAggregation ? BuildingAggregation->GetPieceBase(PieceHandle)
+		                                         : nullptr)
+	{
+		Base->SetPieceHealth(PieceHandle, Health);
+	}
+}
+
+float UStructureDamageSubsystem::GetHealthPercent(const AActor* Structure) const
+{
+	const int32 PieceHandle = BuildingSnap ? BuildingSnap->FindPiece(Structure) : INDEX_NONE;
+	if (PieceHandle == INDEX_NONE)
+	{
+		return 0.f;
+	}
+
+	const FStructureHealth& Health = StructureHealth[BuildingSnap->GetPieceType(PieceHandle)];
+	return Health.MaxHealth > 0.f ? FMath::Clamp(GetPieceHealth(PieceHandle) / Health.MaxHealth, 0.f, 1.f) : 0.f;
+}
+
+void UStructureDamageSubsystem::Tick(float DeltaTime)
+{
+	if (!BuildingSnap || GetWorld()->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	DecaySlice();
+	ApplyQueuedDamage();
+}
+
+void UStructureDamageSubsystem::DecaySlice()
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	if (DecayCursor == 0)
+	{
+		if (Now - DecayPassStartTime < CVarDecayInterval.GetValueOnGameThread())
+		{
+			return;
+		}
+		DecayPassStartTime = Now;
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + CVarDecayBudgetMs.GetValueOnGameThread() / 1000.0;
+	const int32 MaxPieceHandle = BuildingSnap->GetMaxPieceHandle();
+	while (DecayCursor < MaxPieceHandle)
+	{
+		const int32 PieceHandle = DecayCursor++;
+		if (BuildingSnap->IsValidPiece(PieceHandle) && LastDecayTimes.IsValidIndex(PieceHandle))
+		{
+			const float DecayRate = StructureHealth[BuildingSnap->GetPieceType(PieceHandle)].DecayRate;
+			if (DecayRate > 0.f)
+			{
+				QueuedDamage.Add({PieceHandle, static_cast<float>(DecayRate * (Now - LastDecayTimes[PieceHandle]))});
+			}
+			LastDecayTimes[PieceHandle] = Now;
+		}
+
+		if (DecayCursor % DecayClockStride == 0 && FPlatformTime::Seconds() >= EndTime)
+		{
+			return;
+		}
+	}
+	DecayCursor = 0;
+}
+
+void UStructureDamageSubsystem::ApplyQueuedDamage()
+{
+	if (QueuedDamage.IsEmpty())
+	{
+		return;
+	}
+
+	// Grouped by piece so each one is read and written once, only the net change goes out
+	QueuedDamage.Sort([](const FQueuedDamage& A, const FQueuedDamage& B) { return A.PieceHandle < B.PieceHandle; });
+
+	TArray<int32, TInlineAllocator<16>> Destroyed;
+	for (int32 Index = 0; Index < QueuedDamage.Num();)
+	{
+		const int32 PieceHandle = QueuedDamage[Index].PieceHandle;
+		float Amount = 0.f;
+		for (; Index < QueuedDamage.Num() && QueuedDamage[Index].PieceHandle == PieceHandle; ++Index)
+		{
+			Amount += QueuedDamage[Index].Amount;
+		}
+
+		// Destroyed since the damage was queued
+		if (!BuildingSnap->IsValidPiece(PieceHandle))
+		{
+			continue;
+		}
+
+		const float Health = GetPieceHealth(PieceHandle);
+		if (Health < 0.f)
+		{
+			continue;
+		}
+
+		const float NewHealth = FMath::Max(Health - Amount, 0.f);
+		SetPieceHealth(PieceHandle, NewHealth);
+		if (NewHealth <= 0.f)
+		{
+			Destroyed.Add(PieceHandle);
+		}
+	}
+	QueuedDamage.Reset();
+
+	// After the loop, destroying a piece can take others down with it
+	for (const int32 PieceHandle : Destroyed)
+	{
+		if (BuildingSnap->IsValidPiece(PieceHandle) && BuildingAggregation)
+		{
+			BuildingAggregation->DestroyPiece(PieceHandle);
+		}
+	}
+}
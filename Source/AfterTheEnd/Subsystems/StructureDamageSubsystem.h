@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "StructureDamageSubsystem.generated.h"
+
+class UBuildingAggregationSubsystem;
+class UBuildingSnapSubsystem;
+class UStructureRegistrySubsystem;
+
+// How hard one E_StructureDamageType hits one structure tier, both by display name
+USTRUCT()
+struct FStructureDamageMultiplier
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName DamageType;
+
+	UPROPERTY(Config)
+	FName StructureTier;
+
+	UPROPERTY(Config)
+	float Multiplier = 1.f;
+};
+
+// Hours a structure tier takes to decay from full health to nothing
+USTRUCT()
+struct FStructureDecayTime
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName StructureTier;
+
+	UPROPERTY(Config)
+	float Hours = 0.f;
+};
+
+/*
+ * Server side structure health. Damage is queued and applied once per frame, summed per piece, so
+ * a piece hit by several tools in one frame has its health written, and replicated, once. The
+ * multiplier comes from a [E_StructureDamageType x structure tier] table compiled from
+ * DamageMultipliers, gated by the causer's S_DamageTiers the way BPI_StructureDamage's
+ * CanDamageStructure does.
+ *
+ * Pieces also decay over DecayTimes, swept a slice per frame within ate.Building.DecayBudgetMs.
+ * Aggregated pieces take damage and decay in place and are only promoted to be destroyed.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UStructureDamageSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// For BP_BuildableMaster's AnyDamage in place of changing CurrentHP itself
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void QueueDamage(AActor* Structure, float Damage, AActor* DamageCauser);
+
+	// Damages the piece that was hit without promoting it
+	UFUNCTION(BlueprintCallable, BlueprintAuthorityOnly, Category=Building)
+	void QueueHitDamage(const FHitResult& Hit, float Damage, AActor* DamageCauser);
+
+	void QueuePieceDamage(int32 PieceHandle, float Damage, const AActor* DamageCauser);
+
+	// Share of MaxHP left, 0 for anything that isn't a placed piece
+	UFUNCTION(BlueprintPure, Category=Building)
+	float GetHealthPercent(const AActor* Structure) const;
+
+	// Damage the causer deals to a structure tier per point of damage
+	float GetDamageMultiplier(const AActor* DamageCauser, uint8 StructureTier) const;
+
+	// E_StructureDamageType: None, Wood, Stone, Metal
+	static constexpr int32 NumDamageTypes = 4;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	void CompileTables();
+
+	void HandlePieceRegistered(int32 PieceHandle);
+
+	void ApplyQueuedDamage();
+	void DecaySlice();
+
+	float GetPieceHealth(int32 PieceHandle) const;
+	void SetPieceHealth(int32 PieceHandle, float Health);
+
+	static int32 FindDamageType(FName DisplayName);
+
+	UPROPERTY(Config)
+	TArray<FStructureDamageMultiplier> DamageMultipliers;
+
+	UPROPERTY(Config)
+	TArray<FStructureDecayTime> DecayTimes;
+
+	// What the BP_BuildableMaster defaults say about each structure type
+	struct FStructureHealth
+	{
+		const FProperty* HealthField = nullptr;
+		float MaxHealth = 0.f;
+		uint8 Tier = 0;
+
+		// MaxHP lost per second
+		float DecayRate = 0.f;
+	};
+
+	TArray<FStructureHealth> StructureHealth;
+
+	float Multipliers[NumDamageTypes][NumDamageTypes];
+
+	// Where a causer class keeps its StructureDamageType and S_DamageTiers, the values are read from
+	// the causer itself since equipables get theirs from the item they are
+	struct FDamageSourceFields
+	{
+		const FProperty* DamageType = nullptr;
+		const FStructProperty* DamageTiers = nullptr;
+		const FProperty* CanDealDamageTypes = nullptr;
+	};
+
+	const FDamageSourceFields& FindDamageSourceFields(const UClass* CauserClass) const;
+
+	mutable TMap<TObjectKey<UClass>, FDamageSourceFields> DamageSourceFields;
+
+	struct FQueuedDamage
+	{
+		int32 PieceHandle;
+		float Amount;
+	};
+
+	TArray<FQueuedDamage> QueuedDamage;
+
+	// Indexed by snap piece handle
+	TArray<double> LastDecayTimes;
+
+	int32 DecayCursor = 0;
+	double DecayPassStartTime = 0.0;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingSnapSubsystem> BuildingSnap;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UBuildingAggregationSubsystem> BuildingAggregation;
+
+	UPROPERTY(Transient)
+	TObjectPtr<UStructureRegistrySubsystem> StructureRegistry;
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "StructureRegistrySubsystem.h"
+#include "AfterTheEnd/Data/ComponentTemplates.h"
+#include "AfterTheEnd/Data/DataTableFields.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/DataTable.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStructureRegistry, Log, All);
+
+void UStructureRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CompileStructureTable();
+}
+
+UStructureRegistrySubsystem* UStructureRegistrySubsystem::Get(const UWorld* World)
+{
+	return World ? UGameInstance::GetSubsystem<UStructureRegistrySubsystem>(World->GetGameInstance()) : nullptr;
+}
+
+void UStructureRegistrySubsystem::CompileStructureTable()
+{
+	StructureTypes.Reset();
+	SocketMasks.Reset();
+	ClassToType.Reset();
+	BuildClasses.Reset();
+
+	const UDataTable* Table = StructureTable.LoadSynchronous();
+	if (!Table)
+	{
+		return;
+	}
+
+	const FProperty* BuildClassField = DataTableFields::FindField(Table->GetRowStruct(), TEXT("BuildClass"));
+	for (const TPair<FName, uint8*>& Row : Table->GetRowMap())
+	{
+		if (StructureTypes.Num() == sizeof(FStructureTypeMask) * 8)
+		{
+			UE_LOG(LogStructureRegistry, Error, TEXT("Too many structure types, %s and later are ignored"),
+			       *Row.Key.ToString());
+			break;
+		}
+
+		FStructureType& Type = StructureTypes.AddDefaulted_GetRef();
+		Type.RowName = Row.Key;
+		Type.BuildClass = Cast<UClass>(DataTableFields::GetObject(BuildClassField, Row.Value));
+
+		FString Key = Row.Key.ToString();
+		Key.RemoveFromEnd(TEXT("Master"));
+		Type.Key = FName(*Key);
+
+		Type.bInteractive = InteractiveStructures.Contains(Type.Key) || InteractiveStructures.Contains(Type.RowName);
+
+		// S_BuildableInfo lives on the class defaults as BuildableInfo
+		if (UClass* BuildClass = Type.BuildClass)
+		{
+			BuildClasses.Add(BuildClass);
+
+			const FStructProperty* InfoProperty = CastField<FStructProperty>(
+				DataTableFields::FindField(BuildClass, TEXT("BuildableInfo")));
+			if (InfoProperty)
+			{
+				const void* Info = InfoProperty->ContainerPtrToValuePtr<void>(BuildClass->GetDefaultObject());
+				Type.bCanPlaceOnGround = DataTableFields::GetInt(
+					DataTableFields::FindField(InfoProperty->Struct, TEXT("CanPlaceOnGround")), Info) != 0;
+				Type.bCanPlaceOnFoundation = DataTableFields::GetInt(
+					DataTableFields::FindField(InfoProperty->Struct, TEXT("CanPlaceOnFoundation")), Info) != 0;
+			}
+
+			ClassToType.Add(BuildClass, static_cast<FStructureTypeId>(StructureTypes.Num() - 1));
+		}
+
+		SocketMasks.FindOrAdd(Type.Key) |= GetTypeBit(static_cast<FStructureTypeId>(StructureTypes.Num() - 1));
+	}
+
+	for (const FSocketRule& Rule : SocketRules)
+	{
+		const int32 TypeIndex = StructureTypes.IndexOfByPredicate([&Rule](const FStructureType& Type)
+		{
+			return Type.Key == Rule.Structure || Type.RowName == Rule.Structure;
+		});
+		if (TypeIndex != INDEX_NONE)
+		{
+			SocketMasks.FindOrAdd(Rule.Socket) |= GetTypeBit(static_cast<FStructureTypeId>(TypeIndex));
+		}
+	}
+
+	// Needs the final socket masks
+	for (FStructureType& Type : StructureTypes)
+	{
+		BuildTemplate(Type);
+	}
+
+	UE_LOG(LogStructureRegistry, Log, TEXT("Compiled %d structure types and %d socket types"), StructureTypes.Num(),
+	       SocketMasks.Num());
+}
+
+FStructureTypeId UStructureRegistrySubsystem::FindStructureType(const UClass* Class) const
+{
+	for (const UClass* Current = Class; Current; Current = Current->GetSuperClass())
+	{
+		if (const FStructureTypeId* TypeId = ClassToType.Find(Current))
+		{
+			if (Current != Class)
+			{
+				ClassToType.Add(Class, *TypeId);
+			}
+			return *TypeId;
+		}
+	}
+	return InvalidStructureType;
+}
+
+void UStructureRegistrySubsystem::BuildTemplate(FStructureType& Type) const
+{
+	Type.Template = FBuildableTemplate();
+	if (!Type.BuildClass)
+	{
+		return;
+	}
+
+	ComponentTemplates::ForEach(Type.BuildClass, [this, &Type](FName Name, const UActorComponent* Template,
+	                                                           const FTransform& Transform)
+	{
+		if (const UStaticMeshComponent* MeshTemplate = Cast<UStaticMeshComponent>(Template))
+		{
+			if (MeshTemplate->GetStaticMesh() && MeshTemplate->GetVisibleFlag() && !MeshTemplate->bHiddenInGame)
+			{
+				FBuildableTemplate::FMesh& Mesh = Type.Template.Meshes.AddDefaulted_GetRef();
+				Mesh.Mesh = MeshTemplate->GetStaticMesh();
+				for (UMaterialInterface* Material : MeshTemplate->OverrideMaterials)
+				{
+					Mesh.Materials.Add(Material);
+				}
+				Mesh.CollisionProfile = MeshTemplate->GetCollisionProfileName();
+				Mesh.Transform = Transform;
+			}
+		}
+		else if (Template->IsA<UPrimitiveComponent>())
+		{
+			if (const FStructureTypeMask Accepts = GetSocketMask(Name))
+			{
+				Type.Template.Sockets.Add({Accepts, Transform});
+			}
+		}
+	});
+}
+
+FName UStructureRegistrySubsystem::GetSocketName(FName ComponentName)
+{
+	// Wall1 -> Wall, TorchBox1 -> Torch, StairsBox -> Stairs
+	FString Name = ComponentName.ToString();
+	int32 End = Name.Len();
+	while (End > 0 && FChar::IsDigit(Name[End - 1]))
+	{
+		--End;
+	}
+	Name.LeftInline(End);
+	Name.RemoveFromEnd(TEXT("Box"));
+	return FName(*Name);
+}
+
+FStructureTypeMask UStructureRegistrySubsystem::GetSocketMask(const UPrimitiveComponent* SocketComponent) const
+{
+	return SocketComponent ? GetSocketMask(SocketComponent->GetFName()) : 0;
+}
+
+FStructureTypeMask UStructureRegistrySubsystem::GetSocketMask(FName ComponentName) const
+{
+	const FStructureTypeMask* Mask = SocketMasks.Find(GetSocketName(ComponentName));
+	return Mask ? *Mask : 0;
+}
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "StructureRegistrySubsystem.generated.h"
+
+class UDataTable;
+class UMaterialInterface;
+class UPrimitiveComponent;
+class UStaticMesh;
+
+// Index into UStructureRegistrySubsystem's structure types
+using FStructureTypeId = uint8;
+
+constexpr FStructureTypeId InvalidStructureType = MAX_uint8;
+
+// Bit per structure type
+using FStructureTypeMask = uint64;
+
+// Extra structure a snap socket accepts on top of the one it is named after
+USTRUCT()
+struct FSocketRule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName Socket;
+
+	UPROPERTY(Config)
+	FName Structure;
+};
+
+/*
+ * What a build class spawns with, read from its component templates, so a piece can be drawn and
+ * snapped to without an actor.
+ */
+struct FBuildableTemplate
+{
+	struct FMesh
+	{
+		UStaticMesh* Mesh = nullptr;
+		TArray<UMaterialInterface*, TInlineAllocator<2>> Materials;
+		FName CollisionProfile;
+
+		// Relative to the actor
+		FTransform Transform;
+	};
+
+	struct FSocket
+	{
+		FStructureTypeMask Accepts = 0;
+		FTransform Transform;
+	};
+
+	TArray<FMesh, TInlineAllocator<2>> Meshes;
+	TArray<FSocket, TInlineAllocator<8>> Sockets;
+};
+
+/*
+ * One DT_Structures row plus what the build class says about itself in its S_BuildableInfo.
+ */
+struct FStructureType
+{
+	FName RowName;
+
+	// Row name without the "Master" suffix, the name snap boxes refer to
+	FName Key;
+
+	TSubclassOf<AActor> BuildClass;
+	bool bCanPlaceOnGround = false;
+	bool bCanPlaceOnFoundation = false;
+
+	// Listed in InteractiveStructures, never stands in for its actor
+	bool bInteractive = false;
+
+	FBuildableTemplate Template;
+};
+
+/*
+ * DT_Structures compiled into small integer structure types, together with the snap socket rules.
+ * The buildable Blueprints mark their snap points with box components named after the piece
+ * that fits there (Wall1, TriangleFoundation2, TorchBox, ...), so a socket's type is its box name
+ * without the trailing digits and "Box", and it accepts the structure of the same name plus any
+ * SocketRules from config.
+ */
+UCLASS(Config=Game)
+class AFTERTHEEND_API UStructureRegistrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	static UStructureRegistrySubsystem* Get(const UWorld* World);
+
+	int32 GetNumStructureTypes() const { return StructureTypes.Num(); }
+
+	const FStructureType& GetStructureType(FStructureTypeId TypeId) const { return StructureTypes[TypeId]; }
+
+	// Structure type of a build class or any of its subclasses
+	FStructureTypeId FindStructureType(const UClass* Class) const;
+
+	// Structure types that snap onto a socket box, 0 if the component isn't a snap socket
+	FStructureTypeMask GetSocketMask(const UPrimitiveComponent* SocketComponent) const;
+	FStructureTypeMask GetSocketMask(FName ComponentName) const;
+
+	static FStructureTypeMask GetTypeBit(FStructureTypeId TypeId) { return FStructureTypeMask(1) << TypeId; }
+
+protected:
+	void CompileStructureTable();
+
+	void BuildTemplate(FStructureType& Type) const;
+
+	static FName GetSocketName(FName ComponentName);
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UDataTable> StructureTable;
+
+	UPROPERTY(Config)
+	TArray<FSocketRule> SocketRules;
+
+	// Structures players interact with as actors, doors and the like
+	UPROPERTY(Config)
+	TArray<FName> InteractiveStructures;
+
+	TArray<FStructureType> StructureTypes;
+
+	// Keeps the build classes and what their templates point at loaded
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UClass>> BuildClasses;
+
+	TMap<FName, FStructureTypeMask> SocketMasks;
+
+	// Subclasses are added on first lookup
+	mutable TMap<TObjectKey<UClass>, FStructureTypeId> ClassToType;
+};